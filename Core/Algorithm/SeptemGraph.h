@@ -16,4 +16,9 @@
 #pragma once
 
 #include <Core/Templates/DirectedGraph.hpp>
-#include <Core/Templates/BackwardGraph.hpp>
\ No newline at end of file
+#include <Core/Templates/BackwardGraph.hpp>
+#include <Core/Templates/GraphCSR.hpp>
+#include <Core/Templates/MappedGraph.hpp>
+#include <Core/Templates/IncrementalGraph.hpp>
+#include <Core/Templates/ConcurrentGraph.hpp>
+#include <Core/Algorithm/SeptemGraphAlgorithm.h>
\ No newline at end of file
@@ -0,0 +1,548 @@
+/*
+	Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+	LICENSE:	GNU General Public License V3.0
+
+	As a special exception,  you may use this file  as part of a free software library without
+	restriction.  Specifically,  if other files instantiate templates  or use macros or inline
+	functions from this file, or you compile this file and link it with other files to produce
+	an executable,  this file does not by itself cause the resulting executable to be covered
+	by the GNU General Public License. This exception does not however invalidate any other
+	reasons why the executable file might be covered by the GNU General Public License.
+
+	Support Email:	guij@sari.ac.cn
+*/
+
+#pragma once
+
+#include <Core/Public/marco.h>
+#include <Core/Templates/GraphCSR.hpp>
+#include <Core/Thread/SeptemWorkerPool.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <vector>
+#include <string.h>
+
+/// switch BFS to bottom-up when frontier edges > unexplored edges / ALPHA
+#ifndef GRAPH_BFS_ALPHA
+#define GRAPH_BFS_ALPHA 14
+#endif // !GRAPH_BFS_ALPHA
+
+/// switch BFS back to top-down when frontier vertices < vertices / BETA
+#ifndef GRAPH_BFS_BETA
+#define GRAPH_BFS_BETA 24
+#endif // !GRAPH_BFS_BETA
+
+namespace Septem
+{
+	namespace GraphTheory
+	{
+		/*
+		*	Graph algorithms over a frozen TCSRGraph
+		*	build the view once: TCSRGraph<ET> csr; csr.Build(graph);
+		*	every algorithm runs its parallel steps on the FWorkerPool given
+		*	FWorkerPool pool(0) makes them single threaded
+		*/
+
+		/*
+		*	Direction optimizing BFS (Beamer et al.)
+		*	top-down steps expand the frontier through out edges,
+		*	bottom-up steps let unvisited vertices look for a parent in the frontier through in edges
+		*	@param OutDepth		hops from InSource, -1 if unreachable
+		*	@param OutParent	bfs tree parent, InSource is its own parent, -1 if unreachable
+		*	@return count of reached vertices
+		*/
+		template<typename ET>
+		int32 BreadthFirstSearch(const TCSRGraph<ET>& InGraph, int32 InSource, FWorkerPool& InPool
+			, std::vector<int32>& OutDepth, std::vector<int32>& OutParent)
+		{
+			const int32 _VertexCount = InGraph.VertexCount();
+			const int32 _Workers = InPool.NumWorkers();
+
+			OutDepth.assign((SIZE_T)_VertexCount, -1);
+			OutParent.assign((SIZE_T)_VertexCount, -1);
+			if (InSource < 0 || InSource >= _VertexCount)
+				return 0;
+
+			std::vector< std::atomic<int32> > _parent((SIZE_T)_VertexCount);
+			for (int32 v = 0; v < _VertexCount; ++v)
+			{
+				_parent[v].store(-1, std::memory_order_relaxed);
+			}
+			_parent[InSource].store(InSource, std::memory_order_relaxed);
+			OutDepth[InSource] = 0;
+
+			std::vector<int32> _frontier(1, InSource);
+			std::vector< std::vector<int32> > _localNext((SIZE_T)_Workers);
+			std::vector<uint8> _inFrontier;
+
+			int64 _unexploredEdges = InGraph.EdgeCount();
+			int32 _reached = 1;
+			int32 _depth = 0;
+			bool bBottomUp = false;
+
+			while (!_frontier.empty())
+			{
+				int64 _frontierEdges = 0;
+				for (int32 v : _frontier)
+				{
+					_frontierEdges += InGraph.OutDegree(v);
+				}
+				_unexploredEdges -= _frontierEdges;
+
+				if (!bBottomUp && _frontierEdges > _unexploredEdges / GRAPH_BFS_ALPHA)
+				{
+					bBottomUp = true;
+				}
+				else if (bBottomUp && (int64)_frontier.size() < _VertexCount / GRAPH_BFS_BETA)
+				{
+					bBottomUp = false;
+				}
+
+				++_depth;
+				for (std::vector<int32>& local : _localNext)
+				{
+					local.clear();
+				}
+
+				if (bBottomUp)
+				{
+					_inFrontier.assign((SIZE_T)_VertexCount, 0);
+					for (int32 v : _frontier)
+					{
+						_inFrontier[v] = 1;
+					}
+					InPool.ParallelFor(0, _VertexCount, [&](int32 v, int32 InWorker)
+					{
+						if (_parent[v].load(std::memory_order_relaxed) != -1)
+							return;
+						for (int32 u : InGraph.InNeighbors(v))
+						{
+							if (_inFrontier[u])
+							{
+								// only this worker owns v in a bottom-up step
+								_parent[v].store(u, std::memory_order_relaxed);
+								_localNext[InWorker].push_back(v);
+								break;
+							}
+						}
+					});
+				}
+				else
+				{
+					InPool.ParallelFor(0, (int32)_frontier.size(), [&](int32 i, int32 InWorker)
+					{
+						const int32 u = _frontier[i];
+						for (int32 v : InGraph.OutNeighbors(u))
+						{
+							int32 expected = -1;
+							if (_parent[v].load(std::memory_order_relaxed) == -1
+								&& _parent[v].compare_exchange_strong(expected, u, std::memory_order_relaxed))
+							{
+								_localNext[InWorker].push_back(v);
+							}
+						}
+					}, 64);
+				}
+
+				_frontier.clear();
+				for (std::vector<int32>& local : _localNext)
+				{
+					for (int32 v : local)
+					{
+						OutDepth[v] = _depth;
+						_frontier.push_back(v);
+					}
+				}
+				_reached += (int32)_frontier.size();
+			}
+
+			for (int32 v = 0; v < _VertexCount; ++v)
+			{
+				OutParent[v] = _parent[v].load(std::memory_order_relaxed);
+			}
+			return _reached;
+		}
+
+		/*
+		*	Delta-stepping single source shortest path (Meyer & Sanders)
+		*	distances are kept as double, ET must convert to double and be >= 0
+		*	vertices are bucketed by floor(dist / InDelta); light edges (weight <= InDelta)
+		*	are relaxed repeatedly inside a bucket, heavy edges once when it settles
+		*	buckets live in a ring of floor(max weight / InDelta) + 2, every update lands within that reach
+		*	@param InDelta	bucket width, <= 0 picks the mean edge weight
+		*	@param OutDistance	infinity if unreachable
+		*/
+		template<typename ET>
+		void DeltaSteppingShortestPath(const TCSRGraph<ET>& InGraph, int32 InSource, FWorkerPool& InPool
+			, std::vector<double>& OutDistance, double InDelta = 0.0)
+		{
+			const int32 _VertexCount = InGraph.VertexCount();
+			const int32 _Workers = InPool.NumWorkers();
+			const double _Infinity = std::numeric_limits<double>::infinity();
+
+			OutDistance.assign((SIZE_T)_VertexCount, _Infinity);
+			if (InSource < 0 || InSource >= _VertexCount)
+				return;
+
+			const std::vector<ET>& _weights = InGraph.GetWeights();
+			double _maxWeight = 0.0;
+			double sum = 0.0;
+			for (const ET& w : _weights)
+			{
+				sum += (double)w;
+				_maxWeight = std::max(_maxWeight, (double)w);
+			}
+			if (InDelta <= 0.0)
+			{
+				InDelta = _weights.empty() || sum <= 0.0 ? 1.0 : sum / (double)_weights.size();
+			}
+
+			// non-negative doubles order like their bit patterns, so atomic min works on uint64
+			std::vector< std::atomic<uint64> > _dist((SIZE_T)_VertexCount);
+			uint64 _infBits;
+			memcpy(&_infBits, &_Infinity, sizeof(_infBits));
+			for (int32 v = 0; v < _VertexCount; ++v)
+			{
+				_dist[v].store(_infBits, std::memory_order_relaxed);
+			}
+			auto LoadDist = [&_dist](int32 v)
+			{
+				uint64 bits = _dist[v].load(std::memory_order_relaxed);
+				double d;
+				memcpy(&d, &bits, sizeof(d));
+				return d;
+			};
+			// @return true if InDistance improved v
+			auto Relax = [&_dist](int32 v, double InDistance)
+			{
+				uint64 bits;
+				memcpy(&bits, &InDistance, sizeof(bits));
+				uint64 current = _dist[v].load(std::memory_order_relaxed);
+				while (bits < current)
+				{
+					if (_dist[v].compare_exchange_weak(current, bits, std::memory_order_relaxed))
+						return true;
+				}
+				return false;
+			};
+
+			// an update from bucket b has dist < (b + 1) * InDelta + max weight: bucket b .. b + ring - 1
+			const SIZE_T _Ring = (SIZE_T)(_maxWeight / InDelta) + 2;
+			std::vector< std::vector<int32> > _buckets(_Ring);
+			SIZE_T _queued = 0;
+			std::vector< std::vector<int32> > _localUpdated((SIZE_T)_Workers);
+			auto BucketOf = [InDelta](double InDistance) { return (SIZE_T)(InDistance / InDelta); };
+			auto PushUpdated = [&]()
+			{
+				for (std::vector<int32>& local : _localUpdated)
+				{
+					for (int32 v : local)
+					{
+						_buckets[BucketOf(LoadDist(v)) % _Ring].push_back(v);
+					}
+					_queued += local.size();
+					local.clear();
+				}
+			};
+
+			Relax(InSource, 0.0);
+			_buckets[0].push_back(InSource);
+			_queued = 1;
+
+			std::vector<int32> _current;
+			std::vector<int32> _settled;
+			for (SIZE_T b = 0; _queued > 0; ++b)
+			{
+				std::vector<int32>& _bucket = _buckets[b % _Ring];
+				_settled.clear();
+				while (!_bucket.empty())
+				{
+					_current.swap(_bucket);
+					_bucket.clear();
+					_queued -= _current.size();
+
+					// light edges, may refill bucket b
+					InPool.ParallelFor(0, (int32)_current.size(), [&](int32 i, int32 InWorker)
+					{
+						const int32 u = _current[i];
+						const double du = LoadDist(u);
+						if (BucketOf(du) != b)
+							return; // stale entry
+						TCSRRange<int32> targets = InGraph.OutNeighbors(u);
+						TCSRRange<ET> weights = InGraph.OutWeights(u);
+						for (int32 k = 0; k < targets.Num(); ++k)
+						{
+							const double w = (double)weights[k];
+							if (w <= InDelta && Relax(targets[k], du + w))
+								_localUpdated[InWorker].push_back(targets[k]);
+						}
+					}, 64);
+					_settled.insert(_settled.end(), _current.begin(), _current.end());
+					PushUpdated();
+				}
+
+				// heavy edges once per settled vertex, always land in later buckets
+				InPool.ParallelFor(0, (int32)_settled.size(), [&](int32 i, int32 InWorker)
+				{
+					const int32 u = _settled[i];
+					const double du = LoadDist(u);
+					if (BucketOf(du) != b)
+						return;
+					TCSRRange<int32> targets = InGraph.OutNeighbors(u);
+					TCSRRange<ET> weights = InGraph.OutWeights(u);
+					for (int32 k = 0; k < targets.Num(); ++k)
+					{
+						const double w = (double)weights[k];
+						if (w > InDelta && Relax(targets[k], du + w))
+							_localUpdated[InWorker].push_back(targets[k]);
+					}
+				}, 64);
+				PushUpdated();
+			}
+
+			for (int32 v = 0; v < _VertexCount; ++v)
+			{
+				OutDistance[v] = LoadDist(v);
+			}
+		}
+
+		/*
+		*	Parallel topological sort, level synchronous Kahn
+		*	every vertex of one level only depends on earlier levels
+		*	@param OutOrder		vertices level by level
+		*	@param OutLevel		optional, level of each vertex, -1 if on a cycle
+		*	@return false if the graph has a cycle, OutOrder then holds the acyclic part
+		*/
+		template<typename ET>
+		bool TopologicalSort(const TCSRGraph<ET>& InGraph, FWorkerPool& InPool
+			, std::vector<int32>& OutOrder, std::vector<int32>* OutLevel = nullptr)
+		{
+			const int32 _VertexCount = InGraph.VertexCount();
+			const int32 _Workers = InPool.NumWorkers();
+
+			std::vector< std::atomic<int32> > _indegree((SIZE_T)_VertexCount);
+			OutOrder.clear();
+			OutOrder.reserve((SIZE_T)_VertexCount);
+			if (OutLevel)
+			{
+				OutLevel->assign((SIZE_T)_VertexCount, -1);
+			}
+
+			for (int32 v = 0; v < _VertexCount; ++v)
+			{
+				_indegree[v].store(InGraph.InDegree(v), std::memory_order_relaxed);
+				if (InGraph.InDegree(v) == 0)
+				{
+					OutOrder.push_back(v);
+				}
+			}
+
+			std::vector< std::vector<int32> > _localNext((SIZE_T)_Workers);
+			SIZE_T _levelBegin = 0;
+			int32 _level = 0;
+			while (_levelBegin < OutOrder.size())
+			{
+				const SIZE_T _levelEnd = OutOrder.size();
+				if (OutLevel)
+				{
+					for (SIZE_T i = _levelBegin; i < _levelEnd; ++i)
+					{
+						(*OutLevel)[OutOrder[i]] = _level;
+					}
+				}
+
+				InPool.ParallelFor((int32)_levelBegin, (int32)_levelEnd, [&](int32 i, int32 InWorker)
+				{
+					for (int32 v : InGraph.OutNeighbors(OutOrder[i]))
+					{
+						if (_indegree[v].fetch_sub(1, std::memory_order_acq_rel) == 1)
+						{
+							_localNext[InWorker].push_back(v);
+						}
+					}
+				}, 64);
+
+				for (std::vector<int32>& local : _localNext)
+				{
+					OutOrder.insert(OutOrder.end(), local.begin(), local.end());
+					local.clear();
+				}
+				_levelBegin = _levelEnd;
+				++_level;
+			}
+
+			return (int32)OutOrder.size() == _VertexCount;
+		}
+
+		/*
+		*	Strongly connected components
+		*	1. parallel worklist trim: a vertex without live in or out edges is a component by itself,
+		*		removing it may free its neighbors; dependency graphs are mostly removed here
+		*	2. iterative Tarjan over what is left
+		*	@param OutComponent	component id of each vertex, ids are 0 .. return-1
+		*	@return count of components
+		*/
+		template<typename ET>
+		int32 StronglyConnectedComponents(const TCSRGraph<ET>& InGraph, FWorkerPool& InPool
+			, std::vector<int32>& OutComponent)
+		{
+			const int32 _VertexCount = InGraph.VertexCount();
+			const int32 _Workers = InPool.NumWorkers();
+
+			OutComponent.assign((SIZE_T)_VertexCount, -1);
+
+			// 1. trim: live in / out degree without self loops, a vertex reaching 0 on either side goes
+			std::vector< std::atomic<int32> > _inLive((SIZE_T)_VertexCount);
+			std::vector< std::atomic<int32> > _outLive((SIZE_T)_VertexCount);
+			std::vector< std::atomic<uint8> > _trimmed((SIZE_T)_VertexCount);
+			std::vector< std::vector<int32> > _localNext((SIZE_T)_Workers);
+			std::vector<int32> _trimOrder;
+			_trimOrder.reserve((SIZE_T)_VertexCount);
+
+			auto MergeNext = [&]()
+			{
+				for (std::vector<int32>& local : _localNext)
+				{
+					_trimOrder.insert(_trimOrder.end(), local.begin(), local.end());
+					local.clear();
+				}
+			};
+
+			InPool.ParallelFor(0, _VertexCount, [&](int32 v, int32 InWorker)
+			{
+				int32 _in = 0;
+				for (int32 u : InGraph.InNeighbors(v))
+				{
+					_in += u != v ? 1 : 0;
+				}
+				int32 _out = 0;
+				for (int32 u : InGraph.OutNeighbors(v))
+				{
+					_out += u != v ? 1 : 0;
+				}
+				_inLive[v].store(_in, std::memory_order_relaxed);
+				_outLive[v].store(_out, std::memory_order_relaxed);
+				const bool bTrim = _in == 0 || _out == 0;
+				_trimmed[v].store(bTrim ? 1 : 0, std::memory_order_relaxed);
+				if (bTrim)
+				{
+					_localNext[InWorker].push_back(v);
+				}
+			});
+			MergeNext();
+
+			// each removed vertex walks its edges once: O(V + E) whatever the depth
+			SIZE_T _begin = 0;
+			while (_begin < _trimOrder.size())
+			{
+				const SIZE_T _end = _trimOrder.size();
+				InPool.ParallelFor((int32)_begin, (int32)_end, [&](int32 i, int32 InWorker)
+				{
+					const int32 v = _trimOrder[i];
+					for (int32 u : InGraph.OutNeighbors(v))
+					{
+						if (u != v && _inLive[u].fetch_sub(1, std::memory_order_acq_rel) == 1
+							&& _trimmed[u].exchange(1, std::memory_order_acq_rel) == 0)
+						{
+							_localNext[InWorker].push_back(u);
+						}
+					}
+					for (int32 u : InGraph.InNeighbors(v))
+					{
+						if (u != v && _outLive[u].fetch_sub(1, std::memory_order_acq_rel) == 1
+							&& _trimmed[u].exchange(1, std::memory_order_acq_rel) == 0)
+						{
+							_localNext[InWorker].push_back(u);
+						}
+					}
+				}, 64);
+				MergeNext();
+				_begin = _end;
+			}
+
+			std::vector<uint8> _removed((SIZE_T)_VertexCount, 0);
+			int32 _componentCount = 0;
+			for (int32 v = 0; v < _VertexCount; ++v)
+			{
+				_removed[v] = _trimmed[v].load(std::memory_order_relaxed);
+				if (_removed[v])
+				{
+					OutComponent[v] = _componentCount++;
+				}
+			}
+
+			// 2. iterative Tarjan on the rest
+			std::vector<int32> _index((SIZE_T)_VertexCount, -1);
+			std::vector<int32> _lowlink((SIZE_T)_VertexCount, 0);
+			std::vector<uint8> _onStack((SIZE_T)_VertexCount, 0);
+			std::vector<int32> _stack;
+			// (vertex, next out edge slot)
+			std::vector< std::pair<int32, int32> > _callStack;
+			const std::vector<int32>& _outOffsets = InGraph.GetOutOffsets();
+			const std::vector<int32>& _targets = InGraph.GetTargets();
+			int32 _nextIndex = 0;
+
+			for (int32 root = 0; root < _VertexCount; ++root)
+			{
+				if (_removed[root] || _index[root] != -1)
+					continue;
+
+				_callStack.push_back(std::make_pair(root, _outOffsets[root]));
+				_index[root] = _lowlink[root] = _nextIndex++;
+				_stack.push_back(root);
+				_onStack[root] = 1;
+
+				while (!_callStack.empty())
+				{
+					const int32 v = _callStack.back().first;
+					int32& edge = _callStack.back().second;
+
+					if (edge < _outOffsets[v + 1])
+					{
+						const int32 w = _targets[edge++];
+						if (_removed[w])
+							continue;
+						if (_index[w] == -1)
+						{
+							_index[w] = _lowlink[w] = _nextIndex++;
+							_stack.push_back(w);
+							_onStack[w] = 1;
+							_callStack.push_back(std::make_pair(w, _outOffsets[w]));
+						}
+						else if (_onStack[w] && _index[w] < _lowlink[v])
+						{
+							_lowlink[v] = _index[w];
+						}
+						continue;
+					}
+
+					// v is finished
+					if (_lowlink[v] == _index[v])
+					{
+						int32 w;
+						do
+						{
+							w = _stack.back();
+							_stack.pop_back();
+							_onStack[w] = 0;
+							OutComponent[w] = _componentCount;
+						} while (w != v);
+						++_componentCount;
+					}
+					_callStack.pop_back();
+					if (!_callStack.empty())
+					{
+						const int32 parent = _callStack.back().first;
+						if (_lowlink[v] < _lowlink[parent])
+							_lowlink[parent] = _lowlink[v];
+					}
+				}
+			}
+
+			return _componentCount;
+		}
+	}
+}
@@ -0,0 +1,449 @@
+/*
+	Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+	LICENSE:	GNU General Public License V3.0
+
+	As a special exception,  you may use this file  as part of a free software library without
+	restriction.  Specifically,  if other files instantiate templates  or use macros or inline
+	functions from this file, or you compile this file and link it with other files to produce
+	an executable,  this file does not by itself cause the resulting executable to be covered
+	by the GNU General Public License. This exception does not however invalidate any other
+	reasons why the executable file might be covered by the GNU General Public License.
+
+	Support Email:	guij@sari.ac.cn
+*/
+
+#pragma once
+
+#include <Core/Public/marco.h>
+
+#include <functional>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define FLAT_HASH_MAP_SSE2 1
+#else
+#define FLAT_HASH_MAP_SSE2 0
+#endif
+
+namespace Septem
+{
+	/*
+	*	default hasher of TFlatHashMap
+	*	integers are mixed (murmur3 fmix64), so (start<<32)|end edge keys spread well
+	*/
+	template<typename KeyType, bool bIntegral = std::is_integral<KeyType>::value>
+	struct TFlatHash
+	{
+		uint64 operator()(const KeyType& InKey) const
+		{
+			return Mix((uint64)std::hash<KeyType>()(InKey));
+		}
+
+		static uint64 Mix(uint64 h)
+		{
+			h ^= h >> 33;
+			h *= 0xff51afd7ed558ccdULL;
+			h ^= h >> 33;
+			h *= 0xc4ceb9fe1a85ec53ULL;
+			h ^= h >> 33;
+			return h;
+		}
+	};
+
+	template<typename KeyType>
+	struct TFlatHash<KeyType, true>
+	{
+		uint64 operator()(const KeyType& InKey) const
+		{
+			return TFlatHash<KeyType, false>::Mix((uint64)InKey);
+		}
+	};
+
+	/*
+	*	Flat Hash Map
+	*	open addressing, swiss-table style:
+	*		one control byte per slot, 16 slots per group
+	*		control byte: 0x80 empty, 0xFE deleted, 0~127 the low 7 bits of the hash (H2)
+	*		a probe compares the 16 control bytes of a group with H2 in one SSE2 instruction
+	*		the high bits (H1) pick the first group, then triangular probing over groups
+	*	max load 7/8, call reserve() before bulk loading to avoid rehash
+	*	subset of the std::map interface, so it can replace it in graph containers
+	*	No Thread Safe
+	*/
+	template<typename KeyType, typename ValueType, typename HasherType = TFlatHash<KeyType> >
+	class TFlatHashMap
+	{
+	public:
+		typedef std::pair<const KeyType, ValueType> value_type;
+
+		enum : int8
+		{
+			CtrlEmpty = (int8)0x80,
+			CtrlDeleted = (int8)0xFE,
+		};
+
+		enum : SIZE_T
+		{
+			GroupWidth = 16,
+		};
+
+		template<bool bConst>
+		class TIterator
+		{
+		public:
+			typedef typename std::conditional<bConst, const TFlatHashMap, TFlatHashMap>::type MapType;
+			typedef typename std::conditional<bConst, const value_type, value_type>::type ElementType;
+
+			TIterator() :Map(nullptr), Index(0) {}
+			TIterator(MapType* InMap, SIZE_T InIndex) :Map(InMap), Index(InIndex) { SkipEmpty(); }
+			// const_iterator from iterator
+			TIterator(const TIterator<false>& Other) :Map(Other.Map), Index(Other.Index) {}
+
+			ElementType& operator*() const { return Map->Slots[Index]; }
+			ElementType* operator->() const { return &Map->Slots[Index]; }
+
+			TIterator& operator++()
+			{
+				++Index;
+				SkipEmpty();
+				return *this;
+			}
+
+			TIterator operator++(int)
+			{
+				TIterator ret = *this;
+				++(*this);
+				return ret;
+			}
+
+			bool operator==(const TIterator& Other) const { return Index == Other.Index; }
+			bool operator!=(const TIterator& Other) const { return Index != Other.Index; }
+
+		private:
+			friend class TFlatHashMap;
+			friend class TIterator<!bConst>;
+
+			void SkipEmpty()
+			{
+				while (Index < Map->Capacity && Map->Ctrl[Index] < 0)
+					++Index;
+			}
+
+			MapType* Map;
+			SIZE_T Index;
+		};
+
+		typedef TIterator<false> iterator;
+		typedef TIterator<true> const_iterator;
+
+	public:
+		TFlatHashMap()
+			:Ctrl(nullptr)
+			, Slots(nullptr)
+			, Capacity(0)
+			, Count(0)
+			, GrowthLeft(0)
+		{}
+
+		TFlatHashMap(const TFlatHashMap& Other)
+			:TFlatHashMap()
+		{
+			reserve(Other.size());
+			for (const_iterator itr = Other.begin(); itr != Other.end(); ++itr)
+			{
+				insert(*itr);
+			}
+		}
+
+		TFlatHashMap(TFlatHashMap&& Other)
+			:TFlatHashMap()
+		{
+			Swap(Other);
+		}
+
+		TFlatHashMap& operator=(TFlatHashMap Other)
+		{
+			Swap(Other);
+			return *this;
+		}
+
+		~TFlatHashMap()
+		{
+			DestroyAll();
+			Release();
+		}
+
+		iterator begin() { return iterator(this, 0); }
+		iterator end() { return iterator(this, Capacity); }
+		const_iterator begin() const { return const_iterator(this, 0); }
+		const_iterator end() const { return const_iterator(this, Capacity); }
+
+		SIZE_T size() const { return Count; }
+		bool empty() const { return Count == 0; }
+		SIZE_T capacity() const { return Capacity; }
+
+		/*
+		* make room for InCount elements without rehash
+		*/
+		void reserve(SIZE_T InCount)
+		{
+			SIZE_T needed = InCount + (InCount + 6) / 7;
+			if (needed > Capacity || InCount > Count + GrowthLeft)
+			{
+				Rehash(CapacityFor(needed));
+			}
+		}
+
+		void clear()
+		{
+			DestroyAll();
+			if (Capacity)
+			{
+				memset(Ctrl, CtrlEmpty, Capacity);
+			}
+			Count = 0;
+			GrowthLeft = MaxLoad(Capacity);
+		}
+
+		iterator find(const KeyType& InKey)
+		{
+			return iterator(this, FindIndex(InKey));
+		}
+
+		const_iterator find(const KeyType& InKey) const
+		{
+			return const_iterator(this, FindIndex(InKey));
+		}
+
+		SIZE_T count(const KeyType& InKey) const
+		{
+			return FindIndex(InKey) != Capacity ? 1 : 0;
+		}
+
+		std::pair<iterator, bool> insert(const value_type& InValue)
+		{
+			return Emplace(InValue.first, InValue.second);
+		}
+
+		std::pair<iterator, bool> insert(const std::pair<KeyType, ValueType>& InValue)
+		{
+			return Emplace(InValue.first, InValue.second);
+		}
+
+		// hint is ignored, kept for std::map compatibility
+		iterator insert(const_iterator, const value_type& InValue)
+		{
+			return Emplace(InValue.first, InValue.second).first;
+		}
+
+		ValueType& operator[](const KeyType& InKey)
+		{
+			return Emplace(InKey, ValueType()).first->second;
+		}
+
+		SIZE_T erase(const KeyType& InKey)
+		{
+			SIZE_T index = FindIndex(InKey);
+			if (index == Capacity)
+				return 0;
+			Slots[index].~value_type();
+			Ctrl[index] = CtrlDeleted;
+			--Count;
+			return 1;
+		}
+
+		void Swap(TFlatHashMap& Other)
+		{
+			std::swap(Ctrl, Other.Ctrl);
+			std::swap(Slots, Other.Slots);
+			std::swap(Capacity, Other.Capacity);
+			std::swap(Count, Other.Count);
+			std::swap(GrowthLeft, Other.GrowthLeft);
+		}
+
+	protected:
+		static SIZE_T MaxLoad(SIZE_T InCapacity)
+		{
+			return InCapacity - InCapacity / 8;
+		}
+
+		static SIZE_T CapacityFor(SIZE_T InSlots)
+		{
+			SIZE_T cap = GroupWidth;
+			while (cap < InSlots)
+				cap <<= 1;
+			return cap;
+		}
+
+		static uint8 H2(uint64 InHash)
+		{
+			return (uint8)(InHash & 0x7F);
+		}
+
+		static SIZE_T H1(uint64 InHash)
+		{
+			return (SIZE_T)(InHash >> 7);
+		}
+
+		// bit i set when control byte i of the group equals InByte
+		static uint32 MatchByte(const int8* InGroup, int8 InByte)
+		{
+#if FLAT_HASH_MAP_SSE2
+			__m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(InGroup));
+			return (uint32)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(InByte)));
+#else
+			uint32 mask = 0;
+			for (SIZE_T i = 0; i < GroupWidth; ++i)
+			{
+				if (InGroup[i] == InByte)
+					mask |= 1u << i;
+			}
+			return mask;
+#endif
+		}
+
+		// bit i set when slot i of the group is empty or deleted
+		static uint32 MatchFree(const int8* InGroup)
+		{
+#if FLAT_HASH_MAP_SSE2
+			__m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(InGroup));
+			return (uint32)_mm_movemask_epi8(ctrl);
+#else
+			uint32 mask = 0;
+			for (SIZE_T i = 0; i < GroupWidth; ++i)
+			{
+				if (InGroup[i] < 0)
+					mask |= 1u << i;
+			}
+			return mask;
+#endif
+		}
+
+		SIZE_T FindIndex(const KeyType& InKey) const
+		{
+			if (Capacity == 0)
+				return Capacity;
+
+			const uint64 hash = HasherType()(InKey);
+			const SIZE_T groupMask = Capacity / GroupWidth - 1;
+			SIZE_T group = H1(hash) & groupMask;
+			for (SIZE_T step = 1; step <= groupMask + 1; ++step)
+			{
+				const int8* ctrl = Ctrl + group * GroupWidth;
+				uint32 match = MatchByte(ctrl, (int8)H2(hash));
+				while (match)
+				{
+					SIZE_T index = group * GroupWidth + (SIZE_T)__builtin_ctz(match);
+					if (Slots[index].first == InKey)
+						return index;
+					match &= match - 1;
+				}
+				// an empty slot ends the probe chain
+				if (MatchByte(ctrl, CtrlEmpty))
+					return Capacity;
+				group = (group + step) & groupMask;
+			}
+			return Capacity;
+		}
+
+		// first empty or deleted slot on the probe chain of InHash
+		SIZE_T FindFreeSlot(uint64 InHash) const
+		{
+			const SIZE_T groupMask = Capacity / GroupWidth - 1;
+			SIZE_T group = H1(InHash) & groupMask;
+			for (SIZE_T step = 1;; ++step)
+			{
+				uint32 free = MatchFree(Ctrl + group * GroupWidth);
+				if (free)
+					return group * GroupWidth + (SIZE_T)__builtin_ctz(free);
+				group = (group + step) & groupMask;
+			}
+		}
+
+		template<typename InValueType>
+		std::pair<iterator, bool> Emplace(const KeyType& InKey, InValueType&& InValue)
+		{
+			SIZE_T index = FindIndex(InKey);
+			if (index != Capacity)
+				return std::make_pair(iterator(this, index), false);
+
+			if (GrowthLeft == 0)
+			{
+				// tombstones only: same capacity rehash cleans them, otherwise grow
+				Rehash(Count * 2 + 1 > MaxLoad(Capacity) ? CapacityFor(Capacity * 2) : CapacityFor(Capacity));
+			}
+
+			const uint64 hash = HasherType()(InKey);
+			index = FindFreeSlot(hash);
+			if (Ctrl[index] == CtrlEmpty)
+				--GrowthLeft;
+			Ctrl[index] = (int8)H2(hash);
+			new (&Slots[index]) value_type(InKey, std::forward<InValueType>(InValue));
+			++Count;
+			return std::make_pair(iterator(this, index), true);
+		}
+
+		void Rehash(SIZE_T InCapacity)
+		{
+			int8* oldCtrl = Ctrl;
+			value_type* oldSlots = Slots;
+			SIZE_T oldCapacity = Capacity;
+
+			Ctrl = static_cast<int8*>(::operator new(InCapacity));
+			Slots = static_cast<value_type*>(::operator new(InCapacity * sizeof(value_type)));
+			memset(Ctrl, CtrlEmpty, InCapacity);
+			Capacity = InCapacity;
+			GrowthLeft = MaxLoad(InCapacity) - Count;
+
+			for (SIZE_T i = 0; i < oldCapacity; ++i)
+			{
+				if (oldCtrl[i] >= 0)
+				{
+					const uint64 hash = HasherType()(oldSlots[i].first);
+					SIZE_T index = FindFreeSlot(hash);
+					Ctrl[index] = (int8)H2(hash);
+					new (&Slots[index]) value_type(std::move(oldSlots[i]));
+					oldSlots[i].~value_type();
+				}
+			}
+
+			::operator delete(oldCtrl);
+			::operator delete(oldSlots);
+		}
+
+		void DestroyAll()
+		{
+			for (SIZE_T i = 0; i < Capacity; ++i)
+			{
+				if (Ctrl[i] >= 0)
+				{
+					Slots[i].~value_type();
+				}
+			}
+		}
+
+		void Release()
+		{
+			::operator delete(Ctrl);
+			::operator delete(Slots);
+			Ctrl = nullptr;
+			Slots = nullptr;
+			Capacity = 0;
+			Count = 0;
+			GrowthLeft = 0;
+		}
+
+	protected:
+		int8* Ctrl;
+		value_type* Slots;
+		SIZE_T Capacity;
+		SIZE_T Count;
+		// empty slots we may still fill before the 7/8 load limit
+		SIZE_T GrowthLeft;
+	};
+}
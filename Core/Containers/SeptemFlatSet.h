@@ -0,0 +1,300 @@
+/*
+	Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+	LICENSE:	GNU General Public License V3.0
+
+	As a special exception,  you may use this file  as part of a free software library without
+	restriction.  Specifically,  if other files instantiate templates  or use macros or inline
+	functions from this file, or you compile this file and link it with other files to produce
+	an executable,  this file does not by itself cause the resulting executable to be covered
+	by the GNU General Public License. This exception does not however invalidate any other
+	reasons why the executable file might be covered by the GNU General Public License.
+
+	Support Email:	guij@sari.ac.cn
+*/
+
+#pragma once
+
+#include <Core/Public/marco.h>
+
+#include <utility>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define FLAT_SET_SSE2 1
+#else
+#define FLAT_SET_SSE2 0
+#endif
+
+/// ids kept inside the set before it moves to the heap, 6 keeps sizeof at 32 bytes
+#ifndef DEFAULT_FLAT_SET_INLINE
+#define DEFAULT_FLAT_SET_INLINE 6
+#endif // !DEFAULT_FLAT_SET_INLINE
+
+/// binary search narrows the heap array down to this many ids, then a linear SIMD scan
+#ifndef FLAT_SET_LINEAR_SCAN
+#define FLAT_SET_LINEAR_SCAN 32
+#endif // !FLAT_SET_LINEAR_SCAN
+
+namespace Septem
+{
+	/*
+	*	Flat Adjacency Set
+	*	sorted int32 ids in one contiguous array
+	*	up to InlineNum ids live inside the object, no allocation for small degrees
+	*	membership: binary search down to FLAT_SET_LINEAR_SCAN ids, then SSE2 compare 4 at a time
+	*	insert/erase are O(n) memmove, meant for read mostly adjacency
+	*	std::set<int32> compatible subset: insert find count erase size empty begin end clear
+	*	iterators are plain pointers and invalidated by insert/erase
+	*	No Thread Safe
+	*/
+	template<int32 InlineNum = DEFAULT_FLAT_SET_INLINE>
+	class TFlatAdjacencySet
+	{
+		static_assert(InlineNum >= 2, "TFlatAdjacencySet needs room for a heap pointer inline");
+
+	public:
+		typedef int32 value_type;
+		typedef const int32* iterator;
+		typedef const int32* const_iterator;
+
+		TFlatAdjacencySet()
+			:Num(0)
+			, Capacity(InlineNum)
+		{}
+
+		TFlatAdjacencySet(const TFlatAdjacencySet& InOther)
+			:Num(0)
+			, Capacity(InlineNum)
+		{
+			CopyFrom(InOther);
+		}
+
+		TFlatAdjacencySet(TFlatAdjacencySet&& InOther)
+			:Num(0)
+			, Capacity(InlineNum)
+		{
+			MoveFrom(InOther);
+		}
+
+		~TFlatAdjacencySet()
+		{
+			FreeHeap();
+		}
+
+		TFlatAdjacencySet& operator=(const TFlatAdjacencySet& InOther)
+		{
+			if (this != &InOther)
+			{
+				Num = 0;
+				CopyFrom(InOther);
+			}
+			return *this;
+		}
+
+		TFlatAdjacencySet& operator=(TFlatAdjacencySet&& InOther)
+		{
+			if (this != &InOther)
+			{
+				FreeHeap();
+				Num = 0;
+				Capacity = InlineNum;
+				MoveFrom(InOther);
+			}
+			return *this;
+		}
+
+		const int32* begin() const { return Data(); }
+		const int32* end() const { return Data() + Num; }
+		int32 size() const { return Num; }
+		bool empty() const { return Num == 0; }
+		bool IsInline() const { return Capacity == InlineNum; }
+
+		void clear()
+		{
+			FreeHeap();
+			Num = 0;
+			Capacity = InlineNum;
+		}
+
+		void reserve(int32 InCapacity)
+		{
+			if (InCapacity > Capacity)
+			{
+				Grow(InCapacity);
+			}
+		}
+
+		bool Contains(int32 InId) const
+		{
+			return IndexOf(InId) >= 0;
+		}
+
+		int32 count(int32 InId) const
+		{
+			return Contains(InId) ? 1 : 0;
+		}
+
+		const int32* find(int32 InId) const
+		{
+			int32 index = IndexOf(InId);
+			return index >= 0 ? Data() + index : end();
+		}
+
+		/*
+		* @return position of InId, true if it was not in the set
+		*/
+		std::pair<const int32*, bool> insert(int32 InId)
+		{
+			int32 pos = LowerBound(InId);
+			if (pos < Num && Data()[pos] == InId)
+			{
+				return std::pair<const int32*, bool>(Data() + pos, false);
+			}
+
+			if (Num == Capacity)
+			{
+				Grow(Capacity * 2);
+			}
+			int32* data = Data();
+			memmove(data + pos + 1, data + pos, sizeof(int32) * (SIZE_T)(Num - pos));
+			data[pos] = InId;
+			++Num;
+			return std::pair<const int32*, bool>(data + pos, true);
+		}
+
+		// UE style alias
+		void Add(int32 InId)
+		{
+			insert(InId);
+		}
+
+		// @return number of removed ids, 0 or 1
+		int32 erase(int32 InId)
+		{
+			int32 index = IndexOf(InId);
+			if (index < 0)
+				return 0;
+
+			int32* data = Data();
+			memmove(data + index, data + index + 1, sizeof(int32) * (SIZE_T)(Num - index - 1));
+			--Num;
+			return 1;
+		}
+
+	protected:
+		int32* Data() { return IsInline() ? Storage.Inline : Storage.Heap; }
+		const int32* Data() const { return IsInline() ? Storage.Inline : Storage.Heap; }
+
+		// first position with Data()[pos] >= InId
+		int32 LowerBound(int32 InId) const
+		{
+			const int32* data = Data();
+			int32 low = 0;
+			int32 high = Num;
+			while (low < high)
+			{
+				int32 mid = low + ((high - low) >> 1);
+				if (data[mid] < InId)
+					low = mid + 1;
+				else
+					high = mid;
+			}
+			return low;
+		}
+
+		// -1 if not exist
+		int32 IndexOf(int32 InId) const
+		{
+			const int32* data = Data();
+			int32 low = 0;
+			int32 high = Num;
+			while (high - low > FLAT_SET_LINEAR_SCAN)
+			{
+				int32 mid = low + ((high - low) >> 1);
+				if (data[mid] < InId)
+					low = mid + 1;
+				else
+					high = mid;
+			}
+			// InId is in [low, high] if present, high may be the match itself
+			if (high < Num)
+			{
+				++high;
+			}
+
+			int32 i = low;
+#if FLAT_SET_SSE2
+			const __m128i key = _mm_set1_epi32(InId);
+			for (; i + 4 <= high; i += 4)
+			{
+				__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+				int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(block, key)));
+				if (mask)
+				{
+					return i + __builtin_ctz((uint32)mask);
+				}
+			}
+#endif
+			for (; i < high; ++i)
+			{
+				if (data[i] == InId)
+					return i;
+			}
+			return -1;
+		}
+
+		void Grow(int32 InCapacity)
+		{
+			int32* heap = (int32*)malloc(sizeof(int32) * (SIZE_T)InCapacity);
+			check(heap);
+			memcpy(heap, Data(), sizeof(int32) * (SIZE_T)Num);
+			FreeHeap();
+			Storage.Heap = heap;
+			Capacity = InCapacity;
+		}
+
+		void FreeHeap()
+		{
+			if (!IsInline())
+			{
+				free(Storage.Heap);
+			}
+		}
+
+		void CopyFrom(const TFlatAdjacencySet& InOther)
+		{
+			reserve(InOther.Num);
+			memcpy(Data(), InOther.Data(), sizeof(int32) * (SIZE_T)InOther.Num);
+			Num = InOther.Num;
+		}
+
+		void MoveFrom(TFlatAdjacencySet& InOther)
+		{
+			if (InOther.IsInline())
+			{
+				memcpy(Storage.Inline, InOther.Storage.Inline, sizeof(int32) * (SIZE_T)InOther.Num);
+			}
+			else
+			{
+				Storage.Heap = InOther.Storage.Heap;
+				Capacity = InOther.Capacity;
+				InOther.Capacity = InlineNum;
+			}
+			Num = InOther.Num;
+			InOther.Num = 0;
+		}
+
+	private:
+		int32 Num;
+		// == InlineNum while the ids are inline
+		int32 Capacity;
+		union
+		{
+			int32 Inline[InlineNum];
+			int32* Heap;
+		} Storage;
+	};
+}
@@ -23,10 +23,11 @@ namespace Septem
 	{
 		/*
 		*	Backward Graph
+		*	AdjustListType: EdgeAdjustList (set<int32>) or FlatEdgeAdjustList (flat sorted array)
 		*	No Thread Safe
 		*/
-		template<typename VT, typename ET>
-		class TBackwardGraph : public TDirectedGraph<VT, ET>
+		template<typename VT, typename ET, typename EdgePolicy = FEdgeMapTreePolicy, typename AdjustListType = EdgeAdjustList>
+		class TBackwardGraph : public TDirectedGraph<VT, ET, EdgePolicy>
 		{
 		public:
 			TBackwardGraph();
@@ -36,31 +37,38 @@ namespace Septem
 			virtual void AddVertex(VT&& InVT) override;
 			virtual bool AddEdge(TEdge<ET>& InEdge) override;
 			virtual void Reset() override;
+
+			// parents of InIndex in AdjustVertexes
+			const AdjustListType& GetParentEdges(int32 InIndex) const { return ParentEdges[InIndex]; }
+			bool IsParent(int32 InIndex, int32 InParentId) const { return ParentEdges[InIndex].AdjustVertexes.count(InParentId) > 0; }
 		protected:
+			// rebuild ParentEdges after DeserializeBulk
+			virtual void OnBulkLoaded() override;
+
 #if UE_STYLE_CONTAINER
-			TArray< EdgeAdjustList > ParentEdges;
+			TArray< AdjustListType > ParentEdges;
 #else
-			std::vector< EdgeAdjustList > ParentEdges;
+			std::vector< AdjustListType > ParentEdges;
 #endif
 		};
 
 		
-		template<typename VT, typename ET>
-		TBackwardGraph<VT, ET>::TBackwardGraph()
-			:TDirectedGraph<VT, ET>()
+		template<typename VT, typename ET, typename EdgePolicy, typename AdjustListType>
+		TBackwardGraph<VT, ET, EdgePolicy, AdjustListType>::TBackwardGraph()
+			:TDirectedGraph<VT, ET, EdgePolicy>()
 		{
 		}
 
-		template<typename VT, typename ET>
-		TBackwardGraph<VT, ET>::~TBackwardGraph()
+		template<typename VT, typename ET, typename EdgePolicy, typename AdjustListType>
+		TBackwardGraph<VT, ET, EdgePolicy, AdjustListType>::~TBackwardGraph()
 		{
 		}
 
-		template<typename VT, typename ET>
-		inline void TBackwardGraph<VT, ET>::AddVertex(VT & InVT)
+		template<typename VT, typename ET, typename EdgePolicy, typename AdjustListType>
+		inline void TBackwardGraph<VT, ET, EdgePolicy, AdjustListType>::AddVertex(VT & InVT)
 		{
-			EdgeAdjustList eal(TDirectedGraph<VT, ET>::VertexCount());
-			TDirectedGraph<VT, ET>::AddVertex(InVT);
+			AdjustListType eal(TDirectedGraph<VT, ET, EdgePolicy>::VertexCount());
+			TDirectedGraph<VT, ET, EdgePolicy>::AddVertex(InVT);
 #if UE_STYLE_CONTAINER
 			ParentEdges.Add(eal);
 #else
@@ -68,11 +76,11 @@ namespace Septem
 #endif
 		}
 
-		template<typename VT, typename ET>
-		inline void TBackwardGraph<VT, ET>::AddVertex(VT && InVT)
+		template<typename VT, typename ET, typename EdgePolicy, typename AdjustListType>
+		inline void TBackwardGraph<VT, ET, EdgePolicy, AdjustListType>::AddVertex(VT && InVT)
 		{
-			EdgeAdjustList eal(TDirectedGraph<VT, ET>::VertexCount());
-			TDirectedGraph<VT, ET>::AddVertex(InVT);
+			AdjustListType eal(TDirectedGraph<VT, ET, EdgePolicy>::VertexCount());
+			TDirectedGraph<VT, ET, EdgePolicy>::AddVertex(InVT);
 #if UE_STYLE_CONTAINER
 			ParentEdges.Add(eal);
 #else
@@ -80,10 +88,10 @@ namespace Septem
 #endif
 		}
 
-		template<typename VT, typename ET>
-		inline bool TBackwardGraph<VT, ET>::AddEdge(TEdge<ET>& InEdge)
+		template<typename VT, typename ET, typename EdgePolicy, typename AdjustListType>
+		inline bool TBackwardGraph<VT, ET, EdgePolicy, AdjustListType>::AddEdge(TEdge<ET>& InEdge)
 		{
-			if (TDirectedGraph<VT, ET>::AddEdge(InEdge))
+			if (TDirectedGraph<VT, ET, EdgePolicy>::AddEdge(InEdge))
 			{
 #if UE_STYLE_CONTAINER
 				ParentEdges[InEdge.EndId].AdjustVertexes.Add(InEdge.StartId);
@@ -95,10 +103,10 @@ namespace Septem
 			return false;
 		}
 
-		template<typename VT, typename ET>
-		inline void TBackwardGraph<VT, ET>::Reset()
+		template<typename VT, typename ET, typename EdgePolicy, typename AdjustListType>
+		inline void TBackwardGraph<VT, ET, EdgePolicy, AdjustListType>::Reset()
 		{
-			TDirectedGraph<VT, ET>::Reset();
+			TDirectedGraph<VT, ET, EdgePolicy>::Reset();
 #if UE_STYLE_CONTAINER
 			ParentEdges.Reset();
 #else
@@ -106,5 +114,33 @@ namespace Septem
 #endif
 		}
 
+	
+		template<typename VT, typename ET, typename EdgePolicy, typename AdjustListType>
+		inline void TBackwardGraph<VT, ET, EdgePolicy, AdjustListType>::OnBulkLoaded()
+		{
+			const int32 _VertexCount = TDirectedGraph<VT, ET, EdgePolicy>::VertexCount();
+#if UE_STYLE_CONTAINER
+			ParentEdges.Reset();
+			for (int32 i = 0; i < _VertexCount; ++i)
+			{
+				ParentEdges.Add(AdjustListType(i));
+			}
+#else
+			ParentEdges.clear();
+			ParentEdges.reserve((SIZE_T)_VertexCount);
+			for (int32 i = 0; i < _VertexCount; ++i)
+			{
+				ParentEdges.push_back(AdjustListType(i));
+			}
+#endif
+			TDirectedGraph<VT, ET, EdgePolicy>::ForEachEdge([this](const TEdge<ET>& InEdge)
+			{
+#if UE_STYLE_CONTAINER
+				ParentEdges[InEdge.EndId].AdjustVertexes.Add(InEdge.StartId);
+#else
+				ParentEdges[InEdge.EndId].AdjustVertexes.insert(InEdge.StartId);
+#endif
+			});
+		}
 	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,144 @@
+/*
+	Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+	LICENSE:	GNU General Public License V3.0
+
+	As a special exception,  you may use this file  as part of a free software library without
+	restriction.  Specifically,  if other files instantiate templates  or use macros or inline
+	functions from this file, or you compile this file and link it with other files to produce
+	an executable,  this file does not by itself cause the resulting executable to be covered
+	by the GNU General Public License. This exception does not however invalidate any other
+	reasons why the executable file might be covered by the GNU General Public License.
+
+	Support Email:	guij@sari.ac.cn
+*/
+
+#pragma once
+
+#include "DirectedGraph.hpp"
+#include <Core/Thread/SeptemEpoch.hpp>
+
+#include <atomic>
+#include <mutex>
+
+namespace Septem
+{
+	namespace GraphTheory
+	{
+		/*
+		*	Concurrent Directed Graph
+		*	RCU style: readers see an immutable TDirectedGraph published through an atomic pointer
+		*	writers copy the current version, change the copy off to the side and publish it,
+		*	the old version is freed by FEpochManager once no reader can still see it
+		*	readers take no lock and never block, writers are serialized by a mutex
+		*	GraphType: TDirectedGraph (default) / TBackwardGraph over the same VT, ET
+		*/
+		template<typename VT, typename ET, typename GraphType = TDirectedGraph<VT, ET> >
+		class TConcurrentDirectedGraph
+		{
+		public:
+			/*
+			* pinned version for one reader scope, keep it short lived
+			* the graph is shared with other readers: const, lookups only
+			*/
+			class FReadHandle
+			{
+			public:
+				explicit FReadHandle(TConcurrentDirectedGraph& InOwner)
+					:Guard(InOwner.Epoch)
+					, Graph(InOwner.Current.load(std::memory_order_seq_cst))
+				{}
+
+				const GraphType& Get() const { return *Graph; }
+				const GraphType* operator->() const { return Graph; }
+
+			private:
+				FEpochGuard Guard;
+				const GraphType* Graph;
+			};
+
+			TConcurrentDirectedGraph()
+				:Current(new GraphType())
+				, Version(0)
+			{}
+
+			virtual ~TConcurrentDirectedGraph()
+			{
+				delete Current.load(std::memory_order_relaxed);
+			}
+
+			/*
+			* run InFunc(const GraphType&) on the current version inside an epoch
+			* @return what InFunc returns
+			*/
+			template<typename FuncType>
+			auto Read(FuncType&& InFunc) -> decltype(InFunc(*(const GraphType*)nullptr))
+			{
+				FReadHandle handle(*this);
+				return InFunc(handle.Get());
+			}
+
+			// common lookups, each one is a separate read scope
+			bool IsValidEdge(int32 InStartId, int32 InEndId)
+			{
+				return Read([=](const GraphType& InGraph) { return InGraph.IsValidEdge(InStartId, InEndId); });
+			}
+
+			int32 VertexCount()
+			{
+				return Read([](const GraphType& InGraph) { return InGraph.VertexCount(); });
+			}
+
+			int32 EdgeCount()
+			{
+				return Read([](const GraphType& InGraph) { return InGraph.EdgeCount(); });
+			}
+
+			/*
+			* copy the current version, run InFunc(GraphType&) on the copy and publish it
+			* readers keep the old version until their scope ends
+			*/
+			template<typename FuncType>
+			void Update(FuncType&& InFunc)
+			{
+				std::lock_guard<std::mutex> scopelock(WriterLock);
+				GraphType* _next = new GraphType(*Current.load(std::memory_order_relaxed));
+				InFunc(*_next);
+				PublishLocked(_next);
+			}
+
+			/*
+			* publish a graph built elsewhere, takes ownership of InNext
+			*/
+			void Publish(GraphType* InNext)
+			{
+				std::lock_guard<std::mutex> scopelock(WriterLock);
+				PublishLocked(InNext);
+			}
+
+			// times a new version was published
+			uint64 GetVersion() const { return Version.load(std::memory_order_acquire); }
+
+			// retry freeing old versions, @return versions still pinned by readers
+			int32 Reclaim() { return Epoch.Reclaim(); }
+
+		protected:
+			void PublishLocked(GraphType* InNext)
+			{
+				check(InNext);
+				GraphType* _old = Current.exchange(InNext, std::memory_order_seq_cst);
+				Version.fetch_add(1, std::memory_order_release);
+				Epoch.Retire(_old);
+			}
+
+		private:
+			TConcurrentDirectedGraph(const TConcurrentDirectedGraph&);
+			TConcurrentDirectedGraph& operator=(const TConcurrentDirectedGraph&);
+
+			std::atomic<GraphType*> Current;
+			std::atomic<uint64> Version;
+			std::mutex WriterLock;
+			FEpochManager Epoch;
+		};
+	}
+}
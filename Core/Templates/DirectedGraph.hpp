@@ -25,18 +25,82 @@
 #include <map>
 #endif // UE_STYLE_CONTAINER
 
+#include <Core/Containers/SeptemFlatHashMap.h>
+
 #include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+
+#ifdef LINUX
+#include <sys/uio.h>
+#include <errno.h>
+#endif // LINUX
+
+/// "GRPH" little endian
+#define GRAPH_BULK_MAGIC 0x48505247u
+#define GRAPH_BULK_VERSION 1u
 
 
 namespace Septem
 {
 	namespace GraphTheory
 	{
+		/*
+		*	Edge container policies of TDirectedGraph
+		*	TEdgeMap<ET>:	map of HashEdgeKey -> TEdge<ET>, std::map like interface
+		*	Reserve:		pre-size the map before bulk loading
+		*	the policy is ignored with UE_STYLE_CONTAINER, TMap is used there
+		*/
+
+		// ordered tree, O(log E) lookup, edges iterate sorted by (start, end)
+		struct FEdgeMapTreePolicy
+		{
+			template<typename ET>
+			using TEdgeMap = std::map<uint64, TEdge<ET> >;
+
+			template<typename MapType>
+			static void Reserve(MapType&, SIZE_T) {}
+		};
+
+		// flat open addressing hash, about one cache miss per lookup, unordered
+		struct FEdgeMapHashPolicy
+		{
+			template<typename ET>
+			using TEdgeMap = TFlatHashMap<uint64, TEdge<ET> >;
+
+			template<typename MapType>
+			static void Reserve(MapType& InMap, SIZE_T InCount)
+			{
+				InMap.reserve(InCount);
+			}
+		};
+
+		/*
+		*	header of the bulk graph format
+		*	[ FGraphBulkHeader ][ TVertex<VT> x VertexCount ][ TEdge<ET> x EdgeCount, sorted by (start, end) ]
+		*	Checksum covers the vertex and edge arrays
+		*/
+#pragma pack(push, 1)
+		struct FGraphBulkHeader
+		{
+			uint32 Magic;
+			uint16 Version;
+			uint8 bDirectSelf;
+			uint8 Reserved;
+			uint32 VertexStride;	// sizeof(TVertex<VT>)
+			uint32 EdgeStride;		// sizeof(TEdge<ET>)
+			int32 VertexCount;
+			int32 EdgeCount;
+			uint64 Checksum;
+		};
+#pragma pack(pop)
+
 		/*
 		*	Directed Graph
 		*	No Thread Safe
+		*	EdgePolicy: FEdgeMapTreePolicy (default) or FEdgeMapHashPolicy
 		*/
-		template<typename VT, typename ET>
+		template<typename VT, typename ET, typename EdgePolicy = FEdgeMapTreePolicy>
 		class TDirectedGraph
 		{
 		public:
@@ -49,6 +113,7 @@ namespace Septem
 			* need to check IsValidVertexIndex before
 			*/
 			TVertex<VT>& GetVertex(int32 InIndex);
+			const TVertex<VT>& GetVertex(int32 InIndex) const;
 			/*
 			* unsafe call to get edge&
 			* need to check IsValidEdge before 
@@ -59,30 +124,82 @@ namespace Septem
 			* need to check IsValidEdge before
 			*/
 			TEdge<ET>& GetEdge(uint64 InKey);
+			/*
+			* read only lookup, never inserts: safe on a graph shared with other readers
+			* a missing edge fails check(), release builds get a zeroed edge
+			*/
+			const TEdge<ET>& GetEdge(int32 InStartIndex, int32 InEndIndex) const;
+			const TEdge<ET>& GetEdge(uint64 InKey) const;
 			
 #if UE_STYLE_CONTAINER
 			/*
 			* get keys array of edge map
 			* @ return	the count of the keys
 			*/
-			int32 GetEdgeKeys(TArray<uint64>& OutKeys);
+			int32 GetEdgeKeys(TArray<uint64>& OutKeys) const;
 #else
 			/*
 			* get keys array of edge map
 			* @ return	the count of the keys
 			*/
-			int32 GetEdgeKeys(std::vector<uint64>& OutKeys);
+			int32 GetEdgeKeys(std::vector<uint64>& OutKeys) const;
 #endif
-			bool IsValidVertexIndex(int32 InIndex);
-			bool IsValidEdge(int32 InStartId, int32 InEndId);
-			int32 VertexCount();
-			SIZE_T VertexSize();
-			int32 EdgeCount();
-			SIZE_T EdgeSize();
+			/*
+			* pre-size the edge container for InCount edges
+			* no rehash while bulk loading with FEdgeMapHashPolicy
+			*/
+			void ReserveEdges(int32 InCount);
+
+			bool IsValidVertexIndex(int32 InIndex) const;
+			bool IsValidEdge(int32 InStartId, int32 InEndId) const;
+			int32 VertexCount() const;
+			SIZE_T VertexSize() const;
+			int32 EdgeCount() const;
+			SIZE_T EdgeSize() const;
 			static uint64 HashEdgeKey(uint64 InStartId, uint64 InEndId);
 
+			/*
+			* visit every edge once, in the order of the edge map
+			* InFunc: void(const TEdge<ET>&)
+			*/
+			template<typename FuncType>
+			void ForEachEdge(FuncType&& InFunc) const;
+
 			void Seriallize(uint8* OutBuffer, SIZE_T& OutSize, bool bAllocBuffer);
 			void Deseriallize(uint8* InBuffer, SIZE_T InSize);
+
+			/*
+			* bytes needed by SerializeBulk
+			*/
+			SIZE_T BulkSize();
+			/*
+			* bulk binary format, see FGraphBulkHeader
+			* vertices are one memcpy, edges are one sorted array
+			* @return false if InBufferSize < BulkSize()
+			*/
+			bool SerializeBulk(uint8* OutBuffer, SIZE_T InBufferSize, SIZE_T& OutSize);
+			/*
+			* write the bulk format into a file descriptor with one writev
+			* @return false on io error
+			*/
+			bool WriteBulk(int InFd);
+			/*
+			* load the bulk format
+			* bVerifyChecksum = true:	checksum must match, then edges are bulk inserted without per edge validation
+			* bVerifyChecksum = false:	no checksum pass, every edge goes through AddEdge validation
+			* @return false if the header, size or checksum is wrong
+			*/
+			bool DeserializeBulk(const uint8* InBuffer, SIZE_T InSize, bool bVerifyChecksum = true);
+		protected:
+			/*
+			* called after DeserializeBulk filled VertexArray & EdgeMap directly
+			* derived graphs rebuild their own indexes here
+			*/
+			virtual void OnBulkLoaded() {}
+
+			// edges sorted by (start, end), the order of the bulk format
+			void GetSortedEdges(std::vector< TEdge<ET> >& OutEdges);
+			void MakeBulkHeader(FGraphBulkHeader& OutHeader, std::vector< TEdge<ET> >& InSortedEdges);
 		protected:
 			/// can direct to self , default = false
 			bool bDirectSelf;
@@ -92,7 +209,7 @@ namespace Septem
 			TMap<uint64, TEdge<ET> > EdgeMap;
 #else
 			std::vector<TVertex<VT>> VertexArray;
-			std::map<uint64, TEdge<ET> > EdgeMap;
+			typename EdgePolicy::template TEdgeMap<ET> EdgeMap;
 #endif
 
 		public:
@@ -103,8 +220,8 @@ namespace Septem
 			virtual ~TDirectedGraph() {}
 		};
 
-		template<typename VT, typename ET>
-		inline void TDirectedGraph<VT, ET>::AddVertex(VT & InVT)
+		template<typename VT, typename ET, typename EdgePolicy>
+		inline void TDirectedGraph<VT, ET, EdgePolicy>::AddVertex(VT & InVT)
 		{
 #if UE_STYLE_CONTAINER
 			TVertex<VT> vertex
@@ -117,8 +234,8 @@ namespace Septem
 #endif
 		}
 
-		template<typename VT, typename ET>
-		inline void TDirectedGraph<VT, ET>::AddVertex(VT && InVT)
+		template<typename VT, typename ET, typename EdgePolicy>
+		inline void TDirectedGraph<VT, ET, EdgePolicy>::AddVertex(VT && InVT)
 		{
 #if UE_STYLE_CONTAINER
 			TVertex<VT> vertex 
@@ -131,8 +248,8 @@ namespace Septem
 #endif
 		}
 
-		template<typename VT, typename ET>
-		inline bool TDirectedGraph<VT, ET>::AddEdge(TEdge<ET>& InEdge)
+		template<typename VT, typename ET, typename EdgePolicy>
+		inline bool TDirectedGraph<VT, ET, EdgePolicy>::AddEdge(TEdge<ET>& InEdge)
 		{
 			if (InEdge.StartId == InEdge.EndId)
 			{
@@ -158,8 +275,8 @@ namespace Septem
 			return false;
 		}
 
-		template<typename VT, typename ET>
-		inline void TDirectedGraph<VT, ET>::Reset()
+		template<typename VT, typename ET, typename EdgePolicy>
+		inline void TDirectedGraph<VT, ET, EdgePolicy>::Reset()
 		{
 #if UE_STYLE_CONTAINER
 			VertexArray.Reset();
@@ -170,33 +287,60 @@ namespace Septem
 #endif
 		}
 
-		template<typename VT, typename ET>
-		inline TVertex<VT> & TDirectedGraph<VT, ET>::GetVertex(int32 InIndex)
+		template<typename VT, typename ET, typename EdgePolicy>
+		inline TVertex<VT> & TDirectedGraph<VT, ET, EdgePolicy>::GetVertex(int32 InIndex)
 		{
 			return VertexArray[InIndex];
 		}
-		template<typename VT, typename ET>
-		inline TEdge<ET>& TDirectedGraph<VT, ET>::GetEdge(int32 InStartIndex, int32 InEndIndex)
+		template<typename VT, typename ET, typename EdgePolicy>
+		inline TEdge<ET>& TDirectedGraph<VT, ET, EdgePolicy>::GetEdge(int32 InStartIndex, int32 InEndIndex)
 		{
 			uint64 key = HashEdgeKey(InStartIndex, InEndIndex);
 			return EdgeMap[key];
 		}
 
-		template<typename VT, typename ET>
-		inline TEdge<ET>& TDirectedGraph<VT, ET>::GetEdge(uint64 InKey)
+		template<typename VT, typename ET, typename EdgePolicy>
+		inline TEdge<ET>& TDirectedGraph<VT, ET, EdgePolicy>::GetEdge(uint64 InKey)
 		{
 			return EdgeMap[InKey];
 		}
 
+		template<typename VT, typename ET, typename EdgePolicy>
+		inline const TVertex<VT> & TDirectedGraph<VT, ET, EdgePolicy>::GetVertex(int32 InIndex) const
+		{
+			return VertexArray[InIndex];
+		}
+
+		template<typename VT, typename ET, typename EdgePolicy>
+		inline const TEdge<ET>& TDirectedGraph<VT, ET, EdgePolicy>::GetEdge(int32 InStartIndex, int32 InEndIndex) const
+		{
+			return GetEdge(HashEdgeKey(InStartIndex, InEndIndex));
+		}
+
+		template<typename VT, typename ET, typename EdgePolicy>
+		inline const TEdge<ET>& TDirectedGraph<VT, ET, EdgePolicy>::GetEdge(uint64 InKey) const
+		{
+			static const TEdge<ET> _missing = TEdge<ET>();
+#if UE_STYLE_CONTAINER
+			const TEdge<ET>* _edge = EdgeMap.Find(InKey);
+			check(_edge);
+			return _edge ? *_edge : _missing;
+#else
+			auto itr = EdgeMap.find(InKey);
+			check(itr != EdgeMap.end());
+			return itr != EdgeMap.end() ? itr->second : _missing;
+#endif
+		}
+
 #if UE_STYLE_CONTAINER		
-		template<typename VT, typename ET>
-		inline int32 TDirectedGraph<VT, ET>::GetEdgeKeys(TArray<uint64>& OutKeys)
+		template<typename VT, typename ET, typename EdgePolicy>
+		inline int32 TDirectedGraph<VT, ET, EdgePolicy>::GetEdgeKeys(TArray<uint64>& OutKeys) const
 		{
 			return EdgeMap.GetKeys(OutKeys);
 		}
 #else
-		template<typename VT, typename ET>
-		inline int32 TDirectedGraph<VT, ET>::GetEdgeKeys(std::vector<uint64>& OutKeys)
+		template<typename VT, typename ET, typename EdgePolicy>
+		inline int32 TDirectedGraph<VT, ET, EdgePolicy>::GetEdgeKeys(std::vector<uint64>& OutKeys) const
 		{
 			int32 ret = (int32)EdgeMap.size();
 			OutKeys.clear();
@@ -208,8 +352,16 @@ namespace Septem
 		}
 #endif
 
-		template<typename VT, typename ET>
-		inline bool TDirectedGraph<VT, ET>::IsValidVertexIndex(int32 InIndex)
+		template<typename VT, typename ET, typename EdgePolicy>
+		inline void TDirectedGraph<VT, ET, EdgePolicy>::ReserveEdges(int32 InCount)
+		{
+#if !UE_STYLE_CONTAINER
+			EdgePolicy::Reserve(EdgeMap, (SIZE_T)InCount);
+#endif
+		}
+
+		template<typename VT, typename ET, typename EdgePolicy>
+		inline bool TDirectedGraph<VT, ET, EdgePolicy>::IsValidVertexIndex(int32 InIndex) const
 		{
 #if UE_STYLE_CONTAINER
 			return InIndex >= 0 && InIndex < VertexArray.Num();
@@ -217,8 +369,8 @@ namespace Septem
 			return InIndex >= 0 && InIndex < (int32)VertexArray.size();
 #endif
 		}
-		template<typename VT, typename ET>
-		inline bool TDirectedGraph<VT, ET>::IsValidEdge(int32 InStartId, int32 InEndId)
+		template<typename VT, typename ET, typename EdgePolicy>
+		inline bool TDirectedGraph<VT, ET, EdgePolicy>::IsValidEdge(int32 InStartId, int32 InEndId) const
 		{
 			uint64 key = HashEdgeKey((uint64)InStartId, (uint64)InEndId);
 #if UE_STYLE_CONTAINER
@@ -227,8 +379,8 @@ namespace Septem
 			return EdgeMap.find(key) != EdgeMap.end();
 #endif
 		}
-		template<typename VT, typename ET>
-		inline int32 TDirectedGraph<VT, ET>::VertexCount()
+		template<typename VT, typename ET, typename EdgePolicy>
+		inline int32 TDirectedGraph<VT, ET, EdgePolicy>::VertexCount() const
 		{
 #if UE_STYLE_CONTAINER
 			return VertexArray.Num();
@@ -237,8 +389,8 @@ namespace Septem
 #endif
 		}
 
-		template<typename VT, typename ET>
-		inline SIZE_T TDirectedGraph<VT, ET>::VertexSize()
+		template<typename VT, typename ET, typename EdgePolicy>
+		inline SIZE_T TDirectedGraph<VT, ET, EdgePolicy>::VertexSize() const
 		{
 #if UE_STYLE_CONTAINER
 			return (SIZE_T)VertexArray.Num();
@@ -247,8 +399,8 @@ namespace Septem
 #endif
 		}
 
-		template<typename VT, typename ET>
-		inline int32 TDirectedGraph<VT, ET>::EdgeCount()
+		template<typename VT, typename ET, typename EdgePolicy>
+		inline int32 TDirectedGraph<VT, ET, EdgePolicy>::EdgeCount() const
 		{
 #if UE_STYLE_CONTAINER
 			return EdgeMap.Num();
@@ -257,8 +409,8 @@ namespace Septem
 #endif
 		}
 
-		template<typename VT, typename ET>
-		inline SIZE_T TDirectedGraph<VT, ET>::EdgeSize()
+		template<typename VT, typename ET, typename EdgePolicy>
+		inline SIZE_T TDirectedGraph<VT, ET, EdgePolicy>::EdgeSize() const
 		{
 #if UE_STYLE_CONTAINER
 			return (SIZE_T)EdgeMap.Num();
@@ -267,12 +419,31 @@ namespace Septem
 #endif
 		}
 
-		template<typename VT, typename ET>
-		uint64 TDirectedGraph<VT, ET>::HashEdgeKey(uint64 InStartId, uint64 InEndId)
+		template<typename VT, typename ET, typename EdgePolicy>
+		uint64 TDirectedGraph<VT, ET, EdgePolicy>::HashEdgeKey(uint64 InStartId, uint64 InEndId)
 		{
 			return (InStartId << 32LL) | InEndId;
 		}
 
+		template<typename VT, typename ET, typename EdgePolicy>
+		template<typename FuncType>
+		inline void TDirectedGraph<VT, ET, EdgePolicy>::ForEachEdge(FuncType&& InFunc) const
+		{
+#if UE_STYLE_CONTAINER
+			TArray<uint64> _edgekeys;
+			int32 _EdgeCount = EdgeMap.GetKeys(_edgekeys);
+			for (int32 i = 0; i < _EdgeCount; ++i)
+			{
+				InFunc(EdgeMap[_edgekeys[i]]);
+			}
+#else
+			for (auto itr = EdgeMap.begin(); itr != EdgeMap.end(); itr++)
+			{
+				InFunc(itr->second);
+			}
+#endif
+		}
+
 		/*
 		*	{ Graph Memory }
 		*	+ sizeof(bDirectSelf)
@@ -284,8 +455,8 @@ namespace Septem
 		*	Total Size = 
 		*		sizeof(bDirectSelf) + sizeof(VertexArray.Num()) + sizeof(TVertex<VT>) * VertexArray.Num()	+ sizeof(EdgeMap.Num()) + sizeof(uint64)*EdgeMap.Num() + sizeof(TEdge<ET>)*EdgeMap.Num()
 		*/
-		template<typename VT, typename ET>
-		inline void TDirectedGraph<VT, ET>::Seriallize(uint8 * OutBuffer, SIZE_T & OutSize, bool bAllocBuffer)
+		template<typename VT, typename ET, typename EdgePolicy>
+		inline void TDirectedGraph<VT, ET, EdgePolicy>::Seriallize(uint8 * OutBuffer, SIZE_T & OutSize, bool bAllocBuffer)
 		{
 			//SIZE_T _tvertexSize = sizeof(TVertex<VT>);
 			//SIZE_T _tedgeSize = sizeof(TEdge<ET>);
@@ -358,8 +529,8 @@ namespace Septem
 		*	Total Size =
 		*		sizeof(bDirectSelf) + sizeof(VertexArray.Num()) + sizeof(TVertex<VT>) * VertexArray.Num()	+ sizeof(EdgeMap.Num()) + sizeof(uint64)*EdgeMap.Num() + sizeof(TEdge<ET>)*EdgeMap.Num()
 		*/
-		template<typename VT, typename ET>
-		inline void TDirectedGraph<VT, ET>::Deseriallize(uint8 * InBuffer, SIZE_T InSize)
+		template<typename VT, typename ET, typename EdgePolicy>
+		inline void TDirectedGraph<VT, ET, EdgePolicy>::Deseriallize(uint8 * InBuffer, SIZE_T InSize)
 		{
 			//SIZE_T _tvertexSize = sizeof(TVertex<VT>);
 			//SIZE_T _tedgeSize = sizeof(TEdge<ET>);
@@ -435,6 +606,7 @@ namespace Septem
 #else
 			EdgeMap.clear();
 #endif
+			ReserveEdges(_EdgeCount);
 			_Size = sizeof(TEdge<ET>);
 			TEdge<ET> _value;
 			for (int32 i = 0; i < _EdgeCount; ++i)
@@ -445,5 +617,225 @@ namespace Septem
 			}
 		}
 
+	
+		template<typename VT, typename ET, typename EdgePolicy>
+		inline void TDirectedGraph<VT, ET, EdgePolicy>::GetSortedEdges(std::vector< TEdge<ET> >& OutEdges)
+		{
+			OutEdges.clear();
+			OutEdges.reserve(EdgeSize());
+			ForEachEdge([&OutEdges](const TEdge<ET>& InEdge) { OutEdges.push_back(InEdge); });
+
+			auto less = [](const TEdge<ET>& A, const TEdge<ET>& B)
+			{
+				return HashEdgeKey((uint64)A.StartId, (uint64)A.EndId) < HashEdgeKey((uint64)B.StartId, (uint64)B.EndId);
+			};
+			// ordered edge maps are already sorted
+			if (!std::is_sorted(OutEdges.begin(), OutEdges.end(), less))
+			{
+				std::sort(OutEdges.begin(), OutEdges.end(), less);
+			}
+		}
+
+		template<typename VT, typename ET, typename EdgePolicy>
+		inline void TDirectedGraph<VT, ET, EdgePolicy>::MakeBulkHeader(FGraphBulkHeader& OutHeader, std::vector< TEdge<ET> >& InSortedEdges)
+		{
+			memset(&OutHeader, 0, sizeof(OutHeader));
+			OutHeader.Magic = GRAPH_BULK_MAGIC;
+			OutHeader.Version = GRAPH_BULK_VERSION;
+			OutHeader.bDirectSelf = bDirectSelf ? 1 : 0;
+			OutHeader.VertexStride = (uint32)sizeof(TVertex<VT>);
+			OutHeader.EdgeStride = (uint32)sizeof(TEdge<ET>);
+			OutHeader.VertexCount = VertexCount();
+			OutHeader.EdgeCount = (int32)InSortedEdges.size();
+
+#if UE_STYLE_CONTAINER
+			uint64 checksum = 0;
+			for (int32 i = 0; i < OutHeader.VertexCount; ++i)
+			{
+				checksum = GraphChecksum((const uint8*)&VertexArray[i], sizeof(TVertex<VT>), checksum);
+			}
+#else
+			uint64 checksum = GraphChecksum((const uint8*)VertexArray.data(), sizeof(TVertex<VT>) * VertexArray.size());
+#endif
+			OutHeader.Checksum = GraphChecksum((const uint8*)InSortedEdges.data(), sizeof(TEdge<ET>) * InSortedEdges.size(), checksum);
+		}
+
+		template<typename VT, typename ET, typename EdgePolicy>
+		inline SIZE_T TDirectedGraph<VT, ET, EdgePolicy>::BulkSize()
+		{
+			return sizeof(FGraphBulkHeader) + sizeof(TVertex<VT>) * VertexSize() + sizeof(TEdge<ET>) * EdgeSize();
+		}
+
+		template<typename VT, typename ET, typename EdgePolicy>
+		inline bool TDirectedGraph<VT, ET, EdgePolicy>::SerializeBulk(uint8* OutBuffer, SIZE_T InBufferSize, SIZE_T& OutSize)
+		{
+			OutSize = BulkSize();
+			if (InBufferSize < OutSize)
+			{
+				OutSize = 0;
+				return false;
+			}
+
+			std::vector< TEdge<ET> > _edges;
+			GetSortedEdges(_edges);
+			FGraphBulkHeader _header;
+			MakeBulkHeader(_header, _edges);
+
+			SIZE_T _index = 0;
+			memcpy(OutBuffer + _index, &_header, sizeof(_header));
+			_index += sizeof(_header);
+
+#if UE_STYLE_CONTAINER
+			for (int32 i = 0; i < _header.VertexCount; ++i)
+			{
+				memcpy(OutBuffer + _index, &VertexArray[i], sizeof(TVertex<VT>));
+				_index += sizeof(TVertex<VT>);
+			}
+#else
+			memcpy(OutBuffer + _index, VertexArray.data(), sizeof(TVertex<VT>) * VertexArray.size());
+			_index += sizeof(TVertex<VT>) * VertexArray.size();
+#endif
+
+			memcpy(OutBuffer + _index, _edges.data(), sizeof(TEdge<ET>) * _edges.size());
+			return true;
+		}
+
+		template<typename VT, typename ET, typename EdgePolicy>
+		inline bool TDirectedGraph<VT, ET, EdgePolicy>::WriteBulk(int InFd)
+		{
+#if defined(LINUX) && !UE_STYLE_CONTAINER
+			std::vector< TEdge<ET> > _edges;
+			GetSortedEdges(_edges);
+			FGraphBulkHeader _header;
+			MakeBulkHeader(_header, _edges);
+
+			struct iovec _iov[3];
+			_iov[0].iov_base = &_header;
+			_iov[0].iov_len = sizeof(_header);
+			_iov[1].iov_base = VertexArray.data();
+			_iov[1].iov_len = sizeof(TVertex<VT>) * VertexArray.size();
+			_iov[2].iov_base = _edges.data();
+			_iov[2].iov_len = sizeof(TEdge<ET>) * _edges.size();
+
+			// writev may stop early on big files, continue from where it stopped
+			int32 _first = 0;
+			while (_first < 3)
+			{
+				ssize_t k = ::writev(InFd, _iov + _first, 3 - _first);
+				if (k < 0)
+				{
+					if (errno == EINTR)
+						continue;
+					return false;
+				}
+				SIZE_T _written = (SIZE_T)k;
+				while (_first < 3 && _written >= _iov[_first].iov_len)
+				{
+					_written -= _iov[_first].iov_len;
+					++_first;
+				}
+				if (_first < 3)
+				{
+					_iov[_first].iov_base = (uint8*)_iov[_first].iov_base + _written;
+					_iov[_first].iov_len -= _written;
+				}
+			}
+			return true;
+#else
+			SIZE_T _size = BulkSize();
+			std::vector<uint8> _buffer(_size);
+			SIZE_T _outSize = 0;
+			if (!SerializeBulk(_buffer.data(), _size, _outSize))
+				return false;
+			return ::write(InFd, _buffer.data(), _outSize) == (ssize_t)_outSize;
+#endif
+		}
+
+		template<typename VT, typename ET, typename EdgePolicy>
+		inline bool TDirectedGraph<VT, ET, EdgePolicy>::DeserializeBulk(const uint8* InBuffer, SIZE_T InSize, bool bVerifyChecksum)
+		{
+			FGraphBulkHeader _header;
+			if (InSize < sizeof(_header))
+				return false;
+			memcpy(&_header, InBuffer, sizeof(_header));
+
+			if (_header.Magic != GRAPH_BULK_MAGIC
+				|| _header.Version != GRAPH_BULK_VERSION
+				|| _header.VertexStride != sizeof(TVertex<VT>)
+				|| _header.EdgeStride != sizeof(TEdge<ET>)
+				|| _header.VertexCount < 0
+				|| _header.EdgeCount < 0)
+			{
+				return false;
+			}
+
+			const SIZE_T _vertexBytes = sizeof(TVertex<VT>) * (SIZE_T)_header.VertexCount;
+			const SIZE_T _edgeBytes = sizeof(TEdge<ET>) * (SIZE_T)_header.EdgeCount;
+			if (InSize < sizeof(_header) + _vertexBytes + _edgeBytes)
+				return false;
+
+			const uint8* _vertexPtr = InBuffer + sizeof(_header);
+			const uint8* _edgePtr = _vertexPtr + _vertexBytes;
+
+			if (bVerifyChecksum)
+			{
+				uint64 checksum = GraphChecksum(_vertexPtr, _vertexBytes);
+				checksum = GraphChecksum(_edgePtr, _edgeBytes, checksum);
+				if (checksum != _header.Checksum)
+					return false;
+			}
+
+			Reset();
+			bDirectSelf = _header.bDirectSelf != 0;
+
+			if (!bVerifyChecksum)
+			{
+				// untrusted buffer: go through the validating api
+				TVertex<VT> _tvertex;
+				for (int32 i = 0; i < _header.VertexCount; ++i)
+				{
+					memcpy(&_tvertex, _vertexPtr + sizeof(TVertex<VT>) * i, sizeof(TVertex<VT>));
+					AddVertex(_tvertex.Value);
+				}
+				ReserveEdges(_header.EdgeCount);
+				TEdge<ET> _edge;
+				for (int32 i = 0; i < _header.EdgeCount; ++i)
+				{
+					memcpy(&_edge, _edgePtr + sizeof(TEdge<ET>) * i, sizeof(TEdge<ET>));
+					AddEdge(_edge);
+				}
+				return true;
+			}
+
+#if UE_STYLE_CONTAINER
+			TVertex<VT> _tvertex;
+			for (int32 i = 0; i < _header.VertexCount; ++i)
+			{
+				memcpy(&_tvertex, _vertexPtr + sizeof(TVertex<VT>) * i, sizeof(TVertex<VT>));
+				VertexArray.Add(_tvertex);
+			}
+			TEdge<ET> _edge;
+			for (int32 i = 0; i < _header.EdgeCount; ++i)
+			{
+				memcpy(&_edge, _edgePtr + sizeof(TEdge<ET>) * i, sizeof(TEdge<ET>));
+				uint64 _key = HashEdgeKey((uint64)_edge.StartId, (uint64)_edge.EndId);
+				EdgeMap.Add(_key, _edge);
+			}
+#else
+			VertexArray.resize((SIZE_T)_header.VertexCount);
+			memcpy(VertexArray.data(), _vertexPtr, _vertexBytes);
+
+			ReserveEdges(_header.EdgeCount);
+			TEdge<ET> _edge;
+			for (int32 i = 0; i < _header.EdgeCount; ++i)
+			{
+				memcpy(&_edge, _edgePtr + sizeof(TEdge<ET>) * i, sizeof(TEdge<ET>));
+				// sorted input: hinted insert at end is amortized O(1) for std::map
+				EdgeMap.insert(EdgeMap.end(), std::pair< const uint64, TEdge<ET> >(HashEdgeKey((uint64)_edge.StartId, (uint64)_edge.EndId), _edge));
+			}
+#endif
+			OnBulkLoaded();
+			return true;
+		}
 	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,257 @@
+/*
+	Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+	LICENSE:	GNU General Public License V3.0
+
+	As a special exception,  you may use this file  as part of a free software library without
+	restriction.  Specifically,  if other files instantiate templates  or use macros or inline
+	functions from this file, or you compile this file and link it with other files to produce
+	an executable,  this file does not by itself cause the resulting executable to be covered
+	by the GNU General Public License. This exception does not however invalidate any other
+	reasons why the executable file might be covered by the GNU General Public License.
+
+	Support Email:	guij@sari.ac.cn
+*/
+
+#pragma once
+
+#include "GraphType.hpp"
+#include <vector>
+#include <algorithm>
+
+namespace Septem
+{
+	namespace GraphTheory
+	{
+		/*
+		*	contiguous [Begin, End) range for range-for loops
+		*/
+		template<typename T>
+		struct TCSRRange
+		{
+			const T* Begin;
+			const T* End;
+
+			const T* begin() const { return Begin; }
+			const T* end() const { return End; }
+			int32 Num() const { return (int32)(End - Begin); }
+			bool IsEmpty() const { return Begin == End; }
+			const T& operator[](int32 InIndex) const { return Begin[InIndex]; }
+		};
+
+		/*
+		*	Frozen CSR (compressed sparse row) view of a directed graph
+		*	out edges of vertex v:	Targets[ OutOffsets[v] .. OutOffsets[v+1] )	sorted by target
+		*	in edges of vertex v:	Sources[ InOffsets[v] .. InOffsets[v+1] )	sorted by source
+		*	InEdgeIds maps an in edge back to its slot in Targets/Weights
+		*	Build is O(V+E), the view does not follow later changes of the graph
+		*	Read only, Thread Safe after Build
+		*/
+		template<typename ET>
+		class TCSRGraph
+		{
+		public:
+			TCSRGraph() {}
+
+			/*
+			* build from TDirectedGraph / TBackwardGraph
+			* GraphType need VertexCount() EdgeCount() ForEachEdge()
+			*/
+			template<typename GraphType>
+			void Build(GraphType& InGraph);
+			// build from a flat edge list, edges must be unique per (StartId, EndId)
+			void Build(int32 InVertexCount, const std::vector< TEdge<ET> >& InEdges);
+
+			void Reset();
+
+			int32 VertexCount() const { return OutOffsets.empty() ? 0 : (int32)OutOffsets.size() - 1; }
+			int32 EdgeCount() const { return (int32)Targets.size(); }
+
+			int32 OutDegree(int32 InIndex) const { return OutOffsets[InIndex + 1] - OutOffsets[InIndex]; }
+			int32 InDegree(int32 InIndex) const { return InOffsets[InIndex + 1] - InOffsets[InIndex]; }
+
+			// children of InIndex
+			TCSRRange<int32> OutNeighbors(int32 InIndex) const;
+			// weights of the edges in OutNeighbors(InIndex), same order
+			TCSRRange<ET> OutWeights(int32 InIndex) const;
+			// parents of InIndex, what TBackwardGraph::ParentEdges keeps
+			TCSRRange<int32> InNeighbors(int32 InIndex) const;
+			// edge ids (index of Targets/Weights) of InNeighbors(InIndex), same order
+			TCSRRange<int32> InEdges(int32 InIndex) const;
+
+			// edge id of (InStartId -> InEndId), -1 if not exist. binary search in the row
+			int32 FindEdge(int32 InStartId, int32 InEndId) const;
+			bool IsValidEdge(int32 InStartId, int32 InEndId) const { return FindEdge(InStartId, InEndId) >= 0; }
+
+			// source vertex of an edge id, binary search in OutOffsets
+			int32 EdgeSource(int32 InEdgeId) const;
+
+			const std::vector<int32>& GetOutOffsets() const { return OutOffsets; }
+			const std::vector<int32>& GetTargets() const { return Targets; }
+			const std::vector<ET>& GetWeights() const { return Weights; }
+			const std::vector<int32>& GetInOffsets() const { return InOffsets; }
+			const std::vector<int32>& GetSources() const { return Sources; }
+			const std::vector<int32>& GetInEdgeIds() const { return InEdgeIds; }
+
+		protected:
+			std::vector<int32> OutOffsets;
+			std::vector<int32> Targets;
+			std::vector<ET> Weights;
+
+			std::vector<int32> InOffsets;
+			std::vector<int32> Sources;
+			std::vector<int32> InEdgeIds;
+		};
+
+		template<typename ET>
+		template<typename GraphType>
+		inline void TCSRGraph<ET>::Build(GraphType& InGraph)
+		{
+			// 1. flatten edges in map order
+			std::vector< TEdge<ET> > _edges;
+			_edges.reserve((SIZE_T)InGraph.EdgeCount());
+			InGraph.ForEachEdge([&_edges](const TEdge<ET>& InEdge) { _edges.push_back(InEdge); });
+
+			Build(InGraph.VertexCount(), _edges);
+		}
+
+		template<typename ET>
+		inline void TCSRGraph<ET>::Build(int32 InVertexCount, const std::vector< TEdge<ET> >& InEdges)
+		{
+			const int32 _VertexCount = InVertexCount;
+			const int32 _EdgeCount = (int32)InEdges.size();
+			const std::vector< TEdge<ET> >& _edges = InEdges;
+
+			Reset();
+
+			// 2. counting sort by EndId (LSD radix, first digit)
+			std::vector<int32> _byEnd((SIZE_T)_EdgeCount);
+			std::vector<int32> _cursor((SIZE_T)_VertexCount + 1, 0);
+			for (const TEdge<ET>& edge : _edges)
+			{
+				++_cursor[edge.EndId + 1];
+			}
+			for (int32 v = 0; v < _VertexCount; ++v)
+			{
+				_cursor[v + 1] += _cursor[v];
+			}
+			for (int32 e = 0; e < _EdgeCount; ++e)
+			{
+				_byEnd[_cursor[_edges[e].EndId]++] = e;
+			}
+
+			// 3. stable counting sort by StartId, rows come out sorted by target
+			OutOffsets.assign((SIZE_T)_VertexCount + 1, 0);
+			for (const TEdge<ET>& edge : _edges)
+			{
+				++OutOffsets[edge.StartId + 1];
+			}
+			for (int32 v = 0; v < _VertexCount; ++v)
+			{
+				OutOffsets[v + 1] += OutOffsets[v];
+			}
+			Targets.resize((SIZE_T)_EdgeCount);
+			Weights.resize((SIZE_T)_EdgeCount);
+			_cursor.assign(OutOffsets.begin(), OutOffsets.end());
+			for (int32 e : _byEnd)
+			{
+				const TEdge<ET>& edge = _edges[e];
+				int32 slot = _cursor[edge.StartId]++;
+				Targets[slot] = edge.EndId;
+				Weights[slot] = edge.Weight;
+			}
+
+			// 4. reverse view, walking sources in order keeps rows sorted by source
+			InOffsets.assign((SIZE_T)_VertexCount + 1, 0);
+			for (int32 e = 0; e < _EdgeCount; ++e)
+			{
+				++InOffsets[Targets[e] + 1];
+			}
+			for (int32 v = 0; v < _VertexCount; ++v)
+			{
+				InOffsets[v + 1] += InOffsets[v];
+			}
+			Sources.resize((SIZE_T)_EdgeCount);
+			InEdgeIds.resize((SIZE_T)_EdgeCount);
+			_cursor.assign(InOffsets.begin(), InOffsets.end());
+			for (int32 v = 0; v < _VertexCount; ++v)
+			{
+				for (int32 e = OutOffsets[v]; e < OutOffsets[v + 1]; ++e)
+				{
+					int32 slot = _cursor[Targets[e]]++;
+					Sources[slot] = v;
+					InEdgeIds[slot] = e;
+				}
+			}
+		}
+
+		template<typename ET>
+		inline void TCSRGraph<ET>::Reset()
+		{
+			OutOffsets.clear();
+			Targets.clear();
+			Weights.clear();
+			InOffsets.clear();
+			Sources.clear();
+			InEdgeIds.clear();
+		}
+
+		template<typename ET>
+		inline TCSRRange<int32> TCSRGraph<ET>::OutNeighbors(int32 InIndex) const
+		{
+			const int32* base = Targets.data();
+			TCSRRange<int32> range = { base + OutOffsets[InIndex], base + OutOffsets[InIndex + 1] };
+			return range;
+		}
+
+		template<typename ET>
+		inline TCSRRange<ET> TCSRGraph<ET>::OutWeights(int32 InIndex) const
+		{
+			const ET* base = Weights.data();
+			TCSRRange<ET> range = { base + OutOffsets[InIndex], base + OutOffsets[InIndex + 1] };
+			return range;
+		}
+
+		template<typename ET>
+		inline TCSRRange<int32> TCSRGraph<ET>::InNeighbors(int32 InIndex) const
+		{
+			const int32* base = Sources.data();
+			TCSRRange<int32> range = { base + InOffsets[InIndex], base + InOffsets[InIndex + 1] };
+			return range;
+		}
+
+		template<typename ET>
+		inline TCSRRange<int32> TCSRGraph<ET>::InEdges(int32 InIndex) const
+		{
+			const int32* base = InEdgeIds.data();
+			TCSRRange<int32> range = { base + InOffsets[InIndex], base + InOffsets[InIndex + 1] };
+			return range;
+		}
+
+		template<typename ET>
+		inline int32 TCSRGraph<ET>::FindEdge(int32 InStartId, int32 InEndId) const
+		{
+			if (InStartId < 0 || InStartId >= VertexCount())
+				return -1;
+
+			int32 low = OutOffsets[InStartId];
+			int32 high = OutOffsets[InStartId + 1];
+			while (low < high)
+			{
+				int32 mid = low + ((high - low) >> 1);
+				if (Targets[mid] < InEndId)
+					low = mid + 1;
+				else
+					high = mid;
+			}
+			return (low < OutOffsets[InStartId + 1] && Targets[low] == InEndId) ? low : -1;
+		}
+
+		template<typename ET>
+		inline int32 TCSRGraph<ET>::EdgeSource(int32 InEdgeId) const
+		{
+			// last v with OutOffsets[v] <= InEdgeId, empty rows share offsets with the next row
+			return (int32)(std::upper_bound(OutOffsets.begin(), OutOffsets.end(), InEdgeId) - OutOffsets.begin()) - 1;
+		}
+	}
+}
@@ -17,6 +17,8 @@
 
 #include <Core/Public/marco.h>
 #include <set>
+#include <Core/Containers/SeptemFlatSet.h>
+#include <string.h>
 using namespace std;
 
 #pragma pack(push, 1)
@@ -45,6 +47,34 @@ namespace Septem
 			ET Weight;
 		};
 
+		/*
+		*	64bit checksum of graph buffers, 8 bytes per round
+		*	not cryptographic, only catches corrupted or truncated files
+		*/
+		static inline uint64 GraphChecksum(const uint8* InData, SIZE_T InSize, uint64 InSeed = 0)
+		{
+			const uint64 prime1 = 0x9E3779B97F4A7C15ULL;
+			const uint64 prime2 = 0x87C37B91114253D5ULL;
+			uint64 h = InSeed ^ ((uint64)InSize * prime1);
+			SIZE_T i = 0;
+			for (; i + 8 <= InSize; i += 8)
+			{
+				uint64 word;
+				memcpy(&word, InData + i, sizeof(word));
+				h ^= word * prime2;
+				h = ((h << 31) | (h >> 33)) * prime1;
+			}
+			for (; i < InSize; ++i)
+			{
+				h ^= (uint64)InData[i] * prime2;
+				h = ((h << 31) | (h >> 33)) * prime1;
+			}
+			h ^= h >> 33;
+			h *= 0xff51afd7ed558ccdULL;
+			h ^= h >> 33;
+			return h;
+		}
+
 		/*
 		*	edge with adjust link list
 		*/
@@ -60,4 +90,25 @@ namespace Septem
 		
 	}
 }
-#pragma pack(pop)
\ No newline at end of file
+#pragma pack(pop)
+
+namespace Septem
+{
+	namespace GraphTheory
+	{
+		/*
+		*	EdgeAdjustList over a flat sorted array instead of set<int32>
+		*	small degrees stay inline, TBackwardGraph<VT, ET, EdgePolicy, FlatEdgeAdjustList>
+		*	kept out of pack(1) so the heap pointer stays aligned
+		*/
+		struct FlatEdgeAdjustList
+		{
+			int32 Index;
+			TFlatAdjacencySet<> AdjustVertexes;
+
+			FlatEdgeAdjustList(int32 InIndex = 0)
+				:Index(InIndex)
+			{}
+		};
+	}
+}
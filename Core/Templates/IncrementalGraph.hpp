@@ -0,0 +1,364 @@
+/*
+	Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+	LICENSE:	GNU General Public License V3.0
+
+	As a special exception,  you may use this file  as part of a free software library without
+	restriction.  Specifically,  if other files instantiate templates  or use macros or inline
+	functions from this file, or you compile this file and link it with other files to produce
+	an executable,  this file does not by itself cause the resulting executable to be covered
+	by the GNU General Public License. This exception does not however invalidate any other
+	reasons why the executable file might be covered by the GNU General Public License.
+
+	Support Email:	guij@sari.ac.cn
+*/
+
+#pragma once
+
+#include "GraphCSR.hpp"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+/// merge once the delta log holds this many entries ...
+#ifndef DEFAULT_DELTA_MERGE_MIN
+#define DEFAULT_DELTA_MERGE_MIN 4096
+#endif // !DEFAULT_DELTA_MERGE_MIN
+
+/// ... or 1/N of the edges of the current snapshot, whichever is larger
+#ifndef DEFAULT_DELTA_MERGE_RATIO
+#define DEFAULT_DELTA_MERGE_RATIO 8
+#endif // !DEFAULT_DELTA_MERGE_RATIO
+
+namespace Septem
+{
+	namespace GraphTheory
+	{
+		/*
+		*	immutable version of an incremental graph
+		*	sorted array adjacency in both directions through TCSRGraph
+		*/
+		template<typename VT, typename ET>
+		struct TGraphSnapshot
+		{
+			uint64 Version;
+			std::vector<VT> Values;
+			TCSRGraph<ET> Topology;
+
+			int32 VertexCount() const { return (int32)Values.size(); }
+			int32 EdgeCount() const { return Topology.EdgeCount(); }
+			const VT& GetVertexValue(int32 InIndex) const { return Values[InIndex]; }
+			// children
+			TCSRRange<int32> OutNeighbors(int32 InIndex) const { return Topology.OutNeighbors(InIndex); }
+			// parents, what TBackwardGraph::ParentEdges keeps
+			TCSRRange<int32> InNeighbors(int32 InIndex) const { return Topology.InNeighbors(InIndex); }
+			bool IsValidEdge(int32 InStartId, int32 InEndId) const { return Topology.IsValidEdge(InStartId, InEndId); }
+		};
+
+		/*
+		*	Incremental Graph
+		*	writers append edge inserts/removes to a delta log
+		*	the log is merged into a new sorted array snapshot when it grows past
+		*	max(DEFAULT_DELTA_MERGE_MIN, EdgeCount / DEFAULT_DELTA_MERGE_RATIO) or on Commit()
+		*	readers take a snapshot with GetSnapshot() and keep a consistent graph for as long
+		*	as they hold it, pending deltas are not visible until merged
+		*	writers are serialized by a mutex, GetSnapshot() never waits for a merge
+		*/
+		template<typename VT, typename ET>
+		class TIncrementalGraph
+		{
+		public:
+			typedef TGraphSnapshot<VT, ET> SnapshotType;
+			typedef std::shared_ptr<const SnapshotType> SnapshotPtr;
+
+			TIncrementalGraph();
+			virtual ~TIncrementalGraph() {}
+
+			/*
+			* replace everything with the content of InGraph and publish it
+			* GraphType: TDirectedGraph / TBackwardGraph
+			*/
+			template<typename GraphType>
+			void Load(GraphType& InGraph);
+
+			// @return index of the new vertex
+			int32 AddVertex(const VT& InVT);
+
+			/*
+			* queue edge changes
+			* a later change of the same (StartId, EndId) wins
+			* self edge follows SetDirectSelf(), same as TDirectedGraph
+			* @return false if an id is not a vertex (AddVertex counts before the merge) or the self edge is refused,
+			*	nothing is queued then; the batch calls return how many were queued
+			*/
+			bool AddEdge(const TEdge<ET>& InEdge);
+			int32 AddEdges(const std::vector< TEdge<ET> >& InEdges);
+			bool RemoveEdge(int32 InStartId, int32 InEndId);
+			int32 RemoveEdges(const std::vector< TEdge<ET> >& InEdges);
+
+			// merge pending changes and publish a new version, no-op if nothing pending
+			void Commit();
+
+			SnapshotPtr GetSnapshot() const;
+			uint64 GetVersion() const { return GetSnapshot()->Version; }
+			int32 PendingCount() const;
+
+			void SetDirectSelf(bool bInDirectSelf) { bDirectSelf = bInDirectSelf; }
+			void SetMergeThreshold(int32 InMin, int32 InRatio);
+
+		protected:
+			struct FEdgeDelta
+			{
+				TEdge<ET> Edge;
+				bool bRemove;
+			};
+
+			bool QueueDelta(const TEdge<ET>& InEdge, bool bRemove);
+			void MergeIfNeeded();
+			void Merge();
+			void Publish(std::shared_ptr<SnapshotType>& InSnapshot);
+
+			// newest published version, read with std::atomic_load
+			std::shared_ptr<const SnapshotType> Current;
+
+			mutable std::mutex WriterLock;
+			// vertex values and log waiting for the next merge, guarded by WriterLock
+			std::vector<VT> PendingValues;
+			std::vector<FEdgeDelta> DeltaLog;
+
+			bool bDirectSelf;
+			int32 MergeMin;
+			int32 MergeRatio;
+		};
+
+		template<typename VT, typename ET>
+		inline TIncrementalGraph<VT, ET>::TIncrementalGraph()
+			:bDirectSelf(false)
+			, MergeMin(DEFAULT_DELTA_MERGE_MIN)
+			, MergeRatio(DEFAULT_DELTA_MERGE_RATIO)
+		{
+			std::shared_ptr<SnapshotType> _empty = std::make_shared<SnapshotType>();
+			_empty->Version = 0;
+			_empty->Topology.Build(0, std::vector< TEdge<ET> >());
+			Current = _empty;
+		}
+
+		template<typename VT, typename ET>
+		template<typename GraphType>
+		inline void TIncrementalGraph<VT, ET>::Load(GraphType& InGraph)
+		{
+			std::shared_ptr<SnapshotType> _snapshot = std::make_shared<SnapshotType>();
+			_snapshot->Values.reserve((SIZE_T)InGraph.VertexCount());
+			for (int32 i = 0; i < InGraph.VertexCount(); ++i)
+			{
+				_snapshot->Values.push_back(InGraph.GetVertex(i).Value);
+			}
+			_snapshot->Topology.Build(InGraph);
+
+			std::lock_guard<std::mutex> scopelock(WriterLock);
+			PendingValues = _snapshot->Values;
+			DeltaLog.clear();
+			Publish(_snapshot);
+		}
+
+		template<typename VT, typename ET>
+		inline int32 TIncrementalGraph<VT, ET>::AddVertex(const VT& InVT)
+		{
+			std::lock_guard<std::mutex> scopelock(WriterLock);
+			PendingValues.push_back(InVT);
+			return (int32)PendingValues.size() - 1;
+		}
+
+		template<typename VT, typename ET>
+		inline bool TIncrementalGraph<VT, ET>::AddEdge(const TEdge<ET>& InEdge)
+		{
+			std::lock_guard<std::mutex> scopelock(WriterLock);
+			if (!QueueDelta(InEdge, false))
+			{
+				return false;
+			}
+			MergeIfNeeded();
+			return true;
+		}
+
+		template<typename VT, typename ET>
+		inline int32 TIncrementalGraph<VT, ET>::AddEdges(const std::vector< TEdge<ET> >& InEdges)
+		{
+			std::lock_guard<std::mutex> scopelock(WriterLock);
+			int32 _queued = 0;
+			for (const TEdge<ET>& edge : InEdges)
+			{
+				_queued += QueueDelta(edge, false) ? 1 : 0;
+			}
+			MergeIfNeeded();
+			return _queued;
+		}
+
+		template<typename VT, typename ET>
+		inline bool TIncrementalGraph<VT, ET>::RemoveEdge(int32 InStartId, int32 InEndId)
+		{
+			TEdge<ET> _edge;
+			_edge.StartId = InStartId;
+			_edge.EndId = InEndId;
+
+			std::lock_guard<std::mutex> scopelock(WriterLock);
+			if (!QueueDelta(_edge, true))
+			{
+				return false;
+			}
+			MergeIfNeeded();
+			return true;
+		}
+
+		template<typename VT, typename ET>
+		inline int32 TIncrementalGraph<VT, ET>::RemoveEdges(const std::vector< TEdge<ET> >& InEdges)
+		{
+			std::lock_guard<std::mutex> scopelock(WriterLock);
+			int32 _queued = 0;
+			for (const TEdge<ET>& edge : InEdges)
+			{
+				_queued += QueueDelta(edge, true) ? 1 : 0;
+			}
+			MergeIfNeeded();
+			return _queued;
+		}
+
+		template<typename VT, typename ET>
+		inline void TIncrementalGraph<VT, ET>::Commit()
+		{
+			std::lock_guard<std::mutex> scopelock(WriterLock);
+			if (!DeltaLog.empty() || (int32)PendingValues.size() != std::atomic_load(&Current)->VertexCount())
+			{
+				Merge();
+			}
+		}
+
+		template<typename VT, typename ET>
+		inline typename TIncrementalGraph<VT, ET>::SnapshotPtr TIncrementalGraph<VT, ET>::GetSnapshot() const
+		{
+			return std::atomic_load(&Current);
+		}
+
+		template<typename VT, typename ET>
+		inline int32 TIncrementalGraph<VT, ET>::PendingCount() const
+		{
+			std::lock_guard<std::mutex> scopelock(WriterLock);
+			return (int32)DeltaLog.size();
+		}
+
+		template<typename VT, typename ET>
+		inline void TIncrementalGraph<VT, ET>::SetMergeThreshold(int32 InMin, int32 InRatio)
+		{
+			std::lock_guard<std::mutex> scopelock(WriterLock);
+			MergeMin = InMin > 1 ? InMin : 1;
+			MergeRatio = InRatio > 1 ? InRatio : 1;
+		}
+
+		template<typename VT, typename ET>
+		inline bool TIncrementalGraph<VT, ET>::QueueDelta(const TEdge<ET>& InEdge, bool bRemove)
+		{
+			// Merge indexes rows with these ids, a bad one must never reach the log
+			const int32 _VertexCount = (int32)PendingValues.size();
+			if (InEdge.StartId < 0 || InEdge.StartId >= _VertexCount || InEdge.EndId < 0 || InEdge.EndId >= _VertexCount)
+				return false;
+			if (!bDirectSelf && InEdge.StartId == InEdge.EndId)
+				return false;
+
+			FEdgeDelta _delta;
+			_delta.Edge = InEdge;
+			_delta.bRemove = bRemove;
+			DeltaLog.push_back(_delta);
+			return true;
+		}
+
+		template<typename VT, typename ET>
+		inline void TIncrementalGraph<VT, ET>::MergeIfNeeded()
+		{
+			const int32 _threshold = std::max(MergeMin, std::atomic_load(&Current)->EdgeCount() / MergeRatio);
+			if ((int32)DeltaLog.size() >= _threshold)
+			{
+				Merge();
+			}
+		}
+
+		template<typename VT, typename ET>
+		inline void TIncrementalGraph<VT, ET>::Merge()
+		{
+			SnapshotPtr _base = std::atomic_load(&Current);
+			const TCSRGraph<ET>& _csr = _base->Topology;
+
+			// 1. sort the log by key, stable so the last change of a key comes last
+			std::stable_sort(DeltaLog.begin(), DeltaLog.end(), [](const FEdgeDelta& A, const FEdgeDelta& B)
+			{
+				return A.Edge.StartId != B.Edge.StartId ? A.Edge.StartId < B.Edge.StartId : A.Edge.EndId < B.Edge.EndId;
+			});
+
+			// 2. merge every base row with its delta run, output stays sorted by (StartId, EndId)
+			std::vector< TEdge<ET> > _edges;
+			_edges.reserve((SIZE_T)_csr.EdgeCount() + DeltaLog.size());
+
+			const int32 _VertexCount = (int32)PendingValues.size();
+			const int32 _BaseVertexCount = _csr.VertexCount();
+			SIZE_T d = 0;
+			for (int32 v = 0; v < _VertexCount; ++v)
+			{
+				int32 e = 0;
+				int32 eEnd = 0;
+				if (v < _BaseVertexCount)
+				{
+					e = _csr.GetOutOffsets()[v];
+					eEnd = _csr.GetOutOffsets()[v + 1];
+				}
+
+				while (e < eEnd || (d < DeltaLog.size() && DeltaLog[d].Edge.StartId == v))
+				{
+					const bool bHasDelta = d < DeltaLog.size() && DeltaLog[d].Edge.StartId == v;
+					const int32 _baseEnd = e < eEnd ? _csr.GetTargets()[e] : -1;
+					if (!bHasDelta || (e < eEnd && _baseEnd < DeltaLog[d].Edge.EndId))
+					{
+						TEdge<ET> _edge;
+						_edge.StartId = v;
+						_edge.EndId = _baseEnd;
+						_edge.Weight = _csr.GetWeights()[e];
+						_edges.push_back(_edge);
+						++e;
+						continue;
+					}
+
+					// last change of this key
+					const int32 _key = DeltaLog[d].Edge.EndId;
+					while (d + 1 < DeltaLog.size() && DeltaLog[d + 1].Edge.StartId == v && DeltaLog[d + 1].Edge.EndId == _key)
+					{
+						++d;
+					}
+					if (!DeltaLog[d].bRemove)
+					{
+						_edges.push_back(DeltaLog[d].Edge);
+					}
+					if (e < eEnd && _baseEnd == _key)
+					{
+						++e;
+					}
+					++d;
+				}
+			}
+			DeltaLog.clear();
+
+			// 3. rebuild both directions, O(V+E)
+			std::shared_ptr<SnapshotType> _snapshot = std::make_shared<SnapshotType>();
+			_snapshot->Values = PendingValues;
+			_snapshot->Topology.Build(_VertexCount, _edges);
+			Publish(_snapshot);
+		}
+
+		template<typename VT, typename ET>
+		inline void TIncrementalGraph<VT, ET>::Publish(std::shared_ptr<SnapshotType>& InSnapshot)
+		{
+			InSnapshot->Version = std::atomic_load(&Current)->Version + 1;
+			std::shared_ptr<const SnapshotType> _const = InSnapshot;
+			std::atomic_store(&Current, _const);
+		}
+	}
+}
@@ -0,0 +1,474 @@
+/*
+	Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+	LICENSE:	GNU General Public License V3.0
+
+	As a special exception,  you may use this file  as part of a free software library without
+	restriction.  Specifically,  if other files instantiate templates  or use macros or inline
+	functions from this file, or you compile this file and link it with other files to produce
+	an executable,  this file does not by itself cause the resulting executable to be covered
+	by the GNU General Public License. This exception does not however invalidate any other
+	reasons why the executable file might be covered by the GNU General Public License.
+
+	Support Email:	guij@sari.ac.cn
+*/
+
+#pragma once
+
+#include "GraphCSR.hpp"
+
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/// "GMAP" little endian
+#define MAPPED_GRAPH_MAGIC 0x50414D47u
+#define MAPPED_GRAPH_VERSION 1u
+/// written in native order, reads back as 0x04030201 on the other endianness
+#define MAPPED_GRAPH_ENDIAN_TAG 0x01020304u
+/// every section starts on a cache line
+#define MAPPED_GRAPH_ALIGNMENT 64
+
+namespace Septem
+{
+	namespace GraphTheory
+	{
+		/*
+		*	sections of the mapped graph file, in file order
+		*/
+		enum EMappedGraphSection
+		{
+			MGS_OutOffsets = 0,	// int32 x (V+1)
+			MGS_Targets,		// int32 x E
+			MGS_Weights,		// ET x E
+			MGS_InOffsets,		// int32 x (V+1)
+			MGS_Sources,		// int32 x E
+			MGS_InEdgeIds,		// int32 x E
+			MGS_Vertices,		// VT x V
+			MGS_Num
+		};
+
+#pragma pack(push, 1)
+		struct FMappedGraphHeader
+		{
+			uint32 Magic;
+			uint32 Version;
+			uint32 EndianTag;
+			uint32 HeaderSize;		// sizeof(FMappedGraphHeader)
+			uint32 VertexStride;	// sizeof(VT)
+			uint32 WeightStride;	// sizeof(ET)
+			int32 VertexCount;
+			int32 EdgeCount;
+			uint64 SectionOffset[MGS_Num];
+			uint64 SectionSize[MGS_Num];
+			uint64 FileSize;
+			uint64 Checksum;		// GraphChecksum chained over the sections in order
+		};
+#pragma pack(pop)
+
+		/*
+		*	Memory mapped graph file
+		*	Open() maps the file and checks the header only: O(1), pages fault in on first touch
+		*	queries read the CSR arrays in place, nothing is parsed or copied
+		*	the index sections are trusted as written by Write(): call VerifyIndexes() once
+		*	on a file from anywhere else, a bad offset or id reads outside the mapping
+		*	VT & ET must be trivially copyable, the file is only portable to the same endianness
+		*	Read only, Thread Safe after Open
+		*/
+		template<typename VT, typename ET>
+		class TMappedGraph
+		{
+			static_assert(std::is_trivially_copyable<VT>::value, "TMappedGraph needs trivially copyable vertex values");
+			static_assert(std::is_trivially_copyable<ET>::value, "TMappedGraph needs trivially copyable edge weights");
+
+		public:
+			TMappedGraph()
+				:MappedData(nullptr)
+				, MappedSize(0)
+				, Header(nullptr)
+			{}
+
+			~TMappedGraph()
+			{
+				Close();
+			}
+
+			/*
+			* write a graph into InPath in the mapped format
+			* goes to <InPath>.tmp first and is renamed over InPath once synced:
+			* mappings of the old file keep the old content, no one maps a half written file
+			* GraphType: TDirectedGraph / TBackwardGraph
+			*/
+			template<typename GraphType>
+			static bool Write(const char* InPath, GraphType& InGraph);
+			static bool Write(const char* InPath, const TCSRGraph<ET>& InCSR, const VT* InVertexValues);
+
+			/*
+			* map InPath read only
+			* @param bRandomAccess	madvise(MADV_RANDOM), no read ahead for point lookups
+			* @return false if the file is missing or the header does not match VT/ET/endianness
+			*/
+			bool Open(const char* InPath, bool bRandomAccess = false);
+			void Close();
+			bool IsOpen() const { return Header != nullptr; }
+
+			/*
+			* full pass over the file, touches every page
+			* call it once after copying files around, not on the hot path
+			*/
+			bool VerifyChecksum() const;
+			/*
+			* full pass over the index sections: offsets ascending within [0, E],
+			* vertex ids within [0, V), in edge ids within [0, E)
+			* @return false if a query could read outside the mapping
+			*/
+			bool VerifyIndexes() const;
+
+			int32 VertexCount() const { return Header ? Header->VertexCount : 0; }
+			int32 EdgeCount() const { return Header ? Header->EdgeCount : 0; }
+
+			const VT& GetVertexValue(int32 InIndex) const { return Section<VT>(MGS_Vertices)[InIndex]; }
+
+			int32 OutDegree(int32 InIndex) const;
+			int32 InDegree(int32 InIndex) const;
+			TCSRRange<int32> OutNeighbors(int32 InIndex) const;
+			TCSRRange<ET> OutWeights(int32 InIndex) const;
+			TCSRRange<int32> InNeighbors(int32 InIndex) const;
+			TCSRRange<int32> InEdges(int32 InIndex) const;
+
+			// edge id of (InStartId -> InEndId), -1 if not exist
+			int32 FindEdge(int32 InStartId, int32 InEndId) const;
+			bool IsValidEdge(int32 InStartId, int32 InEndId) const { return FindEdge(InStartId, InEndId) >= 0; }
+			const ET& GetWeight(int32 InEdgeId) const { return Section<ET>(MGS_Weights)[InEdgeId]; }
+
+		protected:
+			template<typename T>
+			const T* Section(EMappedGraphSection InSection) const
+			{
+				return reinterpret_cast<const T*>(MappedData + Header->SectionOffset[InSection]);
+			}
+
+			static uint64 AlignUp(uint64 InValue)
+			{
+				return (InValue + MAPPED_GRAPH_ALIGNMENT - 1) & ~(uint64)(MAPPED_GRAPH_ALIGNMENT - 1);
+			}
+
+			static bool WriteAll(int InFd, const void* InData, SIZE_T InSize);
+
+		private:
+			TMappedGraph(const TMappedGraph&);
+			TMappedGraph& operator=(const TMappedGraph&);
+
+			const uint8* MappedData;
+			SIZE_T MappedSize;
+			const FMappedGraphHeader* Header;
+		};
+
+		template<typename VT, typename ET>
+		template<typename GraphType>
+		inline bool TMappedGraph<VT, ET>::Write(const char* InPath, GraphType& InGraph)
+		{
+			TCSRGraph<ET> _csr;
+			_csr.Build(InGraph);
+
+			std::vector<VT> _values((SIZE_T)InGraph.VertexCount());
+			for (int32 i = 0; i < InGraph.VertexCount(); ++i)
+			{
+				_values[i] = InGraph.GetVertex(i).Value;
+			}
+			return Write(InPath, _csr, _values.data());
+		}
+
+		template<typename VT, typename ET>
+		inline bool TMappedGraph<VT, ET>::WriteAll(int InFd, const void* InData, SIZE_T InSize)
+		{
+			const uint8* ptr = static_cast<const uint8*>(InData);
+			while (InSize > 0)
+			{
+				ssize_t k = ::write(InFd, ptr, InSize);
+				if (k <= 0)
+					return false;
+				ptr += k;
+				InSize -= (SIZE_T)k;
+			}
+			return true;
+		}
+
+		template<typename VT, typename ET>
+		inline bool TMappedGraph<VT, ET>::Write(const char* InPath, const TCSRGraph<ET>& InCSR, const VT* InVertexValues)
+		{
+			const int32 _VertexCount = InCSR.VertexCount();
+			const int32 _EdgeCount = InCSR.EdgeCount();
+
+			const void* _data[MGS_Num] = {
+				InCSR.GetOutOffsets().data(),
+				InCSR.GetTargets().data(),
+				InCSR.GetWeights().data(),
+				InCSR.GetInOffsets().data(),
+				InCSR.GetSources().data(),
+				InCSR.GetInEdgeIds().data(),
+				InVertexValues
+			};
+
+			FMappedGraphHeader _header;
+			memset(&_header, 0, sizeof(_header));
+			_header.Magic = MAPPED_GRAPH_MAGIC;
+			_header.Version = MAPPED_GRAPH_VERSION;
+			_header.EndianTag = MAPPED_GRAPH_ENDIAN_TAG;
+			_header.HeaderSize = (uint32)sizeof(FMappedGraphHeader);
+			_header.VertexStride = (uint32)sizeof(VT);
+			_header.WeightStride = (uint32)sizeof(ET);
+			_header.VertexCount = _VertexCount;
+			_header.EdgeCount = _EdgeCount;
+			_header.SectionSize[MGS_OutOffsets] = sizeof(int32) * (uint64)InCSR.GetOutOffsets().size();
+			_header.SectionSize[MGS_Targets] = sizeof(int32) * (uint64)_EdgeCount;
+			_header.SectionSize[MGS_Weights] = sizeof(ET) * (uint64)_EdgeCount;
+			_header.SectionSize[MGS_InOffsets] = sizeof(int32) * (uint64)InCSR.GetInOffsets().size();
+			_header.SectionSize[MGS_Sources] = sizeof(int32) * (uint64)_EdgeCount;
+			_header.SectionSize[MGS_InEdgeIds] = sizeof(int32) * (uint64)_EdgeCount;
+			_header.SectionSize[MGS_Vertices] = sizeof(VT) * (uint64)_VertexCount;
+
+			uint64 _offset = AlignUp(sizeof(FMappedGraphHeader));
+			for (int32 i = 0; i < MGS_Num; ++i)
+			{
+				_header.SectionOffset[i] = _offset;
+				_offset = AlignUp(_offset + _header.SectionSize[i]);
+			}
+			_header.FileSize = _offset;
+
+			uint64 _checksum = 0;
+			for (int32 i = 0; i < MGS_Num; ++i)
+			{
+				_checksum = GraphChecksum(static_cast<const uint8*>(_data[i]), (SIZE_T)_header.SectionSize[i], _checksum);
+			}
+			_header.Checksum = _checksum;
+
+			// truncating InPath in place would SIGBUS everyone who maps it
+			const std::string _tmpPath = std::string(InPath) + ".tmp";
+			int _fd = ::open(_tmpPath.c_str(), O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, 0644);
+			if (_fd < 0)
+				return false;
+
+			static const uint8 _padding[MAPPED_GRAPH_ALIGNMENT] = { 0 };
+			bool bOk = WriteAll(_fd, &_header, sizeof(_header));
+			uint64 _cursor = sizeof(FMappedGraphHeader);
+			for (int32 i = 0; bOk && i < MGS_Num; ++i)
+			{
+				bOk = WriteAll(_fd, _padding, (SIZE_T)(_header.SectionOffset[i] - _cursor))
+					&& WriteAll(_fd, _data[i], (SIZE_T)_header.SectionSize[i]);
+				_cursor = _header.SectionOffset[i] + _header.SectionSize[i];
+			}
+			bOk = bOk && WriteAll(_fd, _padding, (SIZE_T)(_header.FileSize - _cursor));
+			// the data is on disk before the name points at it
+			bOk = bOk && ::fsync(_fd) == 0;
+			bOk = ::close(_fd) == 0 && bOk;
+
+			bOk = bOk && ::rename(_tmpPath.c_str(), InPath) == 0;
+			if (!bOk)
+			{
+				::unlink(_tmpPath.c_str());
+			}
+			return bOk;
+		}
+
+		template<typename VT, typename ET>
+		inline bool TMappedGraph<VT, ET>::Open(const char* InPath, bool bRandomAccess)
+		{
+			Close();
+
+			int _fd = ::open(InPath, O_RDONLY | O_CLOEXEC);
+			if (_fd < 0)
+				return false;
+
+			struct stat _stat;
+			if (::fstat(_fd, &_stat) != 0 || (SIZE_T)_stat.st_size < sizeof(FMappedGraphHeader))
+			{
+				::close(_fd);
+				return false;
+			}
+
+			void* _map = ::mmap(nullptr, (SIZE_T)_stat.st_size, PROT_READ, MAP_SHARED, _fd, 0);
+			// the mapping keeps the file alive
+			::close(_fd);
+			if (_map == MAP_FAILED)
+				return false;
+
+			const FMappedGraphHeader* _header = static_cast<const FMappedGraphHeader*>(_map);
+			bool bValid = _header->Magic == MAPPED_GRAPH_MAGIC
+				&& _header->Version == MAPPED_GRAPH_VERSION
+				&& _header->EndianTag == MAPPED_GRAPH_ENDIAN_TAG
+				&& _header->HeaderSize == sizeof(FMappedGraphHeader)
+				&& _header->VertexStride == sizeof(VT)
+				&& _header->WeightStride == sizeof(ET)
+				&& _header->VertexCount >= 0
+				&& _header->EdgeCount >= 0
+				&& _header->FileSize == (uint64)_stat.st_size;
+			for (int32 i = 0; bValid && i < MGS_Num; ++i)
+			{
+				// Offset + Size written so that it cannot wrap
+				bValid = _header->SectionOffset[i] % MAPPED_GRAPH_ALIGNMENT == 0
+					&& _header->SectionOffset[i] >= sizeof(FMappedGraphHeader)
+					&& _header->SectionSize[i] <= _header->FileSize
+					&& _header->SectionOffset[i] <= _header->FileSize - _header->SectionSize[i];
+			}
+			bValid = bValid
+				&& _header->SectionSize[MGS_OutOffsets] == sizeof(int32) * ((uint64)_header->VertexCount + 1)
+				&& _header->SectionSize[MGS_InOffsets] == sizeof(int32) * ((uint64)_header->VertexCount + 1)
+				&& _header->SectionSize[MGS_Targets] == sizeof(int32) * (uint64)_header->EdgeCount
+				&& _header->SectionSize[MGS_Weights] == sizeof(ET) * (uint64)_header->EdgeCount
+				&& _header->SectionSize[MGS_Sources] == sizeof(int32) * (uint64)_header->EdgeCount
+				&& _header->SectionSize[MGS_InEdgeIds] == sizeof(int32) * (uint64)_header->EdgeCount
+				&& _header->SectionSize[MGS_Vertices] == sizeof(VT) * (uint64)_header->VertexCount;
+			if (bValid)
+			{
+				// O(1) ends of both offset arrays, VerifyIndexes checks the rest
+				const uint8* _base = static_cast<const uint8*>(_map);
+				const int32* _out = reinterpret_cast<const int32*>(_base + _header->SectionOffset[MGS_OutOffsets]);
+				const int32* _in = reinterpret_cast<const int32*>(_base + _header->SectionOffset[MGS_InOffsets]);
+				bValid = _out[0] == 0 && _out[_header->VertexCount] == _header->EdgeCount
+					&& _in[0] == 0 && _in[_header->VertexCount] == _header->EdgeCount;
+			}
+
+			if (!bValid)
+			{
+				::munmap(_map, (SIZE_T)_stat.st_size);
+				return false;
+			}
+
+			if (bRandomAccess)
+			{
+				::madvise(_map, (SIZE_T)_stat.st_size, MADV_RANDOM);
+			}
+
+			MappedData = static_cast<const uint8*>(_map);
+			MappedSize = (SIZE_T)_stat.st_size;
+			Header = _header;
+			return true;
+		}
+
+		template<typename VT, typename ET>
+		inline void TMappedGraph<VT, ET>::Close()
+		{
+			if (MappedData)
+			{
+				::munmap(const_cast<uint8*>(MappedData), MappedSize);
+			}
+			MappedData = nullptr;
+			MappedSize = 0;
+			Header = nullptr;
+		}
+
+		template<typename VT, typename ET>
+		inline bool TMappedGraph<VT, ET>::VerifyChecksum() const
+		{
+			if (!Header)
+				return false;
+			uint64 _checksum = 0;
+			for (int32 i = 0; i < MGS_Num; ++i)
+			{
+				_checksum = GraphChecksum(MappedData + Header->SectionOffset[i], (SIZE_T)Header->SectionSize[i], _checksum);
+			}
+			return _checksum == Header->Checksum;
+		}
+
+		template<typename VT, typename ET>
+		inline bool TMappedGraph<VT, ET>::VerifyIndexes() const
+		{
+			if (!Header)
+				return false;
+			const int32 _VertexCount = Header->VertexCount;
+			const int32 _EdgeCount = Header->EdgeCount;
+			const EMappedGraphSection _offsets[2] = { MGS_OutOffsets, MGS_InOffsets };
+			for (int32 k = 0; k < 2; ++k)
+			{
+				const int32* offsets = Section<int32>(_offsets[k]);
+				for (int32 v = 0; v < _VertexCount; ++v)
+				{
+					if (offsets[v] < 0 || offsets[v] > offsets[v + 1] || offsets[v + 1] > _EdgeCount)
+						return false;
+				}
+			}
+
+			const int32* targets = Section<int32>(MGS_Targets);
+			const int32* sources = Section<int32>(MGS_Sources);
+			const int32* edgeIds = Section<int32>(MGS_InEdgeIds);
+			for (int32 e = 0; e < _EdgeCount; ++e)
+			{
+				if ((uint32)targets[e] >= (uint32)_VertexCount
+					|| (uint32)sources[e] >= (uint32)_VertexCount
+					|| (uint32)edgeIds[e] >= (uint32)_EdgeCount)
+					return false;
+			}
+			return true;
+		}
+
+		template<typename VT, typename ET>
+		inline int32 TMappedGraph<VT, ET>::OutDegree(int32 InIndex) const
+		{
+			const int32* offsets = Section<int32>(MGS_OutOffsets);
+			return offsets[InIndex + 1] - offsets[InIndex];
+		}
+
+		template<typename VT, typename ET>
+		inline int32 TMappedGraph<VT, ET>::InDegree(int32 InIndex) const
+		{
+			const int32* offsets = Section<int32>(MGS_InOffsets);
+			return offsets[InIndex + 1] - offsets[InIndex];
+		}
+
+		template<typename VT, typename ET>
+		inline TCSRRange<int32> TMappedGraph<VT, ET>::OutNeighbors(int32 InIndex) const
+		{
+			const int32* offsets = Section<int32>(MGS_OutOffsets);
+			const int32* base = Section<int32>(MGS_Targets);
+			TCSRRange<int32> range = { base + offsets[InIndex], base + offsets[InIndex + 1] };
+			return range;
+		}
+
+		template<typename VT, typename ET>
+		inline TCSRRange<ET> TMappedGraph<VT, ET>::OutWeights(int32 InIndex) const
+		{
+			const int32* offsets = Section<int32>(MGS_OutOffsets);
+			const ET* base = Section<ET>(MGS_Weights);
+			TCSRRange<ET> range = { base + offsets[InIndex], base + offsets[InIndex + 1] };
+			return range;
+		}
+
+		template<typename VT, typename ET>
+		inline TCSRRange<int32> TMappedGraph<VT, ET>::InNeighbors(int32 InIndex) const
+		{
+			const int32* offsets = Section<int32>(MGS_InOffsets);
+			const int32* base = Section<int32>(MGS_Sources);
+			TCSRRange<int32> range = { base + offsets[InIndex], base + offsets[InIndex + 1] };
+			return range;
+		}
+
+		template<typename VT, typename ET>
+		inline TCSRRange<int32> TMappedGraph<VT, ET>::InEdges(int32 InIndex) const
+		{
+			const int32* offsets = Section<int32>(MGS_InOffsets);
+			const int32* base = Section<int32>(MGS_InEdgeIds);
+			TCSRRange<int32> range = { base + offsets[InIndex], base + offsets[InIndex + 1] };
+			return range;
+		}
+
+		template<typename VT, typename ET>
+		inline int32 TMappedGraph<VT, ET>::FindEdge(int32 InStartId, int32 InEndId) const
+		{
+			if (InStartId < 0 || InStartId >= VertexCount())
+				return -1;
+
+			const int32* offsets = Section<int32>(MGS_OutOffsets);
+			const int32* targets = Section<int32>(MGS_Targets);
+			const int32* found = std::lower_bound(targets + offsets[InStartId], targets + offsets[InStartId + 1], InEndId);
+			return (found != targets + offsets[InStartId + 1] && *found == InEndId) ? (int32)(found - targets) : -1;
+		}
+	}
+}
@@ -17,6 +17,7 @@
 
 #include <Core/Public/marco.h>
 #include <Core/Thread/ScopLock.h>
+#include <Core/Thread/SeptemLockProfiler.hpp>
 //shared_ptr
 #include <memory>
 //container
@@ -49,7 +50,7 @@ namespace Septem
 		*/
 		void Reset(int32 PoolCount = DEFAULT_RECYCLE_POOL_SIZE)
 		{
-			ScopeLock _scopelock(&m_pool_locker);
+			SCOPE_LOCK_PROFILED(&m_pool_locker);
 			int32 imax = PoolCount - (int32)m_pool.size();
 			if (imax > 0)
 			{
@@ -67,7 +68,7 @@ namespace Septem
 		*/
 		void Resize(int32 PoolCount = DEFAULT_RECYCLE_POOL_SIZE)
 		{
-			ScopeLock _scopelock(&m_pool_locker);
+			SCOPE_LOCK_PROFILED(&m_pool_locker);
 			int32 imax = PoolCount - m_pool.size();
 			if (imax > 0)
 			{
@@ -104,7 +105,7 @@ namespace Septem
 			// You cannot call copy construct function of this class, the use_count will + 1, cause cannot delete
 			
 			{
-				ScopeLock _scopelock(&m_pool_locker);
+				SCOPE_LOCK_PROFILED(&m_pool_locker);
 				if (!m_pool.empty())
 				{
 					//ret.swap(m_pool.top());
@@ -125,7 +126,7 @@ namespace Septem
 			/// check ptr is valid
 			if (InSharedPtr)
 			{
-				ScopeLock _scopelock(&m_pool_locker);
+				SCOPE_LOCK_PROFILED(&m_pool_locker);
 				m_pool.push(InSharedPtr);
 			}
 		}
@@ -135,7 +136,7 @@ namespace Septem
 			/// check ptr is valid
 			if (InSharedPtr)
 			{
-				ScopeLock _scopelock(&m_pool_locker);
+				SCOPE_LOCK_PROFILED(&m_pool_locker);
 				m_pool.push(InSharedPtr);
 			}
 		}
@@ -27,6 +27,38 @@
 
 namespace Septem
 {
+	/*
+	*	Lock Traits
+	*	how TScopeLock takes and releases a lock object
+	*	default: call LockType::Lock() / LockType::Unlock()
+	*	see Core/Thread/SeptemLocks.hpp for FTicketSpinLock, FAdaptiveMutex, FRWLock
+	*/
+	template<typename LockType>
+	struct TLockTraits
+	{
+		static void Lock(LockType* InLockObject) { InLockObject->Lock(); }
+		static void Unlock(LockType* InLockObject) { InLockObject->Unlock(); }
+	};
+
+	// raw LOCKTYPE keeps the old pthread mutex behaviour
+	template<>
+	struct TLockTraits<LOCKTYPE>
+	{
+		static void Lock(LOCKTYPE* InLockObject)
+		{
+#ifdef LINUX
+			pthread_mutex_lock(InLockObject);
+#endif // LINUX
+		}
+
+		static void Unlock(LOCKTYPE* InLockObject)
+		{
+#ifdef LINUX
+			pthread_mutex_unlock(InLockObject);
+#endif // LINUX
+		}
+	};
+
 	/*
 	*	User Guide
 	Sample Code
@@ -36,10 +68,16 @@ namespace Septem
 	{
 		ScopeLock _scopelock(&locker);
 	}
+
+	FTicketSpinLock spinlock;
+	{
+		TScopeLock<FTicketSpinLock> _scopelock(&spinlock);
+	}
 	```
 
 	*/
-	class ScopeLock
+	template<typename LockType>
+	class TScopeLock
 	{
 	public:
 		/*
@@ -47,41 +85,75 @@ namespace Septem
 		*	2. Lock the lockObject
 		*	@param InLockObject
 		*/
-		ScopeLock(LOCKTYPE* InLockObject)
+		TScopeLock(LockType* InLockObject)
 			:lockObject(InLockObject)
 		{
 			check(lockObject);
+			TLockTraits<LockType>::Lock(lockObject);
+		}
 
-#ifdef LINUX
-			pthread_mutex_lock(lockObject);
-#endif // LINUX
+		/** Destructor & unlock the lockObject*/
+		~TScopeLock()
+		{
+			check(lockObject);
+			TLockTraits<LockType>::Unlock(lockObject);
+		}
+
+	private:
+		/** Default constructor (hidden on purpose). */
+		TScopeLock();
+
+		/** Copy constructor( hidden on purpose). */
+		TScopeLock(const TScopeLock& InScopeLock);
 
+		/** Assignment operator (hidden on purpose). */
+		TScopeLock& operator=(TScopeLock& InScopeLock)
+		{
+			return *this;
 		}
 
-		/** Destructor & unlock the lockObject*/
-		~ScopeLock()
+	private:
+		LockType* lockObject;
+	};
+
+	/*
+	*	Shared scope lock for reader writer locks
+	*	LockType need ReadLock() / ReadUnlock()
+	*/
+	template<typename LockType>
+	class TScopeReadLock
+	{
+	public:
+		TScopeReadLock(LockType* InLockObject)
+			:lockObject(InLockObject)
 		{
 			check(lockObject);
+			lockObject->ReadLock();
+		}
 
-#ifdef LINUX
-			pthread_mutex_unlock(lockObject);
-#endif // LINUX
+		~TScopeReadLock()
+		{
+			check(lockObject);
+			lockObject->ReadUnlock();
 		}
 
 	private:
 		/** Default constructor (hidden on purpose). */
-		ScopeLock();
+		TScopeReadLock();
 
 		/** Copy constructor( hidden on purpose). */
-		ScopeLock(const ScopeLock& InScopeLock);
+		TScopeReadLock(const TScopeReadLock& InScopeLock);
 
 		/** Assignment operator (hidden on purpose). */
-		ScopeLock& operator=(ScopeLock& InScopeLock)
+		TScopeReadLock& operator=(TScopeReadLock& InScopeLock)
 		{
 			return *this;
 		}
 
 	private:
-		LOCKTYPE* lockObject;
+		LockType* lockObject;
 	};
-}
\ No newline at end of file
+
+	/// the classic pthread mutex scope lock
+	typedef TScopeLock<LOCKTYPE> ScopeLock;
+}
@@ -0,0 +1,267 @@
+/*
+	Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+	LICENSE:	GNU General Public License V3.0
+
+	As a special exception,  you may use this file  as part of a free software library without
+	restriction.  Specifically,  if other files instantiate templates  or use macros or inline
+	functions from this file, or you compile this file and link it with other files to produce
+	an executable,  this file does not by itself cause the resulting executable to be covered
+	by the GNU General Public License. This exception does not however invalidate any other
+	reasons why the executable file might be covered by the GNU General Public License.
+
+	Support Email:	guij@sari.ac.cn
+*/
+
+#pragma once
+
+#include <Core/Public/marco.h>
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+/// threads that can be inside an epoch at the same time, per process
+#ifndef EPOCH_MAX_THREADS
+#define EPOCH_MAX_THREADS 256
+#endif // !EPOCH_MAX_THREADS
+
+namespace Septem
+{
+	/*
+	*	small dense id per thread, [0, EPOCH_MAX_THREADS)
+	*	taken on first use, given back when the thread exits
+	*	-1 once every id is taken
+	*/
+	class FEpochThreadId
+	{
+	public:
+		static int32 Get()
+		{
+			static thread_local FEpochThreadId _local;
+			return _local.Id;
+		}
+
+	private:
+		FEpochThreadId()
+		{
+			for (int32 i = 0; i < EPOCH_MAX_THREADS; ++i)
+			{
+				bool expected = false;
+				if (Used()[i].compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+				{
+					Id = i;
+					return;
+				}
+			}
+			// FEpochManager takes its overflow path for this thread
+			Id = -1;
+		}
+
+		~FEpochThreadId()
+		{
+			if (Id >= 0)
+			{
+				Used()[Id].store(false, std::memory_order_release);
+			}
+		}
+
+		static std::atomic<bool>* Used()
+		{
+			static std::atomic<bool> _used[EPOCH_MAX_THREADS];
+			return _used;
+		}
+
+		int32 Id;
+	};
+
+	/*
+	*	Epoch Manager
+	*	epoch based reclamation for read mostly data published through an atomic pointer
+	*	reader:	FEpochGuard guard(manager); load the pointer; use it; leave the scope
+	*	writer:	swap the pointer; Retire(old, deleter)
+	*	an object retired at epoch E is deleted once no reader is inside an epoch <= E
+	*	readers never wait: Enter/Exit are one store each
+	*	Retire/Reclaim are serialized by a mutex, meant for the rare writer
+	*	threads past EPOCH_MAX_THREADS share one reader count instead of a slot:
+	*	still safe, but nothing is reclaimed while one of them is inside
+	*/
+	class FEpochManager
+	{
+	public:
+		typedef void(*FDeleter)(void*);
+
+		FEpochManager()
+			:GlobalEpoch(1)
+			, OverflowReaders(0)
+		{
+			for (int32 i = 0; i < EPOCH_MAX_THREADS; ++i)
+			{
+				Slots[i].LocalEpoch.store(0, std::memory_order_relaxed);
+				Slots[i].Depth = 0;
+			}
+		}
+
+		/*
+		* free everything still retired
+		* no reader may be inside an epoch any more
+		*/
+		~FEpochManager()
+		{
+			std::lock_guard<std::mutex> scopelock(RetireLock);
+			for (FRetired& retired : RetireList)
+			{
+				retired.Deleter(retired.Object);
+			}
+			RetireList.clear();
+		}
+
+		// nested Enter on the same thread keeps the outer epoch
+		void Enter()
+		{
+			const int32 _id = FEpochThreadId::Get();
+			if (_id < 0)
+			{
+				// seq_cst for the same reason as the slot store below
+				OverflowReaders.fetch_add(1, std::memory_order_seq_cst);
+				return;
+			}
+			FSlot& slot = Slots[_id];
+			if (slot.Depth++ == 0)
+			{
+				// seq_cst: the store must be visible before the protected pointer is loaded
+				slot.LocalEpoch.store(GlobalEpoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+			}
+		}
+
+		void Exit()
+		{
+			const int32 _id = FEpochThreadId::Get();
+			if (_id < 0)
+			{
+				check(OverflowReaders.load(std::memory_order_relaxed) > 0);
+				OverflowReaders.fetch_sub(1, std::memory_order_release);
+				return;
+			}
+			FSlot& slot = Slots[_id];
+			check(slot.Depth > 0);
+			if (--slot.Depth == 0)
+			{
+				slot.LocalEpoch.store(0, std::memory_order_release);
+			}
+		}
+
+		/*
+		* hand over an object that readers may still see
+		* call after it was unlinked from the shared pointer
+		*/
+		void Retire(void* InObject, FDeleter InDeleter)
+		{
+			std::lock_guard<std::mutex> scopelock(RetireLock);
+			FRetired _retired;
+			_retired.Object = InObject;
+			_retired.Deleter = InDeleter;
+			_retired.Epoch = GlobalEpoch.fetch_add(1, std::memory_order_seq_cst);
+			RetireList.push_back(_retired);
+			ReclaimLocked();
+		}
+
+		template<typename T>
+		void Retire(T* InObject)
+		{
+			Retire(InObject, [](void* InPtr) { delete static_cast<T*>(InPtr); });
+		}
+
+		// delete what no reader can see any more, @return objects still waiting
+		int32 Reclaim()
+		{
+			std::lock_guard<std::mutex> scopelock(RetireLock);
+			ReclaimLocked();
+			return (int32)RetireList.size();
+		}
+
+		uint64 GetEpoch() const { return GlobalEpoch.load(std::memory_order_relaxed); }
+
+	protected:
+		void ReclaimLocked()
+		{
+			if (OverflowReaders.load(std::memory_order_seq_cst) > 0)
+			{
+				// their epochs are unknown, anything retired may still be seen
+				return;
+			}
+			uint64 _minActive = GlobalEpoch.load(std::memory_order_seq_cst);
+			for (int32 i = 0; i < EPOCH_MAX_THREADS; ++i)
+			{
+				uint64 local = Slots[i].LocalEpoch.load(std::memory_order_seq_cst);
+				if (local != 0 && local < _minActive)
+				{
+					_minActive = local;
+				}
+			}
+
+			SIZE_T _kept = 0;
+			for (SIZE_T i = 0; i < RetireList.size(); ++i)
+			{
+				if (RetireList[i].Epoch < _minActive)
+				{
+					RetireList[i].Deleter(RetireList[i].Object);
+				}
+				else
+				{
+					RetireList[_kept++] = RetireList[i];
+				}
+			}
+			RetireList.resize(_kept);
+		}
+
+	private:
+		FEpochManager(const FEpochManager&);
+		FEpochManager& operator=(const FEpochManager&);
+
+		struct alignas(64) FSlot
+		{
+			std::atomic<uint64> LocalEpoch;	// 0 = outside
+			int32 Depth;					// owner thread only
+		};
+
+		struct FRetired
+		{
+			void* Object;
+			FDeleter Deleter;
+			uint64 Epoch;
+		};
+
+		alignas(64) std::atomic<uint64> GlobalEpoch;
+		FSlot Slots[EPOCH_MAX_THREADS];
+		// readers inside without a slot, nesting counts too
+		alignas(64) std::atomic<int32> OverflowReaders;
+
+		std::mutex RetireLock;
+		std::vector<FRetired> RetireList;
+	};
+
+	/*
+	*	scope of a reader inside FEpochManager
+	*/
+	class FEpochGuard
+	{
+	public:
+		explicit FEpochGuard(FEpochManager& InManager)
+			:Manager(InManager)
+		{
+			Manager.Enter();
+		}
+
+		~FEpochGuard()
+		{
+			Manager.Exit();
+		}
+
+	private:
+		FEpochGuard(const FEpochGuard&);
+		FEpochGuard& operator=(const FEpochGuard&);
+
+		FEpochManager& Manager;
+	};
+}
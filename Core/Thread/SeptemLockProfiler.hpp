@@ -0,0 +1,352 @@
+/*
+	Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+	LICENSE:	GNU General Public License V3.0
+
+	As a special exception,  you may use this file  as part of a free software library without
+	restriction.  Specifically,  if other files instantiate templates  or use macros or inline
+	functions from this file, or you compile this file and link it with other files to produce
+	an executable,  this file does not by itself cause the resulting executable to be covered
+	by the GNU General Public License. This exception does not however invalidate any other
+	reasons why the executable file might be covered by the GNU General Public License.
+
+	Support Email:	guij@sari.ac.cn
+*/
+
+#pragma once
+
+#include <Core/Public/marco.h>
+#include <Core/Thread/ScopLock.h>
+
+/*
+*	Lock contention profiler
+*	0: SCOPE_LOCK_PROFILED is a plain TScopeLock, no site, no clock, no counter
+*	1: every SCOPE_LOCK_PROFILED site records acquisitions, wait & hold histograms
+*		while FLockProfiler::SetEnabled(true)
+*/
+#ifndef SEPTEM_LOCK_PROFILER
+#define SEPTEM_LOCK_PROFILER 0
+#endif // !SEPTEM_LOCK_PROFILER
+
+/// histogram bucket i counts times in [2^i, 2^(i+1)) nanoseconds
+#ifndef LOCK_PROFILER_HISTOGRAM_BUCKETS
+#define LOCK_PROFILER_HISTOGRAM_BUCKETS 32
+#endif // !LOCK_PROFILER_HISTOGRAM_BUCKETS
+
+#define SEPTEM_LOCK_CONCAT_INNER(A, B) A##B
+#define SEPTEM_LOCK_CONCAT(A, B) SEPTEM_LOCK_CONCAT_INNER(A, B)
+
+#if SEPTEM_LOCK_PROFILER
+
+#include <atomic>
+#include <type_traits>
+#include <time.h>
+#include <unistd.h>
+
+namespace Septem
+{
+	/*
+	*	One lock site, keyed by __FILE__ / __LINE__
+	*	lives in a function local static and links itself into the site list
+	*/
+	struct FLockSite
+	{
+		const char* File;
+		int32 Line;
+		std::atomic<uint64> Acquisitions;
+		std::atomic<uint64> WaitNanoseconds;
+		std::atomic<uint64> HoldNanoseconds;
+		std::atomic<uint64> WaitHistogram[LOCK_PROFILER_HISTOGRAM_BUCKETS];
+		std::atomic<uint64> HoldHistogram[LOCK_PROFILER_HISTOGRAM_BUCKETS];
+		FLockSite* Next;
+
+		FLockSite(const char* InFile, int32 InLine);
+
+		void Reset();
+	};
+
+	/*
+	*	Lock Profiler
+	*	runtime switch & dump api of all lock sites
+	*	Dump() is async-signal-safe: no malloc, no lock, only write(2)
+	*/
+	class FLockProfiler
+	{
+	public:
+		static bool IsEnabled()
+		{
+			return EnabledFlag().load(std::memory_order_relaxed);
+		}
+
+		static void SetEnabled(bool bEnable)
+		{
+			EnabledFlag().store(bEnable, std::memory_order_relaxed);
+		}
+
+		static uint64 NowNanoseconds()
+		{
+			timespec tp;
+			clock_gettime(CLOCK_MONOTONIC, &tp);
+			return (uint64)tp.tv_sec * 1000000000ULL + (uint64)tp.tv_nsec;
+		}
+
+		static int32 BucketOf(uint64 InNanoseconds)
+		{
+			int32 bucket = InNanoseconds == 0 ? 0 : 63 - __builtin_clzll(InNanoseconds);
+			return bucket < LOCK_PROFILER_HISTOGRAM_BUCKETS ? bucket : LOCK_PROFILER_HISTOGRAM_BUCKETS - 1;
+		}
+
+		static void Register(FLockSite* InSite)
+		{
+			FLockSite* head = SiteListHead().load(std::memory_order_relaxed);
+			do
+			{
+				InSite->Next = head;
+			} while (!SiteListHead().compare_exchange_weak(head, InSite, std::memory_order_release, std::memory_order_relaxed));
+		}
+
+		// visit every registered site, newest first
+		template<typename FuncType>
+		static void ForEachSite(FuncType&& InFunc)
+		{
+			for (FLockSite* site = SiteListHead().load(std::memory_order_acquire); site; site = site->Next)
+			{
+				InFunc(*site);
+			}
+		}
+
+		static void Reset()
+		{
+			ForEachSite([](FLockSite& InSite) { InSite.Reset(); });
+		}
+
+		/*
+		*	write a text report of every site into fd
+		*	format per site:
+		*	file:line acq=N wait_ns=N hold_ns=N
+		*		wait [bucket]=count ...
+		*		hold [bucket]=count ...
+		*/
+		static void Dump(int InFd)
+		{
+			ForEachSite([InFd](FLockSite& InSite) { DumpSite(InFd, InSite); });
+		}
+
+	private:
+		static std::atomic<bool>& EnabledFlag()
+		{
+			static std::atomic<bool> bEnabled(true);
+			return bEnabled;
+		}
+
+		static std::atomic<FLockSite*>& SiteListHead()
+		{
+			static std::atomic<FLockSite*> head(nullptr);
+			return head;
+		}
+
+		struct FDumpLine
+		{
+			char Buffer[512];
+			int32 Length;
+
+			FDumpLine() :Length(0) {}
+
+			void Append(const char* InStr)
+			{
+				while (*InStr && Length < (int32)sizeof(Buffer))
+				{
+					Buffer[Length++] = *InStr++;
+				}
+			}
+
+			void Append(uint64 InValue)
+			{
+				char digits[24];
+				int32 n = 0;
+				do
+				{
+					digits[n++] = (char)('0' + InValue % 10);
+					InValue /= 10;
+				} while (InValue);
+				while (n > 0 && Length < (int32)sizeof(Buffer))
+				{
+					Buffer[Length++] = digits[--n];
+				}
+			}
+
+			void Flush(int InFd)
+			{
+				int32 written = 0;
+				while (written < Length)
+				{
+					ssize_t k = ::write(InFd, Buffer + written, Length - written);
+					if (k <= 0)
+						break;
+					written += (int32)k;
+				}
+				Length = 0;
+			}
+		};
+
+		static void DumpHistogram(int InFd, const char* InName, std::atomic<uint64>* InHistogram)
+		{
+			FDumpLine line;
+			line.Append("\t");
+			line.Append(InName);
+			for (int32 i = 0; i < LOCK_PROFILER_HISTOGRAM_BUCKETS; ++i)
+			{
+				uint64 count = InHistogram[i].load(std::memory_order_relaxed);
+				if (count == 0)
+					continue;
+				line.Append(" [");
+				line.Append((uint64)1 << i);
+				line.Append("ns]=");
+				line.Append(count);
+			}
+			line.Append("\n");
+			line.Flush(InFd);
+		}
+
+		static void DumpSite(int InFd, FLockSite& InSite)
+		{
+			FDumpLine line;
+			line.Append(InSite.File);
+			line.Append(":");
+			line.Append((uint64)InSite.Line);
+			line.Append(" acq=");
+			line.Append(InSite.Acquisitions.load(std::memory_order_relaxed));
+			line.Append(" wait_ns=");
+			line.Append(InSite.WaitNanoseconds.load(std::memory_order_relaxed));
+			line.Append(" hold_ns=");
+			line.Append(InSite.HoldNanoseconds.load(std::memory_order_relaxed));
+			line.Append("\n");
+			line.Flush(InFd);
+
+			DumpHistogram(InFd, "wait", InSite.WaitHistogram);
+			DumpHistogram(InFd, "hold", InSite.HoldHistogram);
+		}
+	};
+
+	inline FLockSite::FLockSite(const char* InFile, int32 InLine)
+		:File(InFile)
+		, Line(InLine)
+		, Acquisitions(0)
+		, WaitNanoseconds(0)
+		, HoldNanoseconds(0)
+		, Next(nullptr)
+	{
+		for (int32 i = 0; i < LOCK_PROFILER_HISTOGRAM_BUCKETS; ++i)
+		{
+			WaitHistogram[i].store(0, std::memory_order_relaxed);
+			HoldHistogram[i].store(0, std::memory_order_relaxed);
+		}
+		FLockProfiler::Register(this);
+	}
+
+	inline void FLockSite::Reset()
+	{
+		Acquisitions.store(0, std::memory_order_relaxed);
+		WaitNanoseconds.store(0, std::memory_order_relaxed);
+		HoldNanoseconds.store(0, std::memory_order_relaxed);
+		for (int32 i = 0; i < LOCK_PROFILER_HISTOGRAM_BUCKETS; ++i)
+		{
+			WaitHistogram[i].store(0, std::memory_order_relaxed);
+			HoldHistogram[i].store(0, std::memory_order_relaxed);
+		}
+	}
+
+	/*
+	*	Profiled scope lock
+	*	same as TScopeLock, plus wait / hold timing into FLockSite
+	*	use SCOPE_LOCK_PROFILED(&locker) instead of constructing it directly
+	*/
+	template<typename LockType>
+	class TProfiledScopeLock
+	{
+	public:
+		TProfiledScopeLock(LockType* InLockObject, FLockSite* InSite)
+			:lockObject(InLockObject)
+			, site(FLockProfiler::IsEnabled() ? InSite : nullptr)
+			, lockedTime(0)
+		{
+			check(lockObject);
+			if (site)
+			{
+				uint64 waitBegin = FLockProfiler::NowNanoseconds();
+				TLockTraits<LockType>::Lock(lockObject);
+				lockedTime = FLockProfiler::NowNanoseconds();
+
+				uint64 wait = lockedTime - waitBegin;
+				site->Acquisitions.fetch_add(1, std::memory_order_relaxed);
+				site->WaitNanoseconds.fetch_add(wait, std::memory_order_relaxed);
+				site->WaitHistogram[FLockProfiler::BucketOf(wait)].fetch_add(1, std::memory_order_relaxed);
+			}
+			else
+			{
+				TLockTraits<LockType>::Lock(lockObject);
+			}
+		}
+
+		~TProfiledScopeLock()
+		{
+			check(lockObject);
+			if (site)
+			{
+				uint64 hold = FLockProfiler::NowNanoseconds() - lockedTime;
+				TLockTraits<LockType>::Unlock(lockObject);
+				site->HoldNanoseconds.fetch_add(hold, std::memory_order_relaxed);
+				site->HoldHistogram[FLockProfiler::BucketOf(hold)].fetch_add(1, std::memory_order_relaxed);
+			}
+			else
+			{
+				TLockTraits<LockType>::Unlock(lockObject);
+			}
+		}
+
+	private:
+		/** Copy constructor( hidden on purpose). */
+		TProfiledScopeLock(const TProfiledScopeLock& InScopeLock);
+
+		/** Assignment operator (hidden on purpose). */
+		TProfiledScopeLock& operator=(TProfiledScopeLock& InScopeLock);
+
+	private:
+		LockType* lockObject;
+		FLockSite* site;
+		uint64 lockedTime;
+	};
+}
+
+/*
+*	User Guide
+*	SCOPE_LOCK_PROFILED(&m_QueueLocker);	// instead of ScopeLock _scopelock(&m_QueueLocker);
+*	Septem::FLockProfiler::Dump(STDERR_FILENO);
+*/
+#define SCOPE_LOCK_PROFILED(LockPtr) \
+	static Septem::FLockSite SEPTEM_LOCK_CONCAT(_locksite_, __LINE__)(__FILE__, __LINE__); \
+	Septem::TProfiledScopeLock< typename std::remove_pointer<decltype(LockPtr)>::type > \
+		SEPTEM_LOCK_CONCAT(_scopelock_, __LINE__)(LockPtr, &SEPTEM_LOCK_CONCAT(_locksite_, __LINE__))
+
+#else
+
+#include <type_traits>
+
+namespace Septem
+{
+	// profiler compiled out: keep the api, do nothing
+	class FLockProfiler
+	{
+	public:
+		static bool IsEnabled() { return false; }
+		static void SetEnabled(bool) {}
+		static void Reset() {}
+		static void Dump(int) {}
+	};
+}
+
+#define SCOPE_LOCK_PROFILED(LockPtr) \
+	Septem::TScopeLock< typename std::remove_pointer<decltype(LockPtr)>::type > \
+		SEPTEM_LOCK_CONCAT(_scopelock_, __LINE__)(LockPtr)
+
+#endif // SEPTEM_LOCK_PROFILER
@@ -0,0 +1,316 @@
+/*
+	Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+	LICENSE:	GNU General Public License V3.0
+
+	As a special exception,  you may use this file  as part of a free software library without
+	restriction.  Specifically,  if other files instantiate templates  or use macros or inline
+	functions from this file, or you compile this file and link it with other files to produce
+	an executable,  this file does not by itself cause the resulting executable to be covered
+	by the GNU General Public License. This exception does not however invalidate any other
+	reasons why the executable file might be covered by the GNU General Public License.
+
+	Support Email:	guij@sari.ac.cn
+*/
+
+#pragma once
+
+#include <Core/Public/marco.h>
+
+#include <atomic>
+
+#ifdef LINUX
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif // LINUX
+
+/// spin rounds of FTicketSpinLock before yielding the cpu to the ticket owner
+#ifndef DEFAULT_TICKET_YIELD_COUNT
+#define DEFAULT_TICKET_YIELD_COUNT 1024
+#endif // !DEFAULT_TICKET_YIELD_COUNT
+
+/// default spin rounds of FAdaptiveMutex before parking the thread
+#ifndef DEFAULT_ADAPTIVE_SPIN_COUNT
+#define DEFAULT_ADAPTIVE_SPIN_COUNT 128
+#endif // !DEFAULT_ADAPTIVE_SPIN_COUNT
+
+// hint the cpu that we are inside a spin-wait loop
+#ifndef SEPTEM_CPU_RELAX
+#if defined(__x86_64__) || defined(__i386__)
+#define SEPTEM_CPU_RELAX() __builtin_ia32_pause()
+#elif PLATFORM_CPU_ARM_FAMILY
+#define SEPTEM_CPU_RELAX() __asm__ __volatile__("yield")
+#else
+#define SEPTEM_CPU_RELAX() ((void)0)
+#endif
+#endif // !SEPTEM_CPU_RELAX
+
+namespace Septem
+{
+	/*
+	*	Lock statistics
+	*	Acquisitions: times of the lock been taken
+	*	Contentions: times of the lock been found busy when taking
+	*/
+	struct FLockStats
+	{
+		uint64 Acquisitions;
+		uint64 Contentions;
+	};
+
+	/*
+	*	Contention counter shared by all lock types
+	*	relaxed atomics, the numbers are for profiling only
+	*/
+	class FLockCounter
+	{
+	public:
+		FLockCounter()
+			:Acquisitions(0)
+			, Contentions(0)
+		{}
+
+		void OnAcquire(bool bContended)
+		{
+			Acquisitions.fetch_add(1, std::memory_order_relaxed);
+			if (bContended)
+			{
+				Contentions.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+
+		FLockStats GetStats() const
+		{
+			FLockStats stats;
+			stats.Acquisitions = Acquisitions.load(std::memory_order_relaxed);
+			stats.Contentions = Contentions.load(std::memory_order_relaxed);
+			return stats;
+		}
+
+		void ResetStats()
+		{
+			Acquisitions.store(0, std::memory_order_relaxed);
+			Contentions.store(0, std::memory_order_relaxed);
+		}
+
+	private:
+		std::atomic<uint64> Acquisitions;
+		std::atomic<uint64> Contentions;
+	};
+
+	/*
+	*	Ticket Spin Lock
+	*	FIFO fair, never parks the thread (only yields after long spinning)
+	*	use it when the critical section is only a few dozen nanoseconds
+	*/
+	class FTicketSpinLock : public FLockCounter
+	{
+	public:
+		FTicketSpinLock()
+			:NextTicket(0)
+			, NowServing(0)
+		{}
+
+		void Lock()
+		{
+			const uint32 ticket = NextTicket.fetch_add(1, std::memory_order_relaxed);
+			bool bContended = false;
+			int32 spins = 0;
+			while (NowServing.load(std::memory_order_acquire) != ticket)
+			{
+				bContended = true;
+				if (++spins < DEFAULT_TICKET_YIELD_COUNT)
+				{
+					SEPTEM_CPU_RELAX();
+				}
+				else
+				{
+					// the owner may be preempted on an oversubscribed cpu
+					spins = 0;
+					sched_yield();
+				}
+			}
+			OnAcquire(bContended);
+		}
+
+		bool TryLock()
+		{
+			uint32 serving = NowServing.load(std::memory_order_relaxed);
+			uint32 expected = serving;
+			if (NextTicket.compare_exchange_strong(expected, serving + 1, std::memory_order_acquire, std::memory_order_relaxed))
+			{
+				OnAcquire(false);
+				return true;
+			}
+			return false;
+		}
+
+		void Unlock()
+		{
+			// only the owner writes NowServing
+			NowServing.store(NowServing.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		}
+
+	private:
+		FTicketSpinLock(const FTicketSpinLock&);
+		FTicketSpinLock& operator=(const FTicketSpinLock&);
+
+		std::atomic<uint32> NextTicket;
+		std::atomic<uint32> NowServing;
+	};
+
+	/*
+	*	Adaptive Mutex
+	*	spin SpinCount rounds first, then park on futex
+	*	State: 0 unlocked, 1 locked, 2 locked with waiters
+	*/
+	class FAdaptiveMutex : public FLockCounter
+	{
+	public:
+		FAdaptiveMutex(int32 InSpinCount = DEFAULT_ADAPTIVE_SPIN_COUNT)
+			:State(0)
+			, SpinCount(InSpinCount)
+		{}
+
+		void Lock()
+		{
+			int32 expected = 0;
+			if (State.compare_exchange_strong(expected, 1, std::memory_order_acquire, std::memory_order_relaxed))
+			{
+				OnAcquire(false);
+				return;
+			}
+
+			// 1. bounded spinning
+			for (int32 i = 0; i < SpinCount; ++i)
+			{
+				SEPTEM_CPU_RELAX();
+				expected = 0;
+				if (State.load(std::memory_order_relaxed) == 0
+					&& State.compare_exchange_weak(expected, 1, std::memory_order_acquire, std::memory_order_relaxed))
+				{
+					OnAcquire(true);
+					return;
+				}
+			}
+
+			// 2. park: mark contended and sleep until unlocked
+			while (State.exchange(2, std::memory_order_acquire) != 0)
+			{
+				Park();
+			}
+			OnAcquire(true);
+		}
+
+		bool TryLock()
+		{
+			int32 expected = 0;
+			if (State.compare_exchange_strong(expected, 1, std::memory_order_acquire, std::memory_order_relaxed))
+			{
+				OnAcquire(false);
+				return true;
+			}
+			return false;
+		}
+
+		void Unlock()
+		{
+			if (State.exchange(0, std::memory_order_release) == 2)
+			{
+				Unpark();
+			}
+		}
+
+		void SetSpinCount(int32 InSpinCount)
+		{
+			SpinCount = InSpinCount;
+		}
+
+	private:
+		FAdaptiveMutex(const FAdaptiveMutex&);
+		FAdaptiveMutex& operator=(const FAdaptiveMutex&);
+
+		void Park()
+		{
+#ifdef LINUX
+			::syscall(SYS_futex, reinterpret_cast<int32*>(&State), FUTEX_WAIT_PRIVATE, 2, nullptr, nullptr, 0);
+#else
+			SEPTEM_CPU_RELAX();
+#endif // LINUX
+		}
+
+		void Unpark()
+		{
+#ifdef LINUX
+			::syscall(SYS_futex, reinterpret_cast<int32*>(&State), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#endif // LINUX
+		}
+
+		std::atomic<int32> State;
+		int32 SpinCount;
+	};
+
+	/*
+	*	Reader Writer Lock
+	*	many readers or one writer, blocking threads park in pthread_rwlock
+	*	contention is counted when the try-lock fast path fails
+	*/
+	class FRWLock : public FLockCounter
+	{
+	public:
+		FRWLock()
+		{
+			pthread_rwlock_init(&RWLock, nullptr);
+		}
+
+		~FRWLock()
+		{
+			pthread_rwlock_destroy(&RWLock);
+		}
+
+		void ReadLock()
+		{
+			if (pthread_rwlock_tryrdlock(&RWLock) == 0)
+			{
+				OnAcquire(false);
+				return;
+			}
+			pthread_rwlock_rdlock(&RWLock);
+			OnAcquire(true);
+		}
+
+		void ReadUnlock()
+		{
+			pthread_rwlock_unlock(&RWLock);
+		}
+
+		void WriteLock()
+		{
+			if (pthread_rwlock_trywrlock(&RWLock) == 0)
+			{
+				OnAcquire(false);
+				return;
+			}
+			pthread_rwlock_wrlock(&RWLock);
+			OnAcquire(true);
+		}
+
+		void WriteUnlock()
+		{
+			pthread_rwlock_unlock(&RWLock);
+		}
+
+		// exclusive by default, so FRWLock can be wrapped by TScopeLock directly
+		void Lock() { WriteLock(); }
+		void Unlock() { WriteUnlock(); }
+
+	private:
+		FRWLock(const FRWLock&);
+		FRWLock& operator=(const FRWLock&);
+
+		pthread_rwlock_t RWLock;
+	};
+}
@@ -17,12 +17,14 @@
 
 #include <Core/Public/marco.h>
 #include <Core/Thread/ScopLock.h>
+#include <Core/Thread/SeptemLockProfiler.hpp>
 #include <Core/Templates/SeptemRecyclePool.hpp>
 
 #ifdef LINUX
 #include <pthread.h>
 #endif // LINUX
 
+#include <stdio.h>
 #include <queue>
 #include <functional>/// delegate
 
@@ -183,7 +185,7 @@ namespace Septem
 	{
 		if (bRunning)
 		{
-			ScopeLock _scopelock(&m_QueueLocker);
+			SCOPE_LOCK_PROFILED(&m_QueueLocker);
 			taskQueue.push(InTask);
 		}
 	}
@@ -193,7 +195,7 @@ namespace Septem
 	{
 		if (bRunning)
 		{
-			ScopeLock _scopelock(&m_QueueLocker);
+			SCOPE_LOCK_PROFILED(&m_QueueLocker);
 			taskQueue.push(InTask);
 		}
 	}
@@ -201,7 +203,7 @@ namespace Septem
 	template<typename TaskType>
 	inline bool TTaskThread<TaskType>::PopTask(std::shared_ptr<TaskType>& OutTask)
 	{
-		ScopeLock _scopelock(&m_QueueLocker);
+		SCOPE_LOCK_PROFILED(&m_QueueLocker);
 		if (taskQueue.empty())
 		{
 			return false;
@@ -215,7 +217,7 @@ namespace Septem
 	template<typename TaskType>
 	inline void TTaskThread<TaskType>::ClearTaskQueue()
 	{
-		ScopeLock _scopelock(&m_QueueLocker);
+		SCOPE_LOCK_PROFILED(&m_QueueLocker);
 		while (taskQueue.size() > 0) taskQueue.pop();
 	}
 
@@ -0,0 +1,177 @@
+/*
+	Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+	LICENSE:	GNU General Public License V3.0
+
+	As a special exception,  you may use this file  as part of a free software library without
+	restriction.  Specifically,  if other files instantiate templates  or use macros or inline
+	functions from this file, or you compile this file and link it with other files to produce
+	an executable,  this file does not by itself cause the resulting executable to be covered
+	by the GNU General Public License. This exception does not however invalidate any other
+	reasons why the executable file might be covered by the GNU General Public License.
+
+	Support Email:	guij@sari.ac.cn
+*/
+
+#pragma once
+
+#include <Core/Public/marco.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// indexes taken by one worker per grab in ParallelFor
+#ifndef DEFAULT_PARALLEL_GRAIN
+#define DEFAULT_PARALLEL_GRAIN 256
+#endif // !DEFAULT_PARALLEL_GRAIN
+
+namespace Septem
+{
+	/*
+	*	Worker Pool
+	*	fork-join ParallelFor over an index range
+	*	the calling thread works too, so NumWorkers() = background threads + 1
+	*	InThreadNum = 0 runs everything inline on the caller
+	*	one ParallelFor at a time, calls from several threads are serialized
+	*/
+	class FWorkerPool
+	{
+	public:
+		FWorkerPool(int32 InThreadNum = (int32)std::thread::hardware_concurrency() - 1)
+			:bStopping(false)
+			, Generation(0)
+			, JobBegin(0)
+			, JobEnd(0)
+			, JobGrain(1)
+			, NextIndex(0)
+			, ActiveWorkers(0)
+		{
+			for (int32 i = 0; i < InThreadNum; ++i)
+			{
+				Threads.emplace_back(&FWorkerPool::WorkerRun, this, i + 1);
+			}
+		}
+
+		virtual ~FWorkerPool()
+		{
+			{
+				std::lock_guard<std::mutex> scopelock(JobLock);
+				bStopping = true;
+			}
+			JobReady.notify_all();
+			for (std::thread& thread : Threads)
+			{
+				thread.join();
+			}
+		}
+
+		int32 NumWorkers() const
+		{
+			return (int32)Threads.size() + 1;
+		}
+
+		/*
+		*	call InFunc(index, workerIndex) for index in [InBegin, InEnd)
+		*	workerIndex in [0, NumWorkers()), 0 is the calling thread
+		*	block until every index is done
+		*/
+		template<typename FuncType>
+		void ParallelFor(int32 InBegin, int32 InEnd, FuncType&& InFunc, int32 InGrain = DEFAULT_PARALLEL_GRAIN)
+		{
+			if (InEnd <= InBegin)
+				return;
+
+			if (Threads.empty() || InEnd - InBegin <= InGrain)
+			{
+				for (int32 i = InBegin; i < InEnd; ++i)
+				{
+					InFunc(i, 0);
+				}
+				return;
+			}
+
+			std::lock_guard<std::mutex> callLock(CallLock);
+			{
+				std::lock_guard<std::mutex> scopelock(JobLock);
+				JobFunc = [&InFunc](int32 InIndex, int32 InWorker) { InFunc(InIndex, InWorker); };
+				JobBegin = InBegin;
+				JobEnd = InEnd;
+				JobGrain = InGrain > 0 ? InGrain : 1;
+				NextIndex.store(InBegin, std::memory_order_relaxed);
+				ActiveWorkers = (int32)Threads.size();
+				++Generation;
+			}
+			JobReady.notify_all();
+
+			RunChunks(0);
+
+			// wait for background workers to leave the job
+			std::unique_lock<std::mutex> scopelock(JobLock);
+			JobDone.wait(scopelock, [this]() { return ActiveWorkers == 0; });
+			JobFunc = nullptr;
+		}
+
+	protected:
+		void RunChunks(int32 InWorker)
+		{
+			for (;;)
+			{
+				int32 begin = NextIndex.fetch_add(JobGrain, std::memory_order_relaxed);
+				if (begin >= JobEnd)
+					break;
+				int32 end = begin + JobGrain < JobEnd ? begin + JobGrain : JobEnd;
+				for (int32 i = begin; i < end; ++i)
+				{
+					JobFunc(i, InWorker);
+				}
+			}
+		}
+
+		void WorkerRun(int32 InWorker)
+		{
+			uint64 seenGeneration = 0;
+			for (;;)
+			{
+				{
+					std::unique_lock<std::mutex> scopelock(JobLock);
+					JobReady.wait(scopelock, [this, seenGeneration]() { return bStopping || Generation != seenGeneration; });
+					if (bStopping)
+						return;
+					seenGeneration = Generation;
+				}
+
+				RunChunks(InWorker);
+
+				{
+					std::lock_guard<std::mutex> scopelock(JobLock);
+					--ActiveWorkers;
+				}
+				JobDone.notify_one();
+			}
+		}
+
+	private:
+		FWorkerPool(const FWorkerPool&);
+		FWorkerPool& operator=(const FWorkerPool&);
+
+		std::vector<std::thread> Threads;
+		std::mutex CallLock;
+
+		std::mutex JobLock;
+		std::condition_variable JobReady;
+		std::condition_variable JobDone;
+		bool bStopping;
+		uint64 Generation;
+
+		std::function<void(int32, int32)> JobFunc;
+		int32 JobBegin;
+		int32 JobEnd;
+		int32 JobGrain;
+		std::atomic<int32> NextIndex;
+		int32 ActiveWorkers;
+	};
+}
@@ -0,0 +1,126 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#pragma once
+
+#include <Core/Public/marco.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+namespace Septem
+{
+	/**
+	* Servo Net packet Body View
+	* a T read in place from the receive buffer, the zero copy counterpart of TSNetBufferWrapper
+	*	T is the wire layout itself: trivially copyable, no vtable, no FStaticNetBodyBase
+	*	Bind checks bounds and alignment, nothing is copied
+	* declare T inside #pragma pack(push, 1) and it binds at any offset,
+	* frames follow each other in the receive buffer, wider alignments often fail Bind
+	* the view does not own the bytes: valid while the buffer is, read only
+	*/
+	template<typename T>
+	class TSNetBodyView
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "TSNetBodyView needs a trivially copyable T");
+
+	public:
+		TSNetBodyView()
+			:Ptr(nullptr)
+		{
+		}
+
+		explicit TSNetBodyView(const T& InValue)
+			:Ptr(&InValue)
+		{
+		}
+
+		/**
+		* view the first MemSize() bytes of Data as a T
+		*
+		* @param Data the ptr of the body in the buffer
+		* @param BufferSize the bytes left in the buffer
+		* @return false if the buffer is too short or Data is misaligned for T, the view is unbound then
+		*/
+		bool Bind(const uint8* Data, int32 BufferSize)
+		{
+			Ptr = nullptr;
+			if (nullptr == Data || BufferSize < MemSize() || !IsAligned(Data))
+			{
+				return false;
+			}
+			Ptr = reinterpret_cast<const T*>(Data);
+			return true;
+		}
+
+		void Reset()
+		{
+			Ptr = nullptr;
+		}
+
+		bool IsValid() const
+		{
+			return Ptr != nullptr;
+		}
+
+		const T* Get() const
+		{
+			return Ptr;
+		}
+
+		const T& operator*() const
+		{
+			check(Ptr);
+			return *Ptr;
+		}
+
+		const T* operator->() const
+		{
+			check(Ptr);
+			return Ptr;
+		}
+
+		const uint8* GetData() const
+		{
+			return reinterpret_cast<const uint8*>(Ptr);
+		}
+
+		// value copy, for keeping it past the buffer
+		T Copy() const
+		{
+			check(Ptr);
+			T _value;
+			memcpy(&_value, Ptr, sizeof(T));
+			return _value;
+		}
+
+		/**
+		 * sigma xor {every byte}, same as the body part of the fastcode
+		 *
+		 * @return xor
+		 */
+		uint8 XOR() const
+		{
+			uint8 _xor = 0;
+			const uint8* _ptr = GetData();
+			for (int32 i = 0; _ptr && i < MemSize(); ++i)
+			{
+				_xor ^= _ptr[i];
+			}
+			return _xor;
+		}
+
+		static constexpr int32 MemSize()
+		{
+			return (int32)sizeof(T);
+		}
+
+		static bool IsAligned(const uint8* Data)
+		{
+			return ((uintptr_t)Data & (alignof(T) - 1)) == 0;
+		}
+
+	protected:
+		const T* Ptr;
+	};
+}
@@ -55,7 +55,7 @@ namespace Septem {
 		 * @note To be called only from consumer thread.
 		 * @see Push
 		 */
-		virtual bool Pop(const std::shared_ptr<T>& OutSharedPtr) = 0;
+		virtual bool Pop(std::shared_ptr<T>& OutSharedPtr) = 0;
 
 		// not Thread-safe
 		virtual bool IsEmpty() = 0;
@@ -71,8 +71,6 @@ namespace Septem {
 	public:
 		TNetPacketStack()
 		{
-			std::lock_guard<std::mutex> scopelock(PoolLock);
-			Pool.resize(MAX_NETPACKET_IN_POOL);
 		}
 
 		virtual ~TNetPacketStack()
@@ -89,7 +87,7 @@ namespace Septem {
 			return true;
 		}
 		
-		virtual bool Pop(const std::shared_ptr<T>& OutSharedPtr) override
+		virtual bool Pop(std::shared_ptr<T>& OutSharedPtr) override
 		{
 			std::lock_guard<std::mutex> scopelock(PoolLock);
 			if (IsEmpty())
@@ -135,9 +133,12 @@ namespace Septem {
 			return true;
 		}
 
-		virtual bool Pop(const std::shared_ptr<T>& OutSharedPtr) override
+		virtual bool Pop(std::shared_ptr<T>& OutSharedPtr) override
 		{
 			std::lock_guard<std::mutex> scopelock(PoolLock);
+			if (Pool.empty())
+				return false;
+			OutSharedPtr = std::move(Pool.front());
 			Pool.pop();
 			return true;
 		}
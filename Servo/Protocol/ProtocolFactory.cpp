@@ -2,9 +2,12 @@
 
 
 #include "ProtocolFactory.h"
+#include "ProtocolTaskThread.h"
 
 namespace Septem {
 	FProtocolFactory::FProtocolFactory()
+		:DispatchTable(nullptr)
+		, LocalTable(nullptr)
 	{
 		check(pSingleton == nullptr && "singleton can't create 2 object!");
 		pSingleton = this;
@@ -47,35 +50,235 @@ namespace Septem {
 		return *pSingleton;
 	}
 
-	bool FProtocolFactory::RegisterProtocolDeserialize(int32 InUid, std::function<void(FSNetBufferHead&, uint8*, int32, int32&)> && InLambda)
+	bool FProtocolFactory::RegisterProtocolDeserialize(int32 InUid, FDeserializeDelegate && InLambda)
 	{
-		auto itr = ProtocolDeserializeDelegates.insert(std::pair<int32, std::function<void(FSNetBufferHead&, uint8*, int32, int32&)> >(InUid, InLambda));
+		if (InUid < 0 || InUid >= SERVO_PROTOCOL_UID_NUM || !InLambda)
+			return false;
+
+		std::lock_guard<std::mutex> _scopelock(RegisterLock);
+		if (IsFrozen())
+			return RejectFrozen(InUid);
+		if (ProtocolDeserializeFuncs.count(InUid) > 0)
+			return false;
+
+		auto itr = ProtocolDeserializeDelegates.insert(std::pair<int32, FDeserializeDelegate>(InUid, std::move(InLambda)));
 		return itr.second;
 	}
 
-	void FProtocolFactory::CallProtocolDeserialize(FSNetBufferHead & InHead, uint8 * Buffer, int32 BufferSize, int32 & RecivedBytesRead)
+	bool FProtocolFactory::RegisterProtocolDeserialize(int32 InUid, FDeserializeFunc InFunc, void * InContext)
+	{
+		if (InUid < 0 || InUid >= SERVO_PROTOCOL_UID_NUM || nullptr == InFunc)
+			return false;
+
+		std::lock_guard<std::mutex> _scopelock(RegisterLock);
+		if (IsFrozen())
+			return RejectFrozen(InUid);
+		if (ProtocolDeserializeDelegates.count(InUid) > 0)
+			return false;
+
+		FDispatchEntry _entry = { InFunc, InContext };
+		auto itr = ProtocolDeserializeFuncs.insert(std::pair<int32, FDispatchEntry>(InUid, _entry));
+		return itr.second;
+	}
+
+	void FProtocolFactory::InvokeDelegate(void * InContext, FSNetBufferHead & InHead, uint8 * Buffer, int32 BufferSize, int32 & RecivedBytesRead)
+	{
+		(*static_cast<FDeserializeDelegate*>(InContext))(InHead, Buffer, BufferSize, RecivedBytesRead);
+	}
+
+	void FProtocolFactory::InvokeMissing(void *, FSNetBufferHead & InHead, uint8 *, int32, int32 &)
+	{
+		// not find uid class
+		printf(("FProtocolFactory: cannot find packet class with uid = %d, please register it in FProtocolFactory first. \n"), InHead.uid);
+	}
+
+	bool FProtocolFactory::RejectFrozen(int32 InUid)
+	{
+		// the registration macros drop the bool, the uid would stay missing without a word
+		printf(("FProtocolFactory: uid = %d registered after Freeze, ignored. Register and route before Freeze. \n"), InUid);
+		return false;
+	}
+
+	bool FProtocolFactory::FindEntry(int32 InUid, FDispatchEntry & OutEntry, bool bRouted)
+	{
+		std::lock_guard<std::mutex> _scopelock(RegisterLock);
+		if (bRouted)
+		{
+			auto itrRoute = ProtocolRoutes.find(InUid);
+			if (itrRoute != ProtocolRoutes.end())
+			{
+				OutEntry = itrRoute->second;
+				return true;
+			}
+		}
+		auto itrFunc = ProtocolDeserializeFuncs.find(InUid);
+		if (itrFunc != ProtocolDeserializeFuncs.end())
+		{
+			OutEntry = itrFunc->second;
+			return true;
+		}
+		auto itr = ProtocolDeserializeDelegates.find(InUid);
+		if (itr != ProtocolDeserializeDelegates.end())
+		{
+			OutEntry.Func = &InvokeDelegate;
+			OutEntry.Context = &itr->second;
+			return true;
+		}
+		OutEntry.Func = &InvokeMissing;
+		OutEntry.Context = nullptr;
+		return false;
+	}
+
+	bool FProtocolFactory::Freeze()
 	{
-		auto itr = ProtocolDeserializeDelegates.find(InHead.uid);
+		std::lock_guard<std::mutex> _scopelock(RegisterLock);
+		if (IsFrozen())
+			return false;
+
+		DispatchStorage.reset(new FDispatchEntry[SERVO_PROTOCOL_UID_NUM]);
+		FDispatchEntry* _table = DispatchStorage.get();
+		for (int32 i = 0; i < SERVO_PROTOCOL_UID_NUM; ++i)
+		{
+			_table[i].Func = &InvokeMissing;
+			_table[i].Context = nullptr;
+		}
+		for (auto& itr : ProtocolDeserializeDelegates)
+		{
+			_table[itr.first].Func = &InvokeDelegate;
+			_table[itr.first].Context = &itr.second;
+		}
+		for (auto& itr : ProtocolDeserializeFuncs)
+		{
+			_table[itr.first] = itr.second;
+		}
+
+		const FDispatchEntry* _dispatch = _table;
+		if (!ProtocolRoutes.empty())
+		{
+			RouteStorage.reset(new FDispatchEntry[SERVO_PROTOCOL_UID_NUM]);
+			FDispatchEntry* _routed = RouteStorage.get();
+			for (int32 i = 0; i < SERVO_PROTOCOL_UID_NUM; ++i)
+			{
+				_routed[i] = _table[i];
+			}
+			for (auto& itr : ProtocolRoutes)
+			{
+				_routed[itr.first] = itr.second;
+			}
+			_dispatch = _routed;
+		}
 
-		if (itr == ProtocolDeserializeDelegates.end())
+		// publish, readers see complete tables; DispatchTable last, it marks frozen
+		LocalTable.store(_table, std::memory_order_release);
+		DispatchTable.store(_dispatch, std::memory_order_release);
+		return true;
+	}
+
+	void FProtocolFactory::CallProtocolDeserialize(FSNetBufferHead & InHead, uint8 * Buffer, int32 BufferSize, int32 & RecivedBytesRead)
+	{
+		const FDispatchEntry* _table = DispatchTable.load(std::memory_order_acquire);
+		if (_table)
 		{
-			// not find uid class
-			printf(("FProtocolFactory: cannot find packet class with uid = %d, please register it in FProtocolFactory first. \n"), InHead.uid);
+			// uid is a uint16, always inside the table
+			const FDispatchEntry& _entry = _table[InHead.uid];
+			_entry.Func(_entry.Context, InHead, Buffer, BufferSize, RecivedBytesRead);
+			return;
 		}
-		else {
-			itr->second(InHead, Buffer, BufferSize, RecivedBytesRead);
+
+		// not frozen yet: registration is still open, look up under the lock
+		FDispatchEntry _entry;
+		FindEntry(InHead.uid, _entry, true);
+		_entry.Func(_entry.Context, InHead, Buffer, BufferSize, RecivedBytesRead);
+	}
+
+	void FProtocolFactory::CallLocalDeserialize(FSNetBufferHead & InHead, uint8 * Buffer, int32 BufferSize, int32 & RecivedBytesRead)
+	{
+		const FDispatchEntry* _table = LocalTable.load(std::memory_order_acquire);
+		if (_table)
+		{
+			const FDispatchEntry& _entry = _table[InHead.uid];
+			_entry.Func(_entry.Context, InHead, Buffer, BufferSize, RecivedBytesRead);
+			return;
 		}
+
+		FDispatchEntry _entry;
+		FindEntry(InHead.uid, _entry);
+		_entry.Func(_entry.Context, InHead, Buffer, BufferSize, RecivedBytesRead);
 	}
 
 	void FProtocolFactory::CallProtocolDeserializeWithoutCheck(FSNetBufferHead & InHead, uint8 * Buffer, int32 BufferSize, int32 & RecivedBytesRead)
 	{
-		ProtocolDeserializeDelegates[InHead.uid](InHead, Buffer, BufferSize, RecivedBytesRead);
+		CallProtocolDeserialize(InHead, Buffer, BufferSize, RecivedBytesRead);
 	}
 
 	bool FProtocolFactory::IsProtocolRegister(int32 InUid)
 	{
-		auto itr = ProtocolDeserializeDelegates.find(InUid);
-		return itr != ProtocolDeserializeDelegates.end();
+		if (InUid < 0 || InUid >= SERVO_PROTOCOL_UID_NUM)
+			return false;
+
+		const FDispatchEntry* _table = LocalTable.load(std::memory_order_acquire);
+		if (_table)
+		{
+			return _table[InUid].Func != &InvokeMissing;
+		}
+		FDispatchEntry _entry;
+		return FindEntry(InUid, _entry);
+	}
+
+	bool FProtocolFactory::RouteProtocol(int32 InUid, FProtocolTaskThread * InThread)
+	{
+		return RouteProtocolRange(InUid, InUid, &InThread, 1);
+	}
+
+	bool FProtocolFactory::RouteProtocol(int32 InUid, FDeserializeFunc InFunc, void * InContext)
+	{
+		if (InUid < 0 || InUid >= SERVO_PROTOCOL_UID_NUM || nullptr == InFunc)
+			return false;
+
+		std::lock_guard<std::mutex> _scopelock(RegisterLock);
+		if (IsFrozen())
+			return RejectFrozen(InUid);
+
+		FDispatchEntry _entry = { InFunc, InContext };
+		auto itr = ProtocolRoutes.insert(std::pair<int32, FDispatchEntry>(InUid, _entry));
+		return itr.second;
+	}
+
+	bool FProtocolFactory::RouteProtocolRange(int32 InFirst, int32 InLast, FProtocolTaskThread * InThread)
+	{
+		return RouteProtocolRange(InFirst, InLast, &InThread, 1);
+	}
+
+	bool FProtocolFactory::RouteProtocolRange(int32 InFirst, int32 InLast, FProtocolTaskThread * const * InThreads, int32 InNum)
+	{
+		if (InFirst < 0 || InLast >= SERVO_PROTOCOL_UID_NUM || InFirst > InLast || nullptr == InThreads || InNum <= 0)
+			return false;
+		for (int32 i = 0; i < InNum; ++i)
+		{
+			if (nullptr == InThreads[i])
+				return false;
+		}
+
+		std::lock_guard<std::mutex> _scopelock(RegisterLock);
+		if (IsFrozen())
+			return RejectFrozen(InFirst);
+		// all or nothing
+		auto itr = ProtocolRoutes.lower_bound(InFirst);
+		if (itr != ProtocolRoutes.end() && itr->first <= InLast)
+			return false;
+
+		for (int32 uid = InFirst; uid <= InLast; ++uid)
+		{
+			FDispatchEntry _entry = { &FProtocolTaskThread::InvokePost, InThreads[uid % InNum] };
+			ProtocolRoutes.insert(std::pair<int32, FDispatchEntry>(uid, _entry));
+		}
+		return true;
+	}
+
+	bool FProtocolFactory::IsProtocolRouted(int32 InUid)
+	{
+		std::lock_guard<std::mutex> _scopelock(RegisterLock);
+		return ProtocolRoutes.count(InUid) > 0;
 	}
 
 	FProtocolFactory* FProtocolFactory::pSingleton = nullptr;
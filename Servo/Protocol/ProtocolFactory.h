@@ -4,17 +4,31 @@
 
 #include <Core/Public/marco.h>
 #include "ServoStaticProtocol.hpp"
+#include "NetBodyView.hpp"
 
 // STL
 #include<map>
 #include<functional>
+#include<atomic>
+#include<memory>
+#include<mutex>
+
+/// uid is a uint16: the frozen dispatch table has one entry per uid
+#define SERVO_PROTOCOL_UID_NUM 65536
 
 namespace Septem
 {
+	class FProtocolTaskThread;
+
 	/**
 	* Protocol Factory
 	* feature 1. register Template Static Protocol for TClass packet pools
 	* feature 2. Produce packet of Template Static Protocols, set into their pools
+	* feature 3. Freeze after startup: dispatch by a flat table indexed with uid,
+	*	one load and one indirect call, no lock; registering after Freeze fails and is reported
+	*	until Freeze, every frame looks its uid up under the lock
+	* feature 4. Route uids to FProtocolTaskThread workers: the receiving thread queues the frame,
+	*	the worker deserializes it
 	 */
 	class FProtocolFactory
 	{
@@ -40,33 +54,137 @@ namespace Septem
 		// lamda deserialize packet
 		//------------------------------------------------------------------------------------------------------------
 	public:
-		bool RegisterProtocolDeserialize(int32 InUid, std::function< void(FSNetBufferHead&, uint8*, int32, int32&)>&& InLambda);
+		typedef std::function< void(FSNetBufferHead&, uint8*, int32, int32&)> FDeserializeDelegate;
+		// plain function + context, called without std::function
+		typedef void(*FDeserializeFunc)(void* InContext, FSNetBufferHead& InHead, uint8* Buffer, int32 BufferSize, int32& RecivedBytesRead);
+
+		struct FDispatchEntry
+		{
+			FDeserializeFunc Func;
+			void* Context;
+		};
+
+		bool RegisterProtocolDeserialize(int32 InUid, FDeserializeDelegate&& InLambda);
+		bool RegisterProtocolDeserialize(int32 InUid, FDeserializeFunc InFunc, void* InContext = nullptr);
+		// member function of InObject, e.g. TServoProtocol<T, Mode>::OnReceivedPacket of its singleton
+		template<typename TClass, void (TClass::*Method)(FSNetBufferHead&, uint8*, int32, int32&)>
+		bool RegisterProtocolMethod(int32 InUid, TClass* InObject)
+		{
+			return RegisterProtocolDeserialize(InUid, &InvokeMethod<TClass, Method>, InObject);
+		}
+		/**
+		* read only member function on the receive buffer: the body as TSNetBodyView<T>, no packet, no copy
+		* a body misaligned for T is copied once to the stack
+		* frames whose size is not sizeof(T) or whose fastcode fails are dropped before InObject sees them
+		*/
+		template<typename T, typename TClass, void (TClass::*Method)(FSNetBufferHead&, const TSNetBodyView<T>&)>
+		bool RegisterProtocolView(int32 InUid, TClass* InObject)
+		{
+			return RegisterProtocolDeserialize(InUid, &InvokeView<T, TClass, Method>, InObject);
+		}
+
 		void CallProtocolDeserialize(FSNetBufferHead& InHead, uint8* Buffer, int32 BufferSize, int32&RecivedBytesRead);
 		void CallProtocolDeserializeWithoutCheck(FSNetBufferHead& InHead, uint8* Buffer, int32 BufferSize, int32&RecivedBytesRead);
 		bool IsProtocolRegister(int32 InUid);
+
+		//------------------------------------------------------------------------------------------------------------
+		// routing deserialize to workers
+		//------------------------------------------------------------------------------------------------------------
+	public:
+		/**
+		* bind InUid to InThread, CallProtocolDeserialize then queues the frame and returns
+		* the registered deserialize runs on the worker, see FProtocolTaskThread
+		* before Freeze only, one route per uid
+		*/
+		bool RouteProtocol(int32 InUid, FProtocolTaskThread* InThread);
+		// InFunc runs on the receiving thread instead of the registered deserialize
+		bool RouteProtocol(int32 InUid, FDeserializeFunc InFunc, void* InContext);
+		// every uid in [InFirst, InLast] to one worker, nothing is bound if one of them has a route
+		bool RouteProtocolRange(int32 InFirst, int32 InLast, FProtocolTaskThread* InThread);
+		// [InFirst, InLast] over InNum workers by uid % InNum: one uid stays on one worker, in order
+		bool RouteProtocolRange(int32 InFirst, int32 InLast, FProtocolTaskThread* const* InThreads, int32 InNum);
+		bool IsProtocolRouted(int32 InUid);
+
+		// the registered deserialize of InHead.uid, routes are skipped: what the workers call
+		void CallLocalDeserialize(FSNetBufferHead& InHead, uint8* Buffer, int32 BufferSize, int32&RecivedBytesRead);
+
+		/**
+		* build the dense table from everything registered so far, call once after startup
+		* the table never changes afterwards, readers need no lock
+		* nothing freezes on its own: until then CallProtocolDeserialize / CallLocalDeserialize lock per frame
+		* @return false if already frozen
+		*/
+		bool Freeze();
+		bool IsFrozen() const { return DispatchTable.load(std::memory_order_acquire) != nullptr; }
+
 	protected:
-		std::map < int32, std::function< void(FSNetBufferHead&, uint8*, int32, int32&)> > ProtocolDeserializeDelegates;
+		template<typename TClass, void (TClass::*Method)(FSNetBufferHead&, uint8*, int32, int32&)>
+		static void InvokeMethod(void* InContext, FSNetBufferHead& InHead, uint8* Buffer, int32 BufferSize, int32& RecivedBytesRead)
+		{
+			(static_cast<TClass*>(InContext)->*Method)(InHead, Buffer, BufferSize, RecivedBytesRead);
+		}
+		template<typename T, typename TClass, void (TClass::*Method)(FSNetBufferHead&, const TSNetBodyView<T>&)>
+		static void InvokeView(void* InContext, FSNetBufferHead& InHead, uint8* Buffer, int32 BufferSize, int32& RecivedBytesRead)
+		{
+			const int32 _size = TSNetBodyView<T>::MemSize();
+			const int32 _frame = _size + FSNetBufferFoot::MemSize();
+			RecivedBytesRead = _frame < BufferSize ? _frame : BufferSize;
+			if (InHead.size != _size || BufferSize < _frame)
+				return;
+
+			TSNetBodyView<T> _view;
+			T _aligned;
+			if (!_view.Bind(Buffer, BufferSize))
+			{
+				memcpy(&_aligned, Buffer, _size);
+				_view = TSNetBodyView<T>(_aligned);
+			}
+
+			FSNetBufferFoot _foot;
+			_foot.MemRead(Buffer + _size, BufferSize - _size);
+			if ((InHead.XOR() ^ _view.XOR() ^ _foot.XOR()) != 0)
+				return;
+
+			(static_cast<TClass*>(InContext)->*Method)(InHead, _view);
+		}
+		static void InvokeDelegate(void* InContext, FSNetBufferHead& InHead, uint8* Buffer, int32 BufferSize, int32& RecivedBytesRead);
+		// every uid nobody registered
+		static void InvokeMissing(void* InContext, FSNetBufferHead& InHead, uint8* Buffer, int32 BufferSize, int32& RecivedBytesRead);
+
+		// reports a registration after Freeze; @return false
+		static bool RejectFrozen(int32 InUid);
+		// before Freeze; routes count if bRouted
+		bool FindEntry(int32 InUid, FDispatchEntry& OutEntry, bool bRouted = false);
+
+		// registration only inserts, entries keep their address
+		std::map < int32, FDeserializeDelegate > ProtocolDeserializeDelegates;
+		std::map < int32, FDispatchEntry > ProtocolDeserializeFuncs;
+		std::map < int32, FDispatchEntry > ProtocolRoutes;
+		std::mutex RegisterLock;
+
+		// SERVO_PROTOCOL_UID_NUM entries once frozen, read only
+		// DispatchStorage: the registered deserialize, RouteStorage: the same with routes on top, only if any
+		std::unique_ptr<FDispatchEntry[]> DispatchStorage;
+		std::unique_ptr<FDispatchEntry[]> RouteStorage;
+		std::atomic<const FDispatchEntry*> DispatchTable;
+		std::atomic<const FDispatchEntry*> LocalTable;
 	};
 }
 
+/*
+* runtime registration of TServoProtocol<TYPE, Mode>::OnReceivedPacket on its singleton
+* uid sets known at compile time: TProtocolSet in ProtocolSet.hpp
+*/
 #ifndef __REG_PROTOCOL_NETBODY_THREADSAFE_STACK
 #define __REG_PROTOCOL_NETBODY_THREADSAFE_STACK(UID, TYPE)\
-Septem::FProtocolFactory::Get()->RegisterProtocolDeserialize(UID, \
-	, std::bind(&TServoProtocol < TYPE, SPPMode::Stack>::OnReceivedPacket\
-	, std::placeholders::_1\
-	, std::placeholders::_2\
-	, std::placeholders::_3\
-	, std::placeholders::_4\
-);
-#endif
+Septem::FProtocolFactory::Get()->RegisterProtocolMethod< Septem::TServoProtocol< TYPE, SPPMode::Stack >\
+	, &Septem::TServoProtocol< TYPE, SPPMode::Stack >::OnReceivedPacket >\
+	(UID, Septem::TServoProtocol< TYPE, SPPMode::Stack >::Get());
+#endif // !__REG_PROTOCOL_NETBODY_THREADSAFE_STACK
 
 #ifndef __REG_PROTOCOL_NETBODY_THREADSAFE_QUEUE
 #define __REG_PROTOCOL_NETBODY_THREADSAFE_QUEUE(UID, TYPE)\
-Septem::FProtocolFactory::Get()->RegisterProtocolDeserialize(UID, \
-	, std::bind(&TServoProtocol < TYPE, SPPMode::Queue>::OnReceivedPacket\
-	, std::placeholders::_1\
-	, std::placeholders::_2\
-	, std::placeholders::_3\
-	, std::placeholders::_4\
-);
+Septem::FProtocolFactory::Get()->RegisterProtocolMethod< Septem::TServoProtocol< TYPE, SPPMode::Queue >\
+	, &Septem::TServoProtocol< TYPE, SPPMode::Queue >::OnReceivedPacket >\
+	(UID, Septem::TServoProtocol< TYPE, SPPMode::Queue >::Get());
 #endif // !__REG_PROTOCOL_NETBODY_THREADSAFE_QUEUE
@@ -0,0 +1,223 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#pragma once
+
+#include <Core/Public/marco.h>
+#include "ProtocolFactory.h"
+#include "ServoStreamDecoder.h"
+
+#include <type_traits>
+
+/// widest uid range [min, max] of a TProtocolSet dispatched by a jump table, wider sets compare uids
+#ifndef SERVO_PROTOCOL_SET_TABLE_MAX
+#define SERVO_PROTOCOL_SET_TABLE_MAX 4096
+#endif // !SERVO_PROTOCOL_SET_TABLE_MAX
+
+namespace Septem
+{
+	typedef void(*FProtocolSetFunc)(FSNetBufferHead& InHead, uint8* Buffer, int32 BufferSize, int32& ReceivedBytesRead);
+
+	/**
+	* one entry of a TProtocolSet: frames with uid UID carry a T body
+	* the decode path is TServoProtocol<T, PoolMode>::OnReceivedPacket, called directly
+	*/
+	template<uint16 UID, typename T, SPPMode PoolMode = SPPMode::Fast>
+	struct TProtocolUid
+	{
+		static_assert(UID != 0, "uid 0 is the heartbeat");
+		static_assert(std::is_base_of<FStaticNetBodyBase, T>::value, "T must inherit from FStaticNetBodyBase");
+
+		typedef T Type;
+		typedef TServoProtocol<T, PoolMode> Protocol;
+		static constexpr uint16 Value = UID;
+
+		static void Deserialize(FSNetBufferHead& InHead, uint8* Buffer, int32 BufferSize, int32& ReceivedBytesRead)
+		{
+			Protocol::GetRef().OnReceivedPacket(InHead, Buffer, BufferSize, ReceivedBytesRead);
+		}
+
+		// FProtocolFactory::FDeserializeFunc shape
+		static void DeserializeWithContext(void*, FSNetBufferHead& InHead, uint8* Buffer, int32 BufferSize, int32& ReceivedBytesRead)
+		{
+			Deserialize(InHead, Buffer, BufferSize, ReceivedBytesRead);
+		}
+	};
+
+	template<int32 N>
+	struct TProtocolJumpTable
+	{
+		FProtocolSetFunc Funcs[N];
+	};
+
+	/**
+	* Protocol Set
+	* every body type of a service known at compile time:
+	*	typedef TProtocolSet< TProtocolUid<1, FFoo>, TProtocolUid<2, FBar> > FMyProtocols;
+	*	FMyProtocols::Dispatch(head, payload, size, read);
+	* uids within SERVO_PROTOCOL_SET_TABLE_MAX of each other: a constexpr jump table indexed by uid - min
+	* sparse uids: an inlined chain of uid compares
+	* duplicate uids fail to compile
+	*/
+	template<typename... TEntries>
+	class TProtocolSet
+	{
+	public:
+		static constexpr int32 Num = (int32)sizeof...(TEntries);
+		static_assert(Num > 0, "empty protocol set");
+
+	private:
+		static constexpr uint16 MinOf()
+		{
+			const uint16 _uids[] = { TEntries::Value... };
+			uint16 _min = _uids[0];
+			for (int32 i = 1; i < Num; ++i)
+			{
+				_min = _uids[i] < _min ? _uids[i] : _min;
+			}
+			return _min;
+		}
+
+		static constexpr uint16 MaxOf()
+		{
+			const uint16 _uids[] = { TEntries::Value... };
+			uint16 _max = _uids[0];
+			for (int32 i = 1; i < Num; ++i)
+			{
+				_max = _uids[i] > _max ? _uids[i] : _max;
+			}
+			return _max;
+		}
+
+		static constexpr bool IsUnique()
+		{
+			const uint16 _uids[] = { TEntries::Value... };
+			for (int32 i = 0; i < Num; ++i)
+			{
+				for (int32 j = i + 1; j < Num; ++j)
+				{
+					if (_uids[i] == _uids[j])
+					{
+						return false;
+					}
+				}
+			}
+			return true;
+		}
+
+	public:
+		static_assert(IsUnique(), "a uid is listed twice in TProtocolSet");
+
+		static constexpr uint16 MinUid = MinOf();
+		static constexpr uint16 MaxUid = MaxOf();
+		static constexpr int32 Range = (int32)MaxUid - (int32)MinUid + 1;
+		static constexpr bool bJumpTable = Range <= SERVO_PROTOCOL_SET_TABLE_MAX;
+
+	private:
+		static constexpr int32 TableSize = bJumpTable ? Range : 1;
+
+		static constexpr TProtocolJumpTable<TableSize> MakeTable()
+		{
+			TProtocolJumpTable<TableSize> _table = {};
+			if (bJumpTable)
+			{
+				const uint16 _uids[] = { TEntries::Value... };
+				const FProtocolSetFunc _funcs[] = { &TEntries::Deserialize... };
+				for (int32 i = 0; i < Num; ++i)
+				{
+					_table.Funcs[_uids[i] - MinUid] = _funcs[i];
+				}
+			}
+			return _table;
+		}
+
+		static constexpr TProtocolJumpTable<TableSize> Table = MakeTable();
+
+		template<typename TEntry>
+		static bool DispatchOne(FSNetBufferHead& InHead, uint8* Buffer, int32 BufferSize, int32& ReceivedBytesRead)
+		{
+			if (InHead.uid != TEntry::Value)
+			{
+				return false;
+			}
+			TEntry::Deserialize(InHead, Buffer, BufferSize, ReceivedBytesRead);
+			return true;
+		}
+
+		static bool DispatchCompare(FSNetBufferHead& InHead, uint8* Buffer, int32 BufferSize, int32& ReceivedBytesRead)
+		{
+			bool _done = false;
+			// stops at the first match
+			const bool _expand[] = { (_done = _done || DispatchOne<TEntries>(InHead, Buffer, BufferSize, ReceivedBytesRead))... };
+			(void)_expand;
+			return _done;
+		}
+
+	public:
+		/**
+		* decode the frame with the body type of its uid
+		* @return false if the uid is not in the set, nothing was called
+		*/
+		static bool Dispatch(FSNetBufferHead& InHead, uint8* Buffer, int32 BufferSize, int32& ReceivedBytesRead)
+		{
+			if (!bJumpTable)
+			{
+				return DispatchCompare(InHead, Buffer, BufferSize, ReceivedBytesRead);
+			}
+			const uint32 _index = (uint32)((int32)InHead.uid - (int32)MinUid);
+			if (_index >= (uint32)TableSize || nullptr == Table.Funcs[_index])
+			{
+				return false;
+			}
+			Table.Funcs[_index](InHead, Buffer, BufferSize, ReceivedBytesRead);
+			return true;
+		}
+
+		static bool Contains(uint16 InUid)
+		{
+			const uint16 _uids[] = { TEntries::Value... };
+			for (int32 i = 0; i < Num; ++i)
+			{
+				if (_uids[i] == InUid)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		// the same entries in FProtocolFactory for code that dispatches at runtime
+		static bool Register(FProtocolFactory& InFactory)
+		{
+			bool _ok = true;
+			const bool _expand[] = { (_ok = InFactory.RegisterProtocolDeserialize(TEntries::Value, &TEntries::DeserializeWithContext, nullptr) && _ok)... };
+			(void)_expand;
+			return _ok;
+		}
+	};
+
+	template<typename... TEntries>
+	constexpr TProtocolJumpTable<TProtocolSet<TEntries...>::TableSize> TProtocolSet<TEntries...>::Table;
+
+	/**
+	* stream decoder for a fixed protocol set
+	* set uids are decoded by TSet::Dispatch, heartbeats and other uids take the FServoStreamDecoder path
+	*/
+	template<typename TSet>
+	class TServoStreamDecoder : public FServoStreamDecoder
+	{
+	public:
+		TServoStreamDecoder(int32 InSyncword = DEFAULT_SYNCWORD_INT32, int32 InMaxBodySize = SERVO_STREAM_MAX_BODY)
+			:FServoStreamDecoder(InSyncword, InMaxBodySize)
+		{}
+
+	protected:
+		virtual void OnFrame(FSNetBufferHead& InHead, uint8* InPayload, int32 InPayloadSize) override
+		{
+			int32 _bytesRead = 0;
+			if (!TSet::Dispatch(InHead, InPayload, InPayloadSize, _bytesRead))
+			{
+				FServoStreamDecoder::OnFrame(InHead, InPayload, InPayloadSize);
+			}
+		}
+	};
+}
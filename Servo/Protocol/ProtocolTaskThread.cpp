@@ -0,0 +1,146 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#include "ProtocolTaskThread.h"
+
+#include <string.h>
+
+#ifdef LINUX
+#include <sched.h>
+#endif // LINUX
+
+namespace Septem
+{
+	FProtocolTaskThread::FProtocolTaskThread(int32 InCpu, FProtocolFactory * InFactory)
+		:TTaskThread<FProtocolTask>()
+		, Factory(InFactory ? InFactory : FProtocolFactory::Get())
+		, Cpu(InCpu)
+		, DoneNum(0)
+		, Queued(0)
+	{
+	}
+
+	FProtocolTaskThread::~FProtocolTaskThread()
+	{
+		Stop();
+	}
+
+	void FProtocolTaskThread::Start()
+	{
+		if (m_Thread != 0)
+		{
+			return;
+		}
+		// accept frames before the thread reaches Run
+		Queued = 0;
+		bRunning = true;
+		CreateThread();
+	}
+
+	void FProtocolTaskThread::Stop()
+	{
+		bRunning = false;
+		if (m_Thread != 0)
+		{
+			Wake();
+			JoinThread();
+			m_Thread = 0;
+		}
+
+		std::shared_ptr<FProtocolTask> _task;
+		while (PopTask(_task))
+		{
+			Dealloc(_task);
+		}
+		Queued = 0;
+	}
+
+	void FProtocolTaskThread::Wake()
+	{
+		// under the lock: the worker is either before its check or inside wait
+		{
+			std::lock_guard<std::mutex> scopelock(WakeLock);
+		}
+		WakeCond.notify_one();
+	}
+
+	void FProtocolTaskThread::Run()
+	{
+		std::shared_ptr<FProtocolTask> _task;
+		while (bRunning)
+		{
+			if (PopTask(_task))
+			{
+				Queued.fetch_sub(1, std::memory_order_relaxed);
+				if (_task)
+				{
+					OnDoTask(_task);
+				}
+				continue;
+			}
+
+			std::unique_lock<std::mutex> scopelock(WakeLock);
+			WakeCond.wait(scopelock, [this]() { return Queued.load() > 0 || !bRunning; });
+		}
+	}
+
+	void FProtocolTaskThread::Init()
+	{
+#ifdef LINUX
+		if (Cpu >= 0)
+		{
+			cpu_set_t _cpus;
+			CPU_ZERO(&_cpus);
+			CPU_SET(Cpu, &_cpus);
+			if (pthread_setaffinity_np(pthread_self(), sizeof(_cpus), &_cpus) != 0)
+			{
+				printf("FProtocolTaskThread: cannot pin worker to cpu %d\n", Cpu);
+			}
+		}
+#endif // LINUX
+	}
+
+	bool FProtocolTaskThread::Post(FSNetBufferHead & InHead, uint8 * Buffer, int32 BufferSize, int32 & ReceivedBytesRead)
+	{
+		// body + foot, the deserialize on the worker checks what is missing
+		int32 _size = InHead.size + FSNetBufferFoot::MemSize();
+		_size = _size < BufferSize ? _size : BufferSize;
+		_size = _size > 0 ? _size : 0;
+		ReceivedBytesRead = _size;
+
+		if (!bRunning)
+		{
+			return false;
+		}
+
+		std::shared_ptr<FProtocolTask> _task = Alloc();
+		_task->Head = InHead;
+		// the recycled task keeps its capacity, no allocation once warm
+		_task->Payload.resize((SIZE_T)_size);
+		if (_size > 0)
+		{
+			memcpy(_task->Payload.data(), Buffer, (SIZE_T)_size);
+		}
+		PushTask(std::move(_task));
+		// the worker only sleeps on an empty queue
+		if (Queued.fetch_add(1) == 0)
+		{
+			Wake();
+		}
+		return true;
+	}
+
+	void FProtocolTaskThread::InvokePost(void * InContext, FSNetBufferHead & InHead, uint8 * Buffer, int32 BufferSize, int32 & ReceivedBytesRead)
+	{
+		static_cast<FProtocolTaskThread*>(InContext)->Post(InHead, Buffer, BufferSize, ReceivedBytesRead);
+	}
+
+	void FProtocolTaskThread::OnDoTask(std::shared_ptr<FProtocolTask>& InTaskPtr)
+	{
+		int32 _bytesRead = 0;
+		Factory->CallLocalDeserialize(InTaskPtr->Head, InTaskPtr->Payload.data(), (int32)InTaskPtr->Payload.size(), _bytesRead);
+		DoneNum.fetch_add(1, std::memory_order_relaxed);
+
+		Dealloc(InTaskPtr);
+		InTaskPtr.reset();
+	}
+}
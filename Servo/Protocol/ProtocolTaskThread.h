@@ -0,0 +1,75 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#pragma once
+
+#include <Core/Public/marco.h>
+#include <Core/Thread/SeptemThread.hpp>
+#include "ProtocolFactory.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+namespace Septem
+{
+	// one routed frame: its head and a copy of body + foot
+	struct FProtocolTask
+	{
+		FSNetBufferHead Head;
+		std::vector<uint8> Payload;
+	};
+
+	/**
+	* Protocol Task Thread
+	* worker for the uids bound to it with FProtocolFactory::RouteProtocol
+	*	the receiving thread only copies the frame into a recycled task and pushes it
+	*	the worker runs the registered deserialize of the uid, packets reach their pools from here
+	*	InCpu >= 0 pins the worker to that core (linux): hot uids get a core each, cold uids share a worker
+	* an idle worker sleeps on a condition variable, only the Post that finds the queue empty wakes it
+	* Start before the first frame arrives, frames posted while stopped are dropped
+	*/
+	class FProtocolTaskThread : public TTaskThread<FProtocolTask>
+	{
+	public:
+		FProtocolTaskThread(int32 InCpu = -1, FProtocolFactory* InFactory = nullptr);
+		virtual ~FProtocolTaskThread();
+
+		void Start();
+		// stop and join, queued frames are dropped
+		void Stop();
+		bool IsRunning() const { return bRunning; }
+
+		/**
+		* queue a copy of the frame, called on the receiving thread
+		* @return false if the worker is stopped, the frame is consumed either way
+		*/
+		bool Post(FSNetBufferHead& InHead, uint8* Buffer, int32 BufferSize, int32& ReceivedBytesRead);
+		// FProtocolFactory::FDeserializeFunc shape, InContext is the worker
+		static void InvokePost(void* InContext, FSNetBufferHead& InHead, uint8* Buffer, int32 BufferSize, int32& ReceivedBytesRead);
+
+		int32 GetCpu() const { return Cpu; }
+		// frames deserialized on this worker
+		uint64 GetDoneNum() const { return DoneNum.load(std::memory_order_relaxed); }
+
+	protected:
+		virtual void Init() override;
+		// TTaskThread::Run with a blocking wait instead of the spin
+		virtual void Run() override;
+		virtual void OnDoTask(std::shared_ptr<FProtocolTask>& InTaskPtr) override;
+		void Wake();
+
+		FProtocolFactory* Factory;
+		int32 Cpu;
+		std::atomic<uint64> DoneNum;
+
+		// tasks pushed and not popped yet, the worker sleeps at 0
+		std::atomic<int32> Queued;
+		std::mutex WakeLock;
+		std::condition_variable WakeCond;
+
+	private:
+		FProtocolTaskThread(const FProtocolTaskThread&);
+		FProtocolTaskThread& operator=(const FProtocolTaskThread&);
+	};
+}
@@ -0,0 +1,353 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#include "ServoClient.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <errno.h>
+#include <poll.h>
+#endif
+
+namespace Septem
+{
+	// 1: readable, 0: timeout, -1: error
+	static int32 WaitReadable(sockets::socket_t InSocket, int32 InTimeoutMs)
+	{
+#ifdef _WIN32
+		WSAPOLLFD _fd = { InSocket, POLLRDNORM, 0 };
+		const int _ret = ::WSAPoll(&_fd, 1, InTimeoutMs);
+#else
+		struct pollfd _fd = { InSocket, POLLIN, 0 };
+		int _ret = 0;
+		do
+		{
+			_ret = ::poll(&_fd, 1, InTimeoutMs);
+		} while (_ret < 0 && errno == EINTR);
+#endif
+		return _ret > 0 ? 1 : _ret;
+	}
+
+	FServoClient::FServoClient(sockets::CConnectionPool & InPool, const sockets::CAddressIPv4 & InDest, int32 InSyncword)
+		:FServoStreamDecoder(InSyncword)
+		, Pool(InPool)
+		, Dest(InDest)
+		, bValid(false)
+		, bStop(false)
+		, bTainted(false)
+		, SessionCursor(0)
+	{
+	}
+
+	FServoClient::~FServoClient()
+	{
+		Close();
+	}
+
+	bool FServoClient::Open()
+	{
+		Close();
+
+		Socket = Pool.acquire(Dest);
+		if (!Socket)
+		{
+			return false;
+		}
+		Reset();
+		bStop = false;
+		bTainted = false;
+		bValid = true;
+		Reader = std::thread([this]() { Run(); });
+		return true;
+	}
+
+	void FServoClient::Close()
+	{
+		bStop = true;
+		if (Reader.joinable())
+		{
+			Reader.join();
+		}
+
+		// under SendLock: a Send either wrote before, and its answer is outstanding, or sees !bValid
+		std::unique_ptr<sockets::CSocketTCP> _socket;
+		bool _reuse = false;
+		{
+			std::lock_guard<std::mutex> scopelock(SendLock);
+			// a connection is reusable only between two answers, and with no answer left in flight
+			_reuse = bValid && !bTainted && Outstanding() == 0 && PendingBytes() == 0;
+			bValid = false;
+			_socket.swap(Socket);
+		}
+		Fail();
+
+		if (_socket)
+		{
+			if (_reuse)
+			{
+				Pool.release(std::move(_socket));
+			}
+			_socket.reset();
+		}
+	}
+
+	int32 FServoClient::NextSessionID()
+	{
+		if ((int32)Pending.size() >= SERVO_SESSION_ID_MASK)
+		{
+			return 0;
+		}
+		// 0 is left for requests that do not expect an answer
+		do
+		{
+			SessionCursor = SessionCursor % SERVO_SESSION_ID_MASK + 1;
+		} while (Pending.count(SessionCursor) > 0);
+		return SessionCursor;
+	}
+
+	bool FServoClient::SendPacket(sockets::CSocketTCP & InSocket, const std::shared_ptr<FSNetPacket>& InPacket)
+	{
+		sockets::iovec_t _iov[SERVO_PACKET_IOVEC_NUM];
+		const int32 _num = InPacket->WriteToIOVec(_iov);
+		if (_num <= 0)
+		{
+			return false;
+		}
+		size_t _bytes = 0;
+		for (int32 i = 0; i < _num; ++i)
+		{
+			_bytes += _iov[i].iov_len;
+		}
+		return InSocket.sendv(_iov, (size_t)_num) == _bytes;
+	}
+
+	int32 FServoClient::Send(const std::shared_ptr<FSNetPacket>& InRequest, FResponse InCallback)
+	{
+		if (!bValid || !InRequest)
+		{
+			return 0;
+		}
+
+		int32 _sid = 0;
+		{
+			std::lock_guard<std::mutex> scopelock(PendingLock);
+			_sid = NextSessionID();
+			if (0 == _sid)
+			{
+				return 0;
+			}
+			Pending[_sid] = std::move(InCallback);
+		}
+
+		InRequest->Head.reserved = (InRequest->Head.reserved & ~(uint32)SERVO_SESSION_ID_MASK) | (uint32)_sid;
+		InRequest->OnSeal();
+
+		bool _sent = false;
+		{
+			std::lock_guard<std::mutex> scopelock(SendLock);
+			_sent = bValid && SendPacket(*Socket, InRequest);
+		}
+		if (!_sent)
+		{
+			// part of the frame may be out
+			bTainted = true;
+			std::lock_guard<std::mutex> scopelock(PendingLock);
+			// still ours: never reported, otherwise Fail already answered it with nullptr
+			if (Pending.erase(_sid) > 0)
+			{
+				return 0;
+			}
+		}
+		return _sid;
+	}
+
+	std::shared_ptr<FSNetPacket> FServoClient::Request(const std::shared_ptr<FSNetPacket>& InRequest, int32 InTimeoutMs)
+	{
+		struct FWait
+		{
+			std::mutex Lock;
+			std::condition_variable Done;
+			bool bDone = false;
+			std::shared_ptr<FSNetPacket> Response;
+		};
+		std::shared_ptr<FWait> _wait = std::make_shared<FWait>();
+
+		const int32 _sid = Send(InRequest, [_wait](const std::shared_ptr<FSNetPacket>& InResponse)
+		{
+			std::lock_guard<std::mutex> scopelock(_wait->Lock);
+			_wait->Response = InResponse;
+			_wait->bDone = true;
+			_wait->Done.notify_one();
+		});
+		if (0 == _sid)
+		{
+			return nullptr;
+		}
+
+		std::unique_lock<std::mutex> scopelock(_wait->Lock);
+		if (!_wait->Done.wait_for(scopelock, std::chrono::milliseconds(InTimeoutMs), [&_wait]() { return _wait->bDone; }))
+		{
+			scopelock.unlock();
+			Cancel(_sid);
+			return nullptr;
+		}
+		return _wait->Response;
+	}
+
+	bool FServoClient::Heartbeat(int32 InTimeoutMs)
+	{
+		FServoProtocol* _protocol = FServoProtocol::Get();
+		std::shared_ptr<FSNetPacket> _heartbeat = _protocol->AllocHeartbeat();
+		std::shared_ptr<FSNetPacket> _response = Request(_heartbeat, InTimeoutMs);
+		const bool _alive = _response && _response->Head.uid == 0;
+		// Send wrote the request before returning, the late answer of a timeout is dropped
+		_protocol->DeallockNetPacket(_heartbeat);
+		_protocol->DeallockNetPacket(_response);
+		return _alive;
+	}
+
+	bool FServoClient::Cancel(int32 InSessionID)
+	{
+		std::lock_guard<std::mutex> scopelock(PendingLock);
+		if (Pending.erase(InSessionID) == 0)
+		{
+			return false;
+		}
+		bTainted = true;
+		return true;
+	}
+
+	int32 FServoClient::Outstanding()
+	{
+		std::lock_guard<std::mutex> scopelock(PendingLock);
+		return (int32)Pending.size();
+	}
+
+	void FServoClient::Fail()
+	{
+		std::unordered_map<int32, FResponse> _pending;
+		{
+			std::lock_guard<std::mutex> scopelock(PendingLock);
+			_pending.swap(Pending);
+		}
+		for (auto& _itr : _pending)
+		{
+			if (_itr.second)
+			{
+				_itr.second(nullptr);
+			}
+		}
+	}
+
+	void FServoClient::Run()
+	{
+		const sockets::socket_t _handle = Socket->get_handle();
+		while (!bStop)
+		{
+			const int32 _ready = WaitReadable(_handle, SERVO_CLIENT_POLL_MS);
+			if (_ready == 0)
+			{
+				continue;
+			}
+
+			int32 _capacity = 0;
+			uint8* ptr = PrepareWrite(_capacity);
+			const size_t _bytes = _ready > 0 ? Socket->recv_some(ptr, (size_t)_capacity) : 0;
+			if (_bytes == 0)
+			{
+				// closed by the upstream
+				break;
+			}
+			CommitWrite((int32)_bytes);
+		}
+
+		if (!bStop)
+		{
+			// new sends fail fast, the outstanding ones learn it here
+			bValid = false;
+			Fail();
+		}
+	}
+
+	void FServoClient::OnFrame(FSNetBufferHead & InHead, uint8 * InPayload, int32 InPayloadSize)
+	{
+		FResponse _callback;
+		const int32 _sid = InHead.SessionID();
+		if (_sid != 0)
+		{
+			std::lock_guard<std::mutex> scopelock(PendingLock);
+			auto _itr = Pending.find(_sid);
+			if (_itr != Pending.end())
+			{
+				_callback = std::move(_itr->second);
+				Pending.erase(_itr);
+			}
+		}
+		if (!_callback)
+		{
+			FServoStreamDecoder::OnFrame(InHead, InPayload, InPayloadSize);
+			return;
+		}
+
+		int32 _bytesRead = 0;
+		FServoProtocol* _protocol = FServoProtocol::Get();
+		std::shared_ptr<FSNetPacket> _packet = _protocol->AllocNetPacket();
+		_packet->ReUse(InHead, InPayload, InPayloadSize, _bytesRead);
+		_callback(_packet);
+		// not kept by the callback: back to the pool
+		if (_packet.use_count() == 1)
+		{
+			_protocol->DeallockNetPacket(_packet);
+		}
+	}
+
+	sockets::CConnectionPool::check_t FServoClient::HeartbeatCheck(int32 InTimeoutMs)
+	{
+		return [InTimeoutMs](sockets::CSocketTCP& InSocket) -> bool
+		{
+			if (!sockets::CConnectionPool::alive(InSocket))
+			{
+				return false;
+			}
+			FServoProtocol* _protocol = FServoProtocol::Get();
+			std::shared_ptr<FSNetPacket> _heartbeat = _protocol->AllocHeartbeat();
+			_heartbeat->Head.reserved = 1;
+			_heartbeat->OnSeal();
+			const int32 _syncword = _heartbeat->Head.syncword;
+			const bool _sent = SendPacket(InSocket, _heartbeat);
+			_protocol->DeallockNetPacket(_heartbeat);
+			if (!_sent)
+			{
+				return false;
+			}
+
+			// the answer is a bare heartbeat: head + foot
+			uint8 _buffer[sizeof(FSNetBufferHead) + sizeof(FSNetBufferFoot)];
+			size_t _read = 0;
+			const auto _deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(InTimeoutMs);
+			while (_read < sizeof(_buffer))
+			{
+				const int32 _left = (int32)std::chrono::duration_cast<std::chrono::milliseconds>(
+					_deadline - std::chrono::steady_clock::now()).count();
+				if (_left <= 0 || WaitReadable(InSocket.get_handle(), _left) <= 0)
+				{
+					return false;
+				}
+				const size_t _bytes = InSocket.recv_some(_buffer + _read, sizeof(_buffer) - _read);
+				if (_bytes == 0)
+				{
+					return false;
+				}
+				_read += _bytes;
+			}
+
+			FSNetBufferHead _head;
+			_head.MemRead(_buffer, (int32)sizeof(_buffer));
+			return _head.syncword == _syncword && _head.uid == 0 && _head.SessionID() == 1;
+		};
+	}
+}
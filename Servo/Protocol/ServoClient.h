@@ -0,0 +1,106 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#pragma once
+
+#include <Core/Public/marco.h>
+#include "ServoStreamDecoder.h"
+
+#include <cppsockets/ConnectionPool.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+/// session ids live in the low 22 bits of FSNetBufferHead::reserved, see SessionID()
+#define SERVO_SESSION_ID_MASK ((1 << 22) - 1)
+
+/// reader poll interval, bounds how long Close waits for the reader thread
+#ifndef SERVO_CLIENT_POLL_MS
+#define SERVO_CLIENT_POLL_MS 50
+#endif // !SERVO_CLIENT_POLL_MS
+
+namespace Septem
+{
+	/**
+	* Servo Client
+	* many outstanding requests on one pooled connection to an upstream
+	*	Send stamps a free session id into the head, answers are matched by FSNetBufferHead::SessionID
+	*	one reader thread decodes the answers and runs the callbacks
+	*	frames nobody waits for take the FServoStreamDecoder path
+	*	a lost connection fails every outstanding request with nullptr
+	* the upstream answers with the session id of the request, and a heartbeat with a heartbeat
+	* more connections to one upstream: more clients on the same CConnectionPool
+	* Send / Request / Heartbeat from any thread, Open / Close from the owner only
+	*/
+	class FServoClient : protected FServoStreamDecoder
+	{
+	public:
+		typedef std::function<void(const std::shared_ptr<FSNetPacket>& InResponse)> FResponse;
+
+		FServoClient(sockets::CConnectionPool& InPool, const sockets::CAddressIPv4& InDest, int32 InSyncword = DEFAULT_SYNCWORD_INT32);
+		virtual ~FServoClient();
+
+		// takes a connection from the pool and starts the reader
+		bool Open();
+		// fails what is outstanding, an idle connection goes back to the pool unless it is tainted
+		void Close();
+		bool IsValid() const { return bValid.load(); }
+
+		/**
+		* pipelined send, thread safe
+		* the head of InRequest gets the session id and a new fastcode
+		* InCallback runs on the reader thread with the answer, or with nullptr when the connection is lost
+		* the answer goes back to the pool after InCallback unless InCallback kept a reference
+		* @return session id, 0 if nothing was sent and InCallback never runs
+		*/
+		int32 Send(const std::shared_ptr<FSNetPacket>& InRequest, FResponse InCallback);
+		// Send and wait, nullptr on timeout or a lost connection
+		std::shared_ptr<FSNetPacket> Request(const std::shared_ptr<FSNetPacket>& InRequest, int32 InTimeoutMs);
+		// AllocHeartbeat round trip behind the outstanding requests
+		bool Heartbeat(int32 InTimeoutMs);
+		/**
+		* forget a request, its answer is dropped; false if it was already answered
+		* the answer may still be on its way: the connection is tainted and Close does not pool it,
+		* the late answer would match a session id of the next client
+		*/
+		bool Cancel(int32 InSessionID);
+
+		int32 Outstanding();
+
+		/**
+		* health check for idle pooled connections: one AllocHeartbeat round trip on the socket
+		* CConnectionPool::set_health_check(FServoClient::HeartbeatCheck(100));
+		*/
+		static sockets::CConnectionPool::check_t HeartbeatCheck(int32 InTimeoutMs);
+
+	protected:
+		virtual void OnFrame(FSNetBufferHead& InHead, uint8* InPayload, int32 InPayloadSize) override;
+		void Run();
+		// every outstanding callback gets nullptr
+		void Fail();
+		// under PendingLock, 0 when every id is taken
+		int32 NextSessionID();
+		static bool SendPacket(sockets::CSocketTCP& InSocket, const std::shared_ptr<FSNetPacket>& InPacket);
+
+		sockets::CConnectionPool& Pool;
+		sockets::CAddressIPv4 Dest;
+		std::unique_ptr<sockets::CSocketTCP> Socket;
+		std::thread Reader;
+		std::atomic<bool> bValid;
+		std::atomic<bool> bStop;
+		// a request was given up on or half sent, the stream may still carry bytes for it
+		std::atomic<bool> bTainted;
+
+		std::mutex SendLock;
+		std::mutex PendingLock;
+		std::unordered_map<int32, FResponse> Pending;
+		int32 SessionCursor;
+
+	private:
+		FServoClient(const FServoClient&);
+		FServoClient& operator=(const FServoClient&);
+	};
+}
@@ -26,6 +26,9 @@
 #define SERVO_PROTOCOL_PACKET_POOL_MAX 1024
 #endif // !SERVO_PROTOCOL_PACKET_POOL_MAX
 
+/// slices of one packet in vectored output: head, body, foot
+#define SERVO_PACKET_IOVEC_NUM 3
+
 namespace Septem
 {
 
@@ -245,6 +248,34 @@ namespace Septem
 		void ReUse(uint8* Data, int32 BufferSize, int32& BytesRead, int32 InSyncword = DEFAULT_SYNCWORD_INT32);
 		void ReUse(FSNetBufferHead& InHead, uint8* Data, int32 BufferSize, int32& BytesRead);
 		void WriteToArray(std::vector<uint8>& InBufferArr);
+		/**
+		* vectored output without copying, the slices point into this packet
+		* heartbeat has no body slice
+		* IOVecType: struct iovec or anything with iov_base / iov_len
+		*
+		* @param OutVec room for SERVO_PACKET_IOVEC_NUM slices
+		* @return slices written, never 0 here; 0 from TSNetPacket<T> means nothing to send
+		*/
+		template<typename IOVecType>
+		int32 WriteToIOVec(IOVecType* OutVec)
+		{
+			int32 _num = 0;
+			OutVec[_num].iov_base = &Head;
+			OutVec[_num].iov_len = FSNetBufferHead::MemSize();
+			++_num;
+
+			if (Head.uid != 0 && Body.length > 0)
+			{
+				OutVec[_num].iov_base = Body.bufferPtr;
+				OutVec[_num].iov_len = Body.length;
+				++_num;
+			}
+
+			OutVec[_num].iov_base = &Foot;
+			OutVec[_num].iov_len = FSNetBufferFoot::MemSize();
+			++_num;
+			return _num;
+		}
 		void OnDealloc();
 		void OnAlloc();
 		void ReUseAsHeartbeat(int32 InSyncword = DEFAULT_SYNCWORD_INT32);
@@ -0,0 +1,547 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#include "ServoShmRing.h"
+
+#include <Core/Thread/SeptemLocks.hpp>
+#include <string.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif // __linux__
+
+// "SVRG"
+#define SERVO_SHM_RING_MAGIC 0x47525653u
+#define SERVO_SHM_RING_VERSION 1u
+
+namespace Septem
+{
+	static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2, "shared memory ring needs lock free atomics");
+
+	/**
+	* record in front of every frame
+	* State 0: free or still being written, 1: frame, 2: padding up to the end of the ring
+	* everything the consumer releases is zeroed, so a record nobody has committed reads 0
+	*/
+	struct FServoShmRecord
+	{
+		std::atomic<uint32> State;
+		uint32 Size;
+	};
+
+	enum : uint32
+	{
+		RecordFree = 0,
+		RecordFrame = 1,
+		RecordPadding = 2,
+	};
+
+	static inline uint64 RecordSize(uint64 InFrameSize)
+	{
+		return (sizeof(FServoShmRecord) + InFrameSize + 7ULL) & ~7ULL;
+	}
+
+	static inline uint64 DataOffset()
+	{
+		return (sizeof(FServoShmRingHeader) + 63ULL) & ~63ULL;
+	}
+
+#ifdef __linux__
+	static void FutexWait(std::atomic<uint32>* InWord, uint32 InValue, int32 InTimeoutMs)
+	{
+		struct timespec _timeout;
+		struct timespec* _ptr = nullptr;
+		if (InTimeoutMs >= 0)
+		{
+			_timeout.tv_sec = InTimeoutMs / 1000;
+			_timeout.tv_nsec = (long)(InTimeoutMs % 1000) * 1000000L;
+			_ptr = &_timeout;
+		}
+		// shared futex, the waker may live in another process
+		::syscall(SYS_futex, reinterpret_cast<uint32*>(InWord), FUTEX_WAIT, InValue, _ptr, nullptr, 0);
+	}
+
+	static void FutexWake(std::atomic<uint32>* InWord)
+	{
+		::syscall(SYS_futex, reinterpret_cast<uint32*>(InWord), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+	}
+#endif // __linux__
+
+	FServoShmRing::FServoShmRing()
+		:Header(nullptr)
+		, Data(nullptr)
+		, MapSize(0)
+		, Fd(-1)
+		, bOwner(false)
+		, PeekSize(0)
+	{
+	}
+
+	FServoShmRing::~FServoShmRing()
+	{
+		Close();
+	}
+
+	bool FServoShmRing::Create(const std::string & InName, uint64 InCapacity, EServoShmRingMode InMode, int32 InSyncword)
+	{
+#ifdef __linux__
+		Close();
+
+		uint64 _capacity = 4096;
+		while (_capacity < InCapacity)
+		{
+			_capacity <<= 1;
+		}
+
+		int _fd = -1;
+		if (InName.empty())
+		{
+			_fd = (int)::syscall(SYS_memfd_create, "servo-shm-ring", MFD_CLOEXEC);
+		}
+		else
+		{
+			_fd = ::shm_open(InName.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0600);
+		}
+		if (_fd < 0)
+		{
+			return false;
+		}
+
+		Name = InName;
+		bOwner = true;
+		// a fresh file reads as zeros: every record is free
+		if (::ftruncate(_fd, (off_t)(DataOffset() + _capacity)) != 0 || !Map(_fd, true, _capacity, InMode, InSyncword))
+		{
+			::close(_fd);
+			Close();
+			return false;
+		}
+		return true;
+#else
+		return false;
+#endif // __linux__
+	}
+
+	bool FServoShmRing::Open(const std::string & InName)
+	{
+#ifdef __linux__
+		Close();
+		int _fd = ::shm_open(InName.c_str(), O_RDWR | O_CLOEXEC, 0600);
+		if (_fd < 0)
+		{
+			return false;
+		}
+		if (!Attach(_fd))
+		{
+			return false;
+		}
+		Name = InName;
+		return true;
+#else
+		return false;
+#endif // __linux__
+	}
+
+	bool FServoShmRing::Attach(int InFd)
+	{
+#ifdef __linux__
+		Close();
+		if (!Map(InFd, false, 0, EServoShmRingMode::MultiProducer, 0))
+		{
+			::close(InFd);
+			return false;
+		}
+		return true;
+#else
+		return false;
+#endif // __linux__
+	}
+
+	bool FServoShmRing::Map(int InFd, bool bInit, uint64 InCapacity, EServoShmRingMode InMode, int32 InSyncword)
+	{
+#ifdef __linux__
+		struct stat _stat;
+		if (::fstat(InFd, &_stat) != 0 || (uint64)_stat.st_size <= DataOffset())
+		{
+			return false;
+		}
+
+		void* _ptr = ::mmap(nullptr, (SIZE_T)_stat.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, InFd, 0);
+		if (_ptr == MAP_FAILED)
+		{
+			return false;
+		}
+
+		FServoShmRingHeader* _header = reinterpret_cast<FServoShmRingHeader*>(_ptr);
+		if (bInit)
+		{
+			_header->Version = SERVO_SHM_RING_VERSION;
+			_header->Capacity = InCapacity;
+			_header->Syncword = InSyncword;
+			_header->Mode = InMode;
+			_header->WritePos.store(0, std::memory_order_relaxed);
+			_header->ReadPos.store(0, std::memory_order_relaxed);
+			_header->DataSeq.store(0, std::memory_order_relaxed);
+			_header->ConsumerWaiters.store(0, std::memory_order_relaxed);
+			_header->SpaceSeq.store(0, std::memory_order_relaxed);
+			_header->ProducerWaiters.store(0, std::memory_order_relaxed);
+			// magic last, the ring is usable once it shows up
+			reinterpret_cast<std::atomic<uint32>*>(&_header->Magic)->store(SERVO_SHM_RING_MAGIC, std::memory_order_release);
+		}
+		else
+		{
+			const uint32 _magic = reinterpret_cast<std::atomic<uint32>*>(&_header->Magic)->load(std::memory_order_acquire);
+			const uint64 _capacity = _header->Capacity;
+			if (_magic != SERVO_SHM_RING_MAGIC || _header->Version != SERVO_SHM_RING_VERSION
+				|| _capacity == 0 || (_capacity & (_capacity - 1)) != 0
+				|| DataOffset() + _capacity > (uint64)_stat.st_size)
+			{
+				::munmap(_ptr, (SIZE_T)_stat.st_size);
+				return false;
+			}
+		}
+
+		Header = _header;
+		Data = reinterpret_cast<uint8*>(_ptr) + DataOffset();
+		MapSize = (SIZE_T)_stat.st_size;
+		Fd = InFd;
+		PeekSize = 0;
+		return true;
+#else
+		return false;
+#endif // __linux__
+	}
+
+	void FServoShmRing::Close()
+	{
+#ifdef __linux__
+		if (Header)
+		{
+			::munmap(Header, MapSize);
+		}
+		if (Fd >= 0)
+		{
+			::close(Fd);
+		}
+		if (bOwner && !Name.empty())
+		{
+			// mapped rings stay alive, only the name goes
+			::shm_unlink(Name.c_str());
+		}
+#endif // __linux__
+		Header = nullptr;
+		Data = nullptr;
+		MapSize = 0;
+		Fd = -1;
+		Name.clear();
+		bOwner = false;
+		PeekSize = 0;
+	}
+
+	uint64 FServoShmRing::GetCapacity() const
+	{
+		return Header ? Header->Capacity : 0;
+	}
+
+	int32 FServoShmRing::GetMaxFrameSize() const
+	{
+		// a record of half the ring always fits once the ring drains, padding included
+		if (!Header)
+		{
+			return 0;
+		}
+		const uint64 _max = Header->Capacity / 2 - sizeof(FServoShmRecord);
+		return _max > (uint64)INT32_MAX ? INT32_MAX : (int32)_max;
+	}
+
+	bool FServoShmRing::Push(const std::shared_ptr<FSNetPacket>& InNetPacket)
+	{
+		if (!InNetPacket)
+		{
+			return false;
+		}
+		FSlice _slices[SERVO_PACKET_IOVEC_NUM];
+		const int32 _num = InNetPacket->WriteToIOVec(_slices);
+		return _num > 0 && Write(_slices, _num);
+	}
+
+	bool FServoShmRing::PushFrame(const uint8 * InData, int32 InSize)
+	{
+		FSlice _slice;
+		_slice.iov_base = InData;
+		_slice.iov_len = (SIZE_T)(InSize > 0 ? InSize : 0);
+		return Write(&_slice, 1);
+	}
+
+	bool FServoShmRing::Write(const FSlice * InSlices, int32 InNum)
+	{
+		if (!Header)
+		{
+			return false;
+		}
+		uint64 _size = 0;
+		for (int32 i = 0; i < InNum; ++i)
+		{
+			_size += InSlices[i].iov_len;
+		}
+		if (_size == 0 || _size > (uint64)GetMaxFrameSize())
+		{
+			return false;
+		}
+
+		const uint64 _capacity = Header->Capacity;
+		const uint64 _mask = _capacity - 1;
+		const uint64 _need = RecordSize(_size);
+
+		// 1. reserve [pos, pos + pad + need)
+		uint64 _pos = Header->WritePos.load(std::memory_order_relaxed);
+		uint64 _pad = 0;
+		for (;;)
+		{
+			const uint64 _contiguous = _capacity - (_pos & _mask);
+			_pad = _contiguous < _need ? _contiguous : 0;
+			const uint64 _read = Header->ReadPos.load(std::memory_order_acquire);
+			if (_pos < _read)
+			{
+				// stale: other producers wrote and the consumer read past it meanwhile
+				_pos = Header->WritePos.load(std::memory_order_relaxed);
+				continue;
+			}
+			if (_pos + _pad + _need - _read > _capacity)
+			{
+				return false;
+			}
+			if (Header->Mode == EServoShmRingMode::SingleProducer)
+			{
+				Header->WritePos.store(_pos + _pad + _need, std::memory_order_relaxed);
+				break;
+			}
+			if (Header->WritePos.compare_exchange_weak(_pos, _pos + _pad + _need, std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+
+		// 2. padding up to the end of the ring
+		if (_pad > 0)
+		{
+			FServoShmRecord* _padding = reinterpret_cast<FServoShmRecord*>(Data + (_pos & _mask));
+			_padding->Size = (uint32)(_pad - sizeof(FServoShmRecord));
+			_padding->State.store(RecordPadding, std::memory_order_release);
+			_pos += _pad;
+		}
+
+		// 3. the one copy, then publish
+		FServoShmRecord* _record = reinterpret_cast<FServoShmRecord*>(Data + (_pos & _mask));
+		uint8* _ptr = reinterpret_cast<uint8*>(_record) + sizeof(FServoShmRecord);
+		for (int32 i = 0; i < InNum; ++i)
+		{
+			memcpy(_ptr, InSlices[i].iov_base, InSlices[i].iov_len);
+			_ptr += InSlices[i].iov_len;
+		}
+		_record->Size = (uint32)_size;
+		_record->State.store(RecordFrame, std::memory_order_release);
+
+		NotifyData();
+		return true;
+	}
+
+	bool FServoShmRing::Peek(uint8 *& OutFrame, int32 & OutSize)
+	{
+		if (!Header)
+		{
+			return false;
+		}
+		const uint64 _mask = Header->Capacity - 1;
+		for (;;)
+		{
+			const uint64 _pos = Header->ReadPos.load(std::memory_order_relaxed);
+			FServoShmRecord* _record = reinterpret_cast<FServoShmRecord*>(Data + (_pos & _mask));
+			const uint32 _state = _record->State.load(std::memory_order_acquire);
+			if (_state == RecordFree)
+			{
+				return false;
+			}
+
+			const uint64 _size = RecordSize(_record->Size);
+			if (_state == RecordPadding)
+			{
+				memset(Data + (_pos & _mask), 0, (SIZE_T)_size);
+				Header->ReadPos.store(_pos + _size, std::memory_order_release);
+				continue;
+			}
+
+			OutFrame = reinterpret_cast<uint8*>(_record) + sizeof(FServoShmRecord);
+			OutSize = (int32)_record->Size;
+			PeekSize = _size;
+			return true;
+		}
+	}
+
+	void FServoShmRing::Release()
+	{
+		if (!Header || PeekSize == 0)
+		{
+			return;
+		}
+		const uint64 _pos = Header->ReadPos.load(std::memory_order_relaxed);
+		memset(Data + (_pos & (Header->Capacity - 1)), 0, (SIZE_T)PeekSize);
+		Header->ReadPos.store(_pos + PeekSize, std::memory_order_release);
+		PeekSize = 0;
+
+		NotifySpace();
+	}
+
+	bool FServoShmRing::Pop(std::shared_ptr<FSNetPacket>& OutNetPacket)
+	{
+		uint8* _frame = nullptr;
+		int32 _size = 0;
+		while (Peek(_frame, _size))
+		{
+			// a record holds exactly one frame (PushFrame takes any bytes), anything else is dropped
+			FSNetBufferHead _head;
+			const bool bFrame = _head.MemRead(_frame, _size)
+				&& _head.syncword == Header->Syncword
+				&& _head.size >= 0
+				&& (int64)_size == (int64)FSNetBufferHead::MemSize() + (0 != _head.uid ? (int64)_head.size : 0) + (int64)FSNetBufferFoot::MemSize();
+			if (!bFrame)
+			{
+				Release();
+				continue;
+			}
+
+			int32 _bytesRead = 0;
+			OutNetPacket = std::make_shared<FSNetPacket>(_frame, _size, _bytesRead, Header->Syncword);
+			Release();
+			return true;
+		}
+		return false;
+	}
+
+	bool FServoShmRing::IsEmpty() const
+	{
+		if (!Header)
+		{
+			return true;
+		}
+		return Header->ReadPos.load(std::memory_order_acquire) == Header->WritePos.load(std::memory_order_acquire);
+	}
+
+	bool FServoShmRing::HasData() const
+	{
+		const uint64 _pos = Header->ReadPos.load(std::memory_order_relaxed);
+		const FServoShmRecord* _record = reinterpret_cast<const FServoShmRecord*>(Data + (_pos & (Header->Capacity - 1)));
+		return _record->State.load(std::memory_order_acquire) != RecordFree;
+	}
+
+	bool FServoShmRing::HasSpace(int32 InFrameSize) const
+	{
+		const uint64 _capacity = Header->Capacity;
+		const uint64 _need = RecordSize((uint64)InFrameSize);
+		const uint64 _pos = Header->WritePos.load(std::memory_order_relaxed);
+		const uint64 _contiguous = _capacity - (_pos & (_capacity - 1));
+		const uint64 _pad = _contiguous < _need ? _contiguous : 0;
+		return _pos + _pad + _need - Header->ReadPos.load(std::memory_order_acquire) <= _capacity;
+	}
+
+	void FServoShmRing::NotifyData()
+	{
+#ifdef __linux__
+		// pairs with the fence in WaitForData: either we see the waiter or it sees the frame
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (Header->ConsumerWaiters.load(std::memory_order_relaxed) > 0)
+		{
+			Header->DataSeq.fetch_add(1, std::memory_order_release);
+			FutexWake(&Header->DataSeq);
+		}
+#endif // __linux__
+	}
+
+	void FServoShmRing::NotifySpace()
+	{
+#ifdef __linux__
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (Header->ProducerWaiters.load(std::memory_order_relaxed) > 0)
+		{
+			Header->SpaceSeq.fetch_add(1, std::memory_order_release);
+			FutexWake(&Header->SpaceSeq);
+		}
+#endif // __linux__
+	}
+
+	bool FServoShmRing::WaitForData(int32 InTimeoutMs)
+	{
+		if (!Header)
+		{
+			return false;
+		}
+		for (int32 i = 0; i < SERVO_SHM_RING_SPIN; ++i)
+		{
+			if (HasData())
+			{
+				return true;
+			}
+			SEPTEM_CPU_RELAX();
+		}
+#ifdef __linux__
+		bool _ready = false;
+		do
+		{
+			const uint32 _seq = Header->DataSeq.load(std::memory_order_acquire);
+			Header->ConsumerWaiters.fetch_add(1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			_ready = HasData();
+			if (!_ready)
+			{
+				FutexWait(&Header->DataSeq, _seq, InTimeoutMs);
+				_ready = HasData();
+			}
+			Header->ConsumerWaiters.fetch_sub(1, std::memory_order_relaxed);
+		} while (!_ready && InTimeoutMs < 0);
+		return _ready;
+#else
+		return HasData();
+#endif // __linux__
+	}
+
+	bool FServoShmRing::WaitForSpace(int32 InFrameSize, int32 InTimeoutMs)
+	{
+		if (!Header || InFrameSize <= 0 || InFrameSize > GetMaxFrameSize())
+		{
+			return false;
+		}
+		for (int32 i = 0; i < SERVO_SHM_RING_SPIN; ++i)
+		{
+			if (HasSpace(InFrameSize))
+			{
+				return true;
+			}
+			SEPTEM_CPU_RELAX();
+		}
+#ifdef __linux__
+		bool _ready = false;
+		do
+		{
+			const uint32 _seq = Header->SpaceSeq.load(std::memory_order_acquire);
+			Header->ProducerWaiters.fetch_add(1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			_ready = HasSpace(InFrameSize);
+			if (!_ready)
+			{
+				FutexWait(&Header->SpaceSeq, _seq, InTimeoutMs);
+				_ready = HasSpace(InFrameSize);
+			}
+			Header->ProducerWaiters.fetch_sub(1, std::memory_order_relaxed);
+		} while (!_ready && InTimeoutMs < 0);
+		return _ready;
+#else
+		return HasSpace(InFrameSize);
+#endif // __linux__
+	}
+}
@@ -0,0 +1,136 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#pragma once
+
+#include <Core/Public/marco.h>
+#include "ServoProtocol.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+/// default ring size in bytes, rounded up to a power of 2
+#ifndef SERVO_SHM_RING_CAPACITY
+#define SERVO_SHM_RING_CAPACITY (4 * 1024 * 1024)
+#endif // !SERVO_SHM_RING_CAPACITY
+
+/// empty / full polls before a waiter sleeps on the futex
+#ifndef SERVO_SHM_RING_SPIN
+#define SERVO_SHM_RING_SPIN 256
+#endif // !SERVO_SHM_RING_SPIN
+
+namespace Septem
+{
+	enum class EServoShmRingMode : uint32
+	{
+		SingleProducer = 0,	// SPSC: one pushing thread in all processes
+		MultiProducer = 1,	// MPSC: producers reserve space with a CAS
+	};
+
+	/**
+	* shared memory header, lives at the front of the mapping
+	* positions grow forever, offset = pos & (Capacity - 1)
+	*/
+	struct FServoShmRingHeader
+	{
+		uint32 Magic;
+		uint32 Version;
+		uint64 Capacity;
+		int32 Syncword;
+		EServoShmRingMode Mode;
+
+		// reserved by producers
+		alignas(64) std::atomic<uint64> WritePos;
+		// released by the consumer
+		alignas(64) std::atomic<uint64> ReadPos;
+
+		// futex words, bumped only when someone sleeps on them
+		alignas(64) std::atomic<uint32> DataSeq;
+		std::atomic<uint32> ConsumerWaiters;
+		alignas(64) std::atomic<uint32> SpaceSeq;
+		std::atomic<uint32> ProducerWaiters;
+	};
+
+	/**
+	* Servo Shared Memory Ring
+	* carries framed FSNetPacket between processes of one host
+	* the ring holds [record][head][body][foot] exactly as on the wire, 8 byte aligned
+	*	Push:	one copy from the packet into the ring, no syscall
+	*	Pop:	the frame is parsed into a new packet, a record that is not one whole frame is dropped
+	*	Peek / Release:	the frame in place, e.g. FServoStreamDecoder::ConsumeDatagram
+	* a sleeping side is woken through a futex in the mapping, a busy side never enters the kernel
+	*
+	* sharing:
+	*	named:		Create("/name") in one process, Open("/name") in the others (shm_open)
+	*	anonymous:	Create("") makes a memfd, hand GetFd() to a child or send it with CSocketUnix::send_fds,
+	*				the receiver calls Attach(fd)
+	* Push is thread safe in MultiProducer mode, Pop / Peek / Release belong to one consumer
+	* linux only
+	*/
+	class FServoShmRing
+	{
+	public:
+		FServoShmRing();
+		virtual ~FServoShmRing();
+
+		bool Create(const std::string& InName, uint64 InCapacity = SERVO_SHM_RING_CAPACITY,
+			EServoShmRingMode InMode = EServoShmRingMode::MultiProducer, int32 InSyncword = DEFAULT_SYNCWORD_INT32);
+		bool Open(const std::string& InName);
+		// maps a ring made by Create in another process, takes the descriptor
+		bool Attach(int InFd);
+		// unmaps, the creator also removes the name
+		void Close();
+
+		bool IsValid() const { return Header != nullptr; }
+		int GetFd() const { return Fd; }
+		uint64 GetCapacity() const;
+		// largest frame Push accepts
+		int32 GetMaxFrameSize() const;
+
+		// false when the ring is full or the packet is too large
+		bool Push(const std::shared_ptr<FSNetPacket>& InNetPacket);
+		// a frame already in wire format
+		bool PushFrame(const uint8* InData, int32 InSize);
+		bool Pop(std::shared_ptr<FSNetPacket>& OutNetPacket);
+
+		// next frame without copying, valid until Release
+		bool Peek(uint8*& OutFrame, int32& OutSize);
+		void Release();
+
+		// not Thread-safe, a snapshot
+		bool IsEmpty() const;
+
+		// sleep until a frame / free space shows up or InTimeoutMs passes, -1 waits forever
+		bool WaitForData(int32 InTimeoutMs = -1);
+		bool WaitForSpace(int32 InFrameSize, int32 InTimeoutMs = -1);
+
+	protected:
+		struct FSlice
+		{
+			const void* iov_base;
+			SIZE_T iov_len;
+		};
+
+		bool Map(int InFd, bool bInit, uint64 InCapacity, EServoShmRingMode InMode, int32 InSyncword);
+		bool Write(const FSlice* InSlices, int32 InNum);
+		// a committed record waits at the read position
+		bool HasData() const;
+		bool HasSpace(int32 InFrameSize) const;
+		void NotifyData();
+		void NotifySpace();
+
+		FServoShmRingHeader* Header;
+		uint8* Data;
+		SIZE_T MapSize;
+		int Fd;
+		std::string Name;
+		bool bOwner;
+
+		// record held by Peek
+		uint64 PeekSize;
+
+	private:
+		FServoShmRing(const FServoShmRing&);
+		FServoShmRing& operator=(const FServoShmRing&);
+	};
+}
@@ -120,6 +120,16 @@ namespace Septem
 		void ReUse(uint8* Data, int32 BufferSize, int32& BytesRead, int32 InSyncword = DEFAULT_SYNCWORD_INT32);
 		void ReUse(FSNetBufferHead & InHead, uint8 * Buffer, int32 BufferSize, int32 & BytesRead);
 		void WriteToArray(std::vector<uint8>& InBufferArr);
+		/**
+		* vectored output, head and foot point into this packet
+		* T has no wire layout of its own, the body is serialized into InBodyScratch,
+		* one scratch per packet of a batch, reuse it once the send returned
+		*
+		* @param OutVec room for SERVO_PACKET_IOVEC_NUM slices
+		* @return slices written, 0 if the body failed to serialize: send nothing
+		*/
+		template<typename IOVecType>
+		int32 WriteToIOVec(IOVecType* OutVec, std::vector<uint8>& InBodyScratch);
 		void OnDealloc();
 		void OnAlloc();
 		bool operator < (TSNetPacket<T> && Other);
@@ -174,8 +184,8 @@ namespace Septem
 
 		// please call ReUse or set value manulity after recycle alloc
 		std::shared_ptr< TSNetPacket<T> > AllocNetPacket();
-		// recycle dealloc
-		void DeallockNetPacket(const std::shared_ptr< TSNetPacket<T> > & InSharedPtr, bool bForceRecycle = false);
+		// recycle dealloc; the bool (bForceRecycle) is ignored, the recycle pool has no forced mode
+		void DeallockNetPacket(const std::shared_ptr< TSNetPacket<T> > & InSharedPtr, bool = false);
 		int32 RecyclePoolNum();
 
 		//=========================================
@@ -405,6 +415,39 @@ namespace Septem
 		BytesWrite += FSNetBufferFoot::MemSize();
 	}
 
+	template<typename T>
+	template<typename IOVecType>
+	inline int32 TSNetPacket<T>::WriteToIOVec(IOVecType* OutVec, std::vector<uint8>& InBodyScratch)
+	{
+		int32 _num = 0;
+		OutVec[_num].iov_base = &Head;
+		OutVec[_num].iov_len = FSNetBufferHead::MemSize();
+		++_num;
+
+		if (Head.uid != 0)
+		{
+			InBodyScratch.resize(Body.MemSize());
+			int32 outSize = 0;
+			if (!Body.Serialize(InBodyScratch.data(), (int32)InBodyScratch.size(), outSize))
+			{
+				// head and foot alone would announce a body that never comes
+				return 0;
+			}
+
+			if (outSize > 0)
+			{
+				OutVec[_num].iov_base = InBodyScratch.data();
+				OutVec[_num].iov_len = outSize;
+				++_num;
+			}
+		}
+
+		OutVec[_num].iov_base = &Foot;
+		OutVec[_num].iov_len = FSNetBufferFoot::MemSize();
+		++_num;
+		return _num;
+	}
+
 	template<typename T>
 	inline void TSNetPacket<T>::OnDealloc()
 	{
@@ -508,20 +551,13 @@ namespace Septem
 	}
 
 	template<typename T,  SPPMode PoolMode>
-	inline void TServoProtocol<T,  PoolMode>::DeallockNetPacket(const std::shared_ptr< TSNetPacket<T> >& InSharedPtr, bool bForceRecycle)
+	inline void TServoProtocol<T,  PoolMode>::DeallockNetPacket(const std::shared_ptr< TSNetPacket<T> >& InSharedPtr, bool)
 	{
-		if (!InSharedPtr.IsValid())
+		if (nullptr == InSharedPtr.get())
 			return;
 
 		InSharedPtr->OnDealloc();
-		if (bForceRecycle)
-		{
-			RecyclePool.DeallocForceRecycle(InSharedPtr);
-		}
-		else
-		{
-			RecyclePool.Dealloc(InSharedPtr);
-		}
+		RecyclePool.Dealloc(InSharedPtr);
 	}
 
 	template<typename T,  SPPMode PoolMode>
@@ -537,7 +573,7 @@ namespace Septem
 		if (Pop(newPacket))
 		{
 			DeallockNetPacket(OutRecyclePacket);
-			OutRecyclePacket = MoveTemp(newPacket);
+			OutRecyclePacket = std::move(newPacket);
 			return true;
 		}
 
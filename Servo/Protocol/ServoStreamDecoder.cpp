@@ -0,0 +1,212 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#include "ServoStreamDecoder.h"
+#include "ProtocolFactory.h"
+
+#include <Core/Algorithm/SeptemBuffer.h>
+#include <string.h>
+
+namespace Septem
+{
+	FServoStreamDecoder::FServoStreamDecoder(int32 InSyncword, int32 InMaxBodySize)
+		:ReadPos(0)
+		, WritePos(0)
+		, Syncword(InSyncword)
+		, MaxBodySize(InMaxBodySize)
+		, FrameCount(0)
+		, DroppedCount(0)
+	{
+	}
+
+	FServoStreamDecoder::~FServoStreamDecoder()
+	{
+	}
+
+	uint8 * FServoStreamDecoder::PrepareWrite(int32 & OutCapacity)
+	{
+		if ((int32)Buffer.size() - WritePos < SERVO_STREAM_READ_CHUNK)
+		{
+			// 1. move the partial frame to the front
+			const int32 _pending = WritePos - ReadPos;
+			if (ReadPos > 0)
+			{
+				memmove(Buffer.data(), Buffer.data() + ReadPos, _pending);
+				ReadPos = 0;
+				WritePos = _pending;
+			}
+
+			// 2. grow if the frame is still larger than the free space
+			if ((int32)Buffer.size() - WritePos < SERVO_STREAM_READ_CHUNK)
+			{
+				Buffer.resize((SIZE_T)WritePos + SERVO_STREAM_READ_CHUNK);
+			}
+		}
+
+		OutCapacity = (int32)Buffer.size() - WritePos;
+		return Buffer.data() + WritePos;
+	}
+
+	int32 FServoStreamDecoder::CommitWrite(int32 InBytes)
+	{
+		check(InBytes >= 0 && WritePos + InBytes <= (int32)Buffer.size());
+		WritePos += InBytes;
+		return Decode();
+	}
+
+	int32 FServoStreamDecoder::Feed(const uint8 * InData, int32 InSize)
+	{
+		int32 _frames = 0;
+		while (InSize > 0)
+		{
+			int32 _capacity = 0;
+			uint8* ptr = PrepareWrite(_capacity);
+			const int32 _bytes = InSize < _capacity ? InSize : _capacity;
+			memcpy(ptr, InData, _bytes);
+			_frames += CommitWrite(_bytes);
+			InData += _bytes;
+			InSize -= _bytes;
+		}
+		return _frames;
+	}
+
+	void FServoStreamDecoder::Reset()
+	{
+		ReadPos = 0;
+		WritePos = 0;
+	}
+
+	int32 FServoStreamDecoder::Consume(uint8 * InData, int32 InSize)
+	{
+		if (PendingBytes() > 0)
+		{
+			// a frame is already split, join it in the decoder buffer
+			return Feed(InData, InSize);
+		}
+
+		// 1. frames complete in InData are decoded in place
+		int32 _consumed = 0;
+		const int32 _frames = DecodeRange(InData, InSize, _consumed);
+
+		// 2. only the partial tail is copied
+		return _frames + Feed(InData + _consumed, InSize - _consumed);
+	}
+
+	int32 FServoStreamDecoder::ConsumeDatagram(uint8 * InData, int32 InSize)
+	{
+		int32 _consumed = 0;
+		const int32 _frames = DecodeRange(InData, InSize, _consumed);
+		// a frame cut by the datagram end never completes
+		DroppedCount += InSize - _consumed;
+		return _frames;
+	}
+
+	int32 FServoStreamDecoder::ConsumeBatch(sockets::CDatagramBatch & InBatch)
+	{
+		int32 _frames = 0;
+		for (SIZE_T i = 0; i < InBatch.size(); ++i)
+		{
+			uint8* data = (uint8*)InBatch.data(i);
+			const SIZE_T _length = InBatch.length(i);
+			const SIZE_T _segment = InBatch.segment(i) > 0 ? InBatch.segment(i) : _length;
+			for (SIZE_T offset = 0; offset < _length; offset += _segment)
+			{
+				const SIZE_T _bytes = _length - offset < _segment ? _length - offset : _segment;
+				_frames += ConsumeDatagram(data + offset, (int32)_bytes);
+			}
+		}
+		return _frames;
+	}
+
+	int32 FServoStreamDecoder::Decode()
+	{
+		int32 _consumed = 0;
+		const int32 _frames = DecodeRange(Buffer.data() + ReadPos, WritePos - ReadPos, _consumed);
+		ReadPos += _consumed;
+
+		if (ReadPos == WritePos)
+		{
+			ReadPos = 0;
+			WritePos = 0;
+		}
+		return _frames;
+	}
+
+	int32 FServoStreamDecoder::DecodeRange(uint8 * InData, int32 InSize, int32 & OutConsumed)
+	{
+		const int32 _HeadSize = FSNetBufferHead::MemSize();
+		const int32 _FootSize = FSNetBufferFoot::MemSize();
+		int32 _frames = 0;
+		OutConsumed = 0;
+
+		for (;;)
+		{
+			uint8* data = InData + OutConsumed;
+			int32 available = InSize - OutConsumed;
+			if (available < _HeadSize)
+				break;
+
+			// 1. sync
+			int32 index = Septem::BufferBufferSyncword(data, available, Syncword);
+			if (-1 == index)
+			{
+				// keep the tail, it may be the start of a syncword
+				const int32 _drop = available - (int32)sizeof(int32);
+				OutConsumed += _drop;
+				DroppedCount += _drop;
+				break;
+			}
+			if (index > 0)
+			{
+				OutConsumed += index;
+				DroppedCount += index;
+				continue;
+			}
+
+			// 2. head
+			FSNetBufferHead head;
+			head.MemRead(data, available);
+			const int32 _bodySize = 0 == head.uid ? 0 : head.size;
+			if (_bodySize < 0 || _bodySize > MaxBodySize)
+			{
+				// not a real head, search again after this syncword
+				OutConsumed += 1;
+				DroppedCount += 1;
+				continue;
+			}
+
+			// 3. wait for the whole frame
+			const int32 _payloadSize = _bodySize + _FootSize;
+			if (available < _HeadSize + _payloadSize)
+				break;
+
+			OutConsumed += _HeadSize + _payloadSize;
+			OnFrame(head, data + _HeadSize, _payloadSize);
+			++FrameCount;
+			++_frames;
+		}
+
+		return _frames;
+	}
+
+	void FServoStreamDecoder::OnFrame(FSNetBufferHead & InHead, uint8 * InPayload, int32 InPayloadSize)
+	{
+		int32 _bytesRead = 0;
+		if (0 == InHead.uid)
+		{
+			FServoProtocol* protocol = FServoProtocol::Get();
+			std::shared_ptr<FSNetPacket> packet = protocol->AllocNetPacket();
+			packet->ReUse(InHead, InPayload, InPayloadSize, _bytesRead);
+			if (packet->IsValid())
+			{
+				protocol->Push(packet);
+			}
+			else
+			{
+				protocol->DeallockNetPacket(packet);
+			}
+			return;
+		}
+
+		FProtocolFactory::Get()->CallProtocolDeserialize(InHead, InPayload, InPayloadSize, _bytesRead);
+	}
+}
@@ -0,0 +1,114 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#pragma once
+
+#include <Core/Public/marco.h>
+#include "ServoProtocol.h"
+
+#include <cppsockets/IOEngine.h>
+#include <cppsockets/SocketUDP.h>
+
+#include <vector>
+
+/*
+* largest body accepted from the wire
+* a head announcing more is treated as a false syncword
+*/
+#ifndef SERVO_STREAM_MAX_BODY
+#define SERVO_STREAM_MAX_BODY (16 * 1024 * 1024)
+#endif // !SERVO_STREAM_MAX_BODY
+
+/// free bytes PrepareWrite guarantees for the next read
+#ifndef SERVO_STREAM_READ_CHUNK
+#define SERVO_STREAM_READ_CHUNK (16 * 1024)
+#endif // !SERVO_STREAM_READ_CHUNK
+
+namespace Septem
+{
+	/**
+	* Servo Stream Decoder
+	* cuts a byte stream into [head][body][foot] frames
+	* bytes are read straight into the decoder buffer: PrepareWrite -> recv -> CommitWrite
+	* datagrams (ConsumeDatagram / ConsumeBatch) are decoded where they were received
+	* partial frames wait for more bytes, junk before a syncword is dropped
+	* complete frames go to OnFrame:
+	*	uid == 0:	heartbeat, pushed into FServoProtocol
+	*	uid != 0:	FProtocolFactory::CallProtocolDeserialize
+	* one decoder per connection, No Thread Safe
+	*/
+	class FServoStreamDecoder
+	{
+	public:
+		FServoStreamDecoder(int32 InSyncword = DEFAULT_SYNCWORD_INT32, int32 InMaxBodySize = SERVO_STREAM_MAX_BODY);
+		virtual ~FServoStreamDecoder();
+
+		// free space for at least SERVO_STREAM_READ_CHUNK bytes
+		uint8* PrepareWrite(int32& OutCapacity);
+		// InBytes were written into the PrepareWrite space, decode what is complete
+		// @return frames decoded
+		int32 CommitWrite(int32 InBytes);
+		// copy in and decode, for transports that own their buffers
+		int32 Feed(const uint8* InData, int32 InSize);
+		// decode in place from a transport buffer valid for this call only
+		// copies just the partial frame at the end, or everything while a frame is split
+		int32 Consume(uint8* InData, int32 InSize);
+		// one datagram holds whole frames, decoded in place, nothing is carried to the next one
+		int32 ConsumeDatagram(uint8* InData, int32 InSize);
+		// every datagram of a CSocketUDP::recv_batch, GRO slots are cut at their segment size
+		int32 ConsumeBatch(sockets::CDatagramBatch& InBatch);
+
+		// bytes waiting for the rest of a frame
+		int32 PendingBytes() const { return WritePos - ReadPos; }
+		uint64 FramesDecoded() const { return FrameCount; }
+		uint64 BytesDropped() const { return DroppedCount; }
+		void Reset();
+
+	protected:
+		int32 Decode();
+		// decode complete frames of [InData, InData + InSize), OutConsumed: bytes done with
+		int32 DecodeRange(uint8* InData, int32 InSize, int32& OutConsumed);
+		// InPayload: body + foot, InPayloadSize covers exactly one frame
+		virtual void OnFrame(FSNetBufferHead& InHead, uint8* InPayload, int32 InPayloadSize);
+
+		std::vector<uint8> Buffer;
+		int32 ReadPos;
+		int32 WritePos;
+
+		int32 Syncword;
+		int32 MaxBodySize;
+		uint64 FrameCount;
+		uint64 DroppedCount;
+	};
+
+	/**
+	* FServoStreamDecoder as a sockets::CIOEngine connection handler
+	*	epoll:		readable bytes land in the decoder buffer without an extra copy
+	*	io_uring:	frames are decoded straight from the kernel provided buffer
+	*/
+	class FServoStreamHandler : public sockets::IStreamHandler, public FServoStreamDecoder
+	{
+	public:
+		FServoStreamHandler(int32 InSyncword = DEFAULT_SYNCWORD_INT32)
+			:FServoStreamDecoder(InSyncword)
+		{}
+
+		virtual char* prepare_recv(size_t& capacity) override
+		{
+			int32 _capacity = 0;
+			uint8* ptr = PrepareWrite(_capacity);
+			capacity = (size_t)_capacity;
+			return (char*)ptr;
+		}
+
+		virtual void on_recv(sockets::CSocketTCP&, size_t count) override
+		{
+			CommitWrite((int32)count);
+		}
+
+		virtual bool on_data(sockets::CSocketTCP&, char* data, size_t count) override
+		{
+			Consume((uint8*)data, (int32)count);
+			return true;
+		}
+	};
+}
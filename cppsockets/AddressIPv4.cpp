@@ -1,30 +1,43 @@
 #include "AddressIPv4.h"
 #include <sstream>
-
-#ifndef WIN_SOCKET
-	#include <netdb.h>
-#endif
+#include <cstring>
 
 namespace sockets {
 
 in_addr_t CAddressIPv4::read_address(std::string hostname){
-	struct hostent *h = gethostbyname(hostname.c_str());
-	if (!h){
+	in_addr_t address = 0;
+	if (!CResolver::Get().resolve(hostname, address)){
 		return 0;
 	}
-	return *((unsigned int *) h->h_addr_list[0]);
+	return address;
 }
 
 CAddressIPv4::CAddressIPv4(std::string host, int port){
-	struct hostent *h = gethostbyname(host.c_str());
-	_valid = h != nullptr;
+	in_addr_t address = 0;
+	_valid = CResolver::Get().resolve(host, address);
+	std::memset(&_addr, 0, sizeof(_addr));
 	if (_valid){
 		_addr.sin_family = AF_INET;
 		_addr.sin_port = htons((uint16_t)port);
-		_addr.sin_addr.s_addr = *((unsigned int *) h->h_addr_list[0]); //htonl(INADDR_ANY);
+		_addr.sin_addr.s_addr = address;
 	}
 }
 
+void CAddressIPv4::resolve_async(std::string host, int port, std::function<void(const CAddressIPv4 &)> done){
+	CResolver::Get().resolve_async(host, [port, done](bool ok, in_addr_t address){
+		if (!ok){
+			done(CAddressIPv4());
+			return;
+		}
+		struct sockaddr_in addr;
+		std::memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons((uint16_t)port);
+		addr.sin_addr.s_addr = address;
+		done(CAddressIPv4(addr));
+	});
+}
+
 CAddressIPv4::CAddressIPv4(struct sockaddr_in addr){
 	_addr = addr;
 	_valid = true;
@@ -35,6 +48,12 @@ CAddressIPv4::CAddressIPv4(const CAddressIPv4 &addr){
 	_valid = addr._valid;
 }
 
+CAddressIPv4 &CAddressIPv4::operator=(const CAddressIPv4 &addr){
+	_addr = addr._addr;
+	_valid = addr._valid;
+	return *this;
+}
+
 std::string CAddressIPv4::str() const {
 	std::stringstream res;
 	res << ip() << ":" << port();
@@ -4,6 +4,9 @@
 #define ADDRESS_IPV4_H
 
 #include "Address.h"
+#include "Resolver.h"
+
+#include <functional>
 
 namespace sockets {
 
@@ -17,9 +20,11 @@ protected:
 public:
 	CAddressIPv4(){ _valid = false; }
 	
+	// numeric hosts are parsed, names go through the CResolver cache
 	CAddressIPv4(std::string host, int port);
 	CAddressIPv4(struct sockaddr_in addr);
 	CAddressIPv4(const CAddressIPv4 &addr);
+	CAddressIPv4 &operator=(const CAddressIPv4 &addr);
 	
 	virtual std::string str() const override;
 	virtual bool Valid() const override;
@@ -28,6 +33,9 @@ public:
 	int port() const;
 	
 	struct sockaddr_in get() const { return _addr; }
+
+	// never blocks the caller on dns, done gets an invalid address when the name does not resolve
+	static void resolve_async(std::string host, int port, std::function<void(const CAddressIPv4 &)> done);
 };
 
 }
@@ -0,0 +1,60 @@
+#include "AddressUnix.h"
+
+#ifndef WIN_SOCKET
+
+#include <cstring>
+#include <stddef.h>
+
+namespace sockets {
+
+CAddressUnix::CAddressUnix(const std::string &path){
+	std::memset(&_addr, 0, sizeof(_addr));
+	_addr.sun_family = AF_UNIX;
+	_valid = !path.empty() && path.size() < sizeof(_addr.sun_path);
+	_len = 0;
+	if (_valid){
+		std::memcpy(_addr.sun_path, path.data(), path.size());
+		if (path[0] == '@'){
+			// abstract: leading zero byte, the length covers the name only
+			_addr.sun_path[0] = '\0';
+			_len = (socklen_t)(offsetof(struct sockaddr_un, sun_path) + path.size());
+		} else {
+			_len = (socklen_t)(offsetof(struct sockaddr_un, sun_path) + path.size() + 1);
+		}
+	}
+}
+
+CAddressUnix::CAddressUnix(const struct sockaddr_un &addr, socklen_t len){
+	_addr = addr;
+	_len = len;
+	_valid = addr.sun_family == AF_UNIX && len <= sizeof(addr);
+}
+
+std::string CAddressUnix::str() const {
+	if (!_valid){
+		return "";
+	}
+	size_t size = _len > offsetof(struct sockaddr_un, sun_path) ? _len - offsetof(struct sockaddr_un, sun_path) : 0;
+	if (size == 0){
+		return "unix:unnamed";
+	}
+	if (abstract()){
+		return "unix:@" + std::string(_addr.sun_path + 1, size - 1);
+	}
+	return "unix:" + path();
+}
+
+bool CAddressUnix::Valid() const {
+	return _valid;
+}
+
+std::string CAddressUnix::path() const {
+	if (!_valid || abstract() || _len <= offsetof(struct sockaddr_un, sun_path)){
+		return "";
+	}
+	return std::string(_addr.sun_path, strnlen(_addr.sun_path, sizeof(_addr.sun_path)));
+}
+
+}
+
+#endif // !WIN_SOCKET
@@ -0,0 +1,45 @@
+#pragma once
+
+#ifndef ADDRESS_UNIX_H
+#define ADDRESS_UNIX_H
+
+#include "Address.h"
+
+#ifndef WIN_SOCKET
+
+#include <sys/un.h>
+#include <cstring>
+
+namespace sockets {
+
+/*
+* AF_UNIX address
+* "@name" is the linux abstract namespace: no file, gone with the last socket
+*/
+class CAddressUnix : public IAddress {
+protected:
+	struct sockaddr_un _addr;
+	socklen_t _len;
+	bool _valid;
+public:
+	CAddressUnix(){ std::memset(&_addr, 0, sizeof(_addr)); _valid = false; _len = 0; }
+
+	CAddressUnix(const std::string &path);
+	CAddressUnix(const struct sockaddr_un &addr, socklen_t len);
+
+	virtual std::string str() const override;
+	virtual bool Valid() const override;
+
+	// file system path, empty for abstract and unnamed addresses
+	std::string path() const;
+	bool abstract() const { return _valid && _len > sizeof(sa_family_t) && _addr.sun_path[0] == '\0'; }
+
+	const struct sockaddr_un &get() const { return _addr; }
+	socklen_t length() const { return _len; }
+};
+
+}
+
+#endif // !WIN_SOCKET
+
+#endif
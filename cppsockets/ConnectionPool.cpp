@@ -0,0 +1,184 @@
+#ifndef WIN_SOCKET
+	#include <errno.h>
+	#include <sys/socket.h>
+#endif
+
+#include <chrono>
+#include <vector>
+
+#include "ConnectionPool.h"
+
+namespace sockets {
+
+CConnectionPool::CConnectionPool(const CSocketOptions &options, size_t max_idle, uint32_t idle_timeout_ms)
+		: _options(options), _max_idle(max_idle), _idle_timeout_ms(idle_timeout_ms), _check_ms(CONNECTION_POOL_CHECK_MS)
+{
+}
+
+CConnectionPool::~CConnectionPool(){
+	clear();
+}
+
+uint64_t CConnectionPool::key(const CAddressIPv4 &dest){
+	struct sockaddr_in addr = dest.get();
+	return ((uint64_t) addr.sin_addr.s_addr << 16) | addr.sin_port;
+}
+
+uint64_t CConnectionPool::now_ms(){
+	return (uint64_t) std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool CConnectionPool::alive(CSocketTCP &sock){
+	if (!sock.Valid()){
+		return false;
+	}
+#ifdef WIN_SOCKET
+	fd_set readable;
+	FD_ZERO(&readable);
+	FD_SET(sock.get_handle(), &readable);
+	struct timeval timeout = { 0, 0 };
+	if (::select(0, &readable, nullptr, nullptr, &timeout) == 0){
+		return true;
+	}
+	// readable while idle: closed, failed or a late answer
+	return false;
+#else
+	char c;
+	int k = (int)::recv(sock.get_handle(), &c, 1, MSG_PEEK | MSG_DONTWAIT);
+	return k < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+#endif
+}
+
+std::unique_ptr<CSocketTCP> CConnectionPool::connect(const CAddressIPv4 &dest){
+	std::unique_ptr<CSocketTCP> sock(new CSocketTCP(dest, _options));
+	sock->Open();
+	if (!sock->Valid()){
+		return std::unique_ptr<CSocketTCP>(nullptr);
+	}
+	return sock;
+}
+
+bool CConnectionPool::usable(CSocketTCP &sock, uint64_t since_ms, uint64_t now){
+	if (!sock.Valid() || now - since_ms >= _idle_timeout_ms){
+		return false;
+	}
+	check_t check;
+	{
+		std::lock_guard<std::mutex> scopelock(_lock);
+		if (now - since_ms < _check_ms){
+			return true;
+		}
+		check = _check;
+	}
+	return check ? check(sock) : alive(sock);
+}
+
+std::unique_ptr<CSocketTCP> CConnectionPool::acquire(const CAddressIPv4 &dest){
+	const uint64_t k = key(dest);
+	for (;;){
+		CIdle entry;
+		{
+			std::lock_guard<std::mutex> scopelock(_lock);
+			auto itr = _idle.find(k);
+			if (itr == _idle.end() || itr->second.empty()){
+				break;
+			}
+			// most recent first, its window and route are still warm
+			entry = std::move(itr->second.back());
+			itr->second.pop_back();
+		}
+		if (usable(*entry.sock, entry.since_ms, now_ms())){
+			return std::move(entry.sock);
+		}
+	}
+	return connect(dest);
+}
+
+void CConnectionPool::release(std::unique_ptr<CSocketTCP> sock){
+	if (!sock || !sock->Valid()){
+		return;
+	}
+	const uint64_t k = key(static_cast<const CAddressIPv4 &>(sock->get_dest_address()));
+	std::lock_guard<std::mutex> scopelock(_lock);
+	std::deque<CIdle> &list = _idle[k];
+	if (list.size() >= _max_idle){
+		return;
+	}
+	CIdle entry;
+	entry.sock = std::move(sock);
+	entry.since_ms = now_ms();
+	list.push_back(std::move(entry));
+}
+
+size_t CConnectionPool::prewarm(const CAddressIPv4 &dest, size_t count){
+	if (count > _max_idle){
+		count = _max_idle;
+	}
+	const size_t have = idle(dest);
+	// connects run without the lock
+	for (size_t i = have; i < count; ++i){
+		std::unique_ptr<CSocketTCP> sock = connect(dest);
+		if (!sock){
+			break;
+		}
+		release(std::move(sock));
+	}
+	return idle(dest);
+}
+
+size_t CConnectionPool::maintain(){
+	std::vector<std::pair<uint64_t, CIdle>> entries;
+	{
+		std::lock_guard<std::mutex> scopelock(_lock);
+		for (auto &itr : _idle){
+			for (CIdle &entry : itr.second){
+				entries.emplace_back(itr.first, std::move(entry));
+			}
+			itr.second.clear();
+		}
+	}
+
+	size_t closed = 0;
+	const uint64_t now = now_ms();
+	std::vector<std::pair<uint64_t, CIdle>> keep;
+	for (auto &entry : entries){
+		if (usable(*entry.second.sock, entry.second.since_ms, now)){
+			keep.push_back(std::move(entry));
+		} else {
+			++closed;
+		}
+	}
+
+	std::lock_guard<std::mutex> scopelock(_lock);
+	// in front of anything released meanwhile, oldest first as before
+	for (auto itr = keep.rbegin(); itr != keep.rend(); ++itr){
+		std::deque<CIdle> &list = _idle[itr->first];
+		if (list.size() < _max_idle){
+			// the idle time keeps counting, a check does not make it fresh
+			list.push_front(std::move(itr->second));
+		} else {
+			++closed;
+		}
+	}
+	return closed;
+}
+
+void CConnectionPool::clear(){
+	std::lock_guard<std::mutex> scopelock(_lock);
+	_idle.clear();
+}
+
+size_t CConnectionPool::idle(const CAddressIPv4 &dest){
+	std::lock_guard<std::mutex> scopelock(_lock);
+	auto itr = _idle.find(key(dest));
+	return itr == _idle.end() ? 0 : itr->second.size();
+}
+
+void CConnectionPool::set_health_check(check_t check, uint32_t check_ms){
+	std::lock_guard<std::mutex> scopelock(_lock);
+	_check = std::move(check);
+	_check_ms = check_ms;
+}
+
+}
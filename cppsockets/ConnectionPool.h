@@ -0,0 +1,91 @@
+#pragma once
+
+#ifndef CONNECTION_POOL_H
+#define CONNECTION_POOL_H
+
+#include "SocketTCP.h"
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <stdint.h>
+
+// idle connections kept per destination
+#ifndef CONNECTION_POOL_MAX_IDLE
+	#define CONNECTION_POOL_MAX_IDLE 8
+#endif
+
+// idle connections older than this are closed instead of reused
+#ifndef CONNECTION_POOL_IDLE_TIMEOUT_MS
+	#define CONNECTION_POOL_IDLE_TIMEOUT_MS 60000
+#endif
+
+// idle connections older than this are health checked before reuse
+#ifndef CONNECTION_POOL_CHECK_MS
+	#define CONNECTION_POOL_CHECK_MS 1000
+#endif
+
+namespace sockets {
+
+	/*
+	* open client connections per destination, thread safe
+	* acquire: the most recently released idle connection that passes its check, otherwise a new connect
+	* release: back to the idle list unless it is broken or the list is full
+	* prewarm: connect ahead of the first request
+	* health check: alive() by default, set_health_check replaces it (e.g. a protocol heartbeat),
+	*	runs outside the pool lock on connections idle longer than the check interval
+	*/
+	class CConnectionPool {
+	public:
+		typedef std::function<bool(CSocketTCP &sock)> check_t;
+
+		CConnectionPool(const CSocketOptions &options = CSocketOptions(),
+			size_t max_idle = CONNECTION_POOL_MAX_IDLE, uint32_t idle_timeout_ms = CONNECTION_POOL_IDLE_TIMEOUT_MS);
+		virtual ~CConnectionPool();
+
+		// nullptr when the destination cannot be reached
+		std::unique_ptr<CSocketTCP> acquire(const CAddressIPv4 &dest);
+		void release(std::unique_ptr<CSocketTCP> sock);
+		// connects until count connections are idle for dest, returns the idle count
+		size_t prewarm(const CAddressIPv4 &dest, size_t count);
+		// closes idle connections that timed out or fail the check, returns how many
+		size_t maintain();
+		void clear();
+		size_t idle(const CAddressIPv4 &dest);
+
+		void set_health_check(check_t check, uint32_t check_ms = CONNECTION_POOL_CHECK_MS);
+		const CSocketOptions &GetOptions() const { return _options; }
+
+		// the peer has not closed and no unread bytes are left over, never blocks
+		static bool alive(CSocketTCP &sock);
+
+	protected:
+		struct CIdle {
+			std::unique_ptr<CSocketTCP> sock;
+			uint64_t since_ms;
+		};
+
+		static uint64_t key(const CAddressIPv4 &dest);
+		static uint64_t now_ms();
+
+		std::unique_ptr<CSocketTCP> connect(const CAddressIPv4 &dest);
+		bool usable(CSocketTCP &sock, uint64_t since_ms, uint64_t now);
+
+		std::mutex _lock;
+		std::unordered_map<uint64_t, std::deque<CIdle>> _idle;
+		CSocketOptions _options;
+		size_t _max_idle;
+		uint32_t _idle_timeout_ms;
+		uint32_t _check_ms;
+		check_t _check;
+
+	private:
+		CConnectionPool(const CConnectionPool &);
+		CConnectionPool &operator=(const CConnectionPool &);
+	};
+
+}
+
+#endif
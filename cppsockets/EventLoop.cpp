@@ -0,0 +1,484 @@
+#include "EventLoop.h"
+
+#ifndef WIN_SOCKET
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+#ifndef EVENT_LOOP_MAX_EVENTS
+	#define EVENT_LOOP_MAX_EVENTS 256
+#endif
+
+// wait between retries of stalled handlers and starved listeners
+#ifndef EVENT_LOOP_RETRY_MS
+	#define EVENT_LOOP_RETRY_MS 10
+#endif
+
+namespace sockets {
+
+// loop run by this thread, tells writes on the loop thread from the rest
+static thread_local const void *t_current_loop = nullptr;
+
+struct CEventLoop::COutput : public CStreamOutput, public std::enable_shared_from_this<CEventLoop::COutput> {
+	CLoop *loop;
+	// loop thread only, nullptr once the connection is closed
+	CConnection *conn;
+
+	COutput(CLoop *owner, CConnection *connection) : loop(owner), conn(connection) {}
+
+protected:
+	virtual void kick() override {
+		if (t_current_loop == loop){
+			// flushed at the end of this loop turn
+			loop->dirty.push_back(shared_from_this());
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> scopelock(loop->pending_lock);
+			loop->flushes.push_back(shared_from_this());
+		}
+		uint64_t one = 1;
+		ssize_t k = ::write(loop->wake, &one, sizeof(one));
+		(void)k;
+	}
+};
+
+static int open_reserve(){
+	return ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+}
+
+CEventLoop::CEventLoop(int threads)
+		: _running(false), _next(0), _connections(0)
+{
+	if (threads < 1){
+		threads = 1;
+	}
+	for (int i = 0; i < threads; ++i){
+		std::unique_ptr<CLoop> loop(new CLoop());
+		loop->epoll = ::epoll_create1(EPOLL_CLOEXEC);
+		loop->wake = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		loop->reserve = open_reserve();
+
+		struct epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.fd = loop->wake;
+		::epoll_ctl(loop->epoll, EPOLL_CTL_ADD, loop->wake, &ev);
+
+		_loops.push_back(std::move(loop));
+	}
+}
+
+CEventLoop::~CEventLoop(){
+	Stop();
+	for (auto &loop : _loops){
+		for (CConnection *conn : loop->pending){
+			delete conn;
+		}
+		loop->connections.clear();
+		::close(loop->wake);
+		::close(loop->epoll);
+		if (loop->reserve >= 0){
+			::close(loop->reserve);
+		}
+	}
+}
+
+bool CEventLoop::Start(){
+	bool expected = false;
+	if (!_running.compare_exchange_strong(expected, true)){
+		return false;
+	}
+	for (auto &loop : _loops){
+		if (loop->epoll < 0 || loop->wake < 0){
+			_running = false;
+			return false;
+		}
+	}
+	for (auto &loop : _loops){
+		CLoop *ptr = loop.get();
+		loop->thread = std::thread([this, ptr](){ run(*ptr); });
+	}
+	return true;
+}
+
+void CEventLoop::Stop(){
+	bool expected = true;
+	if (!_running.compare_exchange_strong(expected, false)){
+		return;
+	}
+	for (auto &loop : _loops){
+		uint64_t one = 1;
+		ssize_t k = ::write(loop->wake, &one, sizeof(one));
+		(void)k;
+	}
+	for (auto &loop : _loops){
+		if (loop->thread.joinable()){
+			loop->thread.join();
+		}
+	}
+}
+
+bool CEventLoop::Listen(CSocketTCPServer &server, handler_factory_t factory){
+	return add_listener(*_loops[0], server, std::move(factory), true);
+}
+
+bool CEventLoop::ListenOn(int thread, CSocketTCPServer &server, handler_factory_t factory){
+	if (thread < 0 || thread >= (int)_loops.size()){
+		return false;
+	}
+	return add_listener(*_loops[thread], server, std::move(factory), false);
+}
+
+bool CEventLoop::add_listener(CLoop &loop, CSocketTCPServer &server, handler_factory_t factory, bool spread){
+	if (_running || !server.Valid() || !server.SetNonBlocking(true)){
+		return false;
+	}
+
+	CListener listener;
+	listener.server = &server;
+	listener.factory = std::move(factory);
+	listener.loop = &loop;
+	listener.spread = spread;
+	listener.retry = false;
+	_listeners.push_back(std::move(listener));
+
+	struct epoll_event ev;
+	ev.events = EPOLLIN | EPOLLET;
+	ev.data.fd = server.get_handle();
+	return ::epoll_ctl(loop.epoll, EPOLL_CTL_ADD, server.get_handle(), &ev) == 0;
+}
+
+bool CEventLoop::Add(std::unique_ptr<CSocketTCP> sock, std::shared_ptr<IStreamHandler> handler){
+	if (!sock || !sock->Valid() || !handler || !sock->SetNonBlocking(true)){
+		return false;
+	}
+
+	CConnection *conn = new CConnection();
+	conn->sock = std::move(sock);
+	conn->handler = std::move(handler);
+
+	post(conn, nullptr);
+	return true;
+}
+
+void CEventLoop::post(CConnection *conn, CLoop *current){
+	CLoop &target = *_loops[_next.fetch_add(1, std::memory_order_relaxed) % _loops.size()];
+	if (&target == current){
+		attach(target, conn);
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> scopelock(target.pending_lock);
+		target.pending.push_back(conn);
+	}
+	uint64_t one = 1;
+	ssize_t k = ::write(target.wake, &one, sizeof(one));
+	(void)k;
+}
+
+void CEventLoop::run(CLoop &loop){
+	struct epoll_event events[EVENT_LOOP_MAX_EVENTS];
+	t_current_loop = &loop;
+
+	while (_running.load(std::memory_order_relaxed)){
+		bool retrying = !loop.stalled.empty();
+		for (CListener &listener : _listeners){
+			retrying = retrying || (listener.loop == &loop && listener.retry);
+		}
+
+		int n = ::epoll_wait(loop.epoll, events, EVENT_LOOP_MAX_EVENTS, retrying ? EVENT_LOOP_RETRY_MS : -1);
+		if (n < 0){
+			if (errno == EINTR){
+				continue;
+			}
+			break;
+		}
+
+		for (int i = 0; i < n; ++i){
+			int fd = events[i].data.fd;
+			if (fd == loop.wake){
+				uint64_t value;
+				ssize_t k = ::read(loop.wake, &value, sizeof(value));
+				(void)k;
+				drain_pending(loop);
+				continue;
+			}
+
+			bool listener_fd = false;
+			for (CListener &listener : _listeners){
+				if (listener.loop == &loop && listener.server->get_handle() == fd){
+					listener.retry = false;
+					on_acceptable(loop, listener);
+					listener_fd = true;
+					break;
+				}
+			}
+			if (listener_fd){
+				continue;
+			}
+
+			auto itr = loop.connections.find(fd);
+			if (itr == loop.connections.end()){
+				continue;
+			}
+			CConnection &conn = *itr->second;
+			// read first, the peer may have sent data right before closing
+			if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)){
+				if (!on_readable(loop, conn)){
+					continue;
+				}
+			}
+			if (events[i].events & EPOLLOUT){
+				flush(loop, conn);
+			}
+		}
+
+		retry(loop);
+		flush_dirty(loop);
+	}
+
+	// connections die with their loop
+	for (auto &entry : loop.connections){
+		entry.second->output->shutdown();
+		entry.second->output->conn = nullptr;
+		entry.second->handler->on_close(*entry.second->sock);
+	}
+	_connections.fetch_sub(loop.connections.size(), std::memory_order_relaxed);
+	loop.connections.clear();
+	loop.dirty.clear();
+	std::lock_guard<std::mutex> scopelock(loop.pending_lock);
+	loop.flushes.clear();
+	t_current_loop = nullptr;
+}
+
+void CEventLoop::drain_pending(CLoop &loop){
+	std::vector<CConnection *> pending;
+	std::vector<std::shared_ptr<COutput>> flushes;
+	{
+		std::lock_guard<std::mutex> scopelock(loop.pending_lock);
+		pending.swap(loop.pending);
+		flushes.swap(loop.flushes);
+	}
+	for (CConnection *conn : pending){
+		attach(loop, conn);
+	}
+	// with this turn's own writes
+	loop.dirty.insert(loop.dirty.end(), flushes.begin(), flushes.end());
+}
+
+void CEventLoop::attach(CLoop &loop, CConnection *conn){
+	int fd = conn->sock->get_handle();
+	conn->sent = 0;
+	conn->writable = false;
+	conn->stalled = false;
+
+	struct epoll_event ev;
+	ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+	ev.data.fd = fd;
+	if (::epoll_ctl(loop.epoll, EPOLL_CTL_ADD, fd, &ev) != 0){
+		conn->handler->on_close(*conn->sock);
+		delete conn;
+		return;
+	}
+
+	conn->output = std::make_shared<COutput>(&loop, conn);
+	conn->handler->bind_writer(conn->output);
+	loop.connections[fd].reset(conn);
+	_connections.fetch_add(1, std::memory_order_relaxed);
+	conn->handler->on_open(*conn->sock);
+}
+
+bool CEventLoop::on_readable(CLoop &loop, CConnection &conn){
+	// edge-triggered: read until EAGAIN, no new edge comes for bytes left behind
+	for (;;){
+		size_t capacity = 0;
+		char *buffer = conn.handler->prepare_recv(capacity);
+		if (!buffer || capacity == 0){
+			// no room in the handler, bytes may be left: come back after EVENT_LOOP_RETRY_MS
+			if (!conn.stalled){
+				conn.stalled = true;
+				loop.stalled.push_back(conn.sock->get_handle());
+			}
+			return true;
+		}
+
+		size_t k = conn.sock->recv(buffer, capacity);
+		if (k > 0){
+			conn.handler->on_recv(*conn.sock, k);
+		}
+		if (!conn.sock->Valid()){
+			close_connection(loop, conn.sock->get_handle());
+			return false;
+		}
+		if (k < capacity){
+			// EAGAIN
+			return true;
+		}
+	}
+}
+
+void CEventLoop::on_acceptable(CLoop &loop, CListener &listener){
+	// edge-triggered: only EAGAIN may end this, anything else would leave the backlog without an edge
+	for (;;){
+		std::unique_ptr<CSocketTCP> sock = listener.server->accept();
+		if (!sock){
+			int err = errno;
+			if (err == EAGAIN || err == EWOULDBLOCK){
+				return;
+			}
+			if (err == EINTR || err == ECONNABORTED || err == EPROTO || err == EPERM){
+				// this connection failed, the next may not
+				continue;
+			}
+			if (err == EMFILE || err == ENFILE){
+				bool drained = false;
+				if (shed(loop, listener, drained)){
+					continue;
+				}
+				if (drained){
+					// out of descriptors still, accept would say so even with an empty backlog
+					return;
+				}
+			}
+			// out of memory or descriptors without a reserve, or the listener broke
+			listener.retry = true;
+			return;
+		}
+		std::shared_ptr<IStreamHandler> handler = listener.factory(*sock);
+		// accept4 hands out non-blocking sockets already
+		if (!handler || (!sock->IsNonBlocking() && !sock->SetNonBlocking(true))){
+			continue;
+		}
+
+		CConnection *conn = new CConnection();
+		conn->sock = std::move(sock);
+		conn->handler = std::move(handler);
+
+		if (listener.spread){
+			post(conn, &loop);
+		} else {
+			attach(loop, conn);
+		}
+	}
+}
+
+bool CEventLoop::shed(CLoop &loop, CListener &listener, bool &drained){
+	drained = false;
+	if (loop.reserve < 0){
+		loop.reserve = open_reserve();
+		return false;
+	}
+	::close(loop.reserve);
+	socket_t fd = ::accept(listener.server->get_handle(), nullptr, nullptr);
+	drained = fd < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+	if (fd >= 0){
+		// refused: better than a backlog nobody drains
+		::close(fd);
+	}
+	loop.reserve = open_reserve();
+	return fd >= 0;
+}
+
+void CEventLoop::retry(CLoop &loop){
+	for (CListener &listener : _listeners){
+		if (listener.loop == &loop && listener.retry){
+			listener.retry = false;
+			on_acceptable(loop, listener);
+		}
+	}
+
+	std::vector<int> stalled;
+	stalled.swap(loop.stalled);
+	for (int fd : stalled){
+		auto itr = loop.connections.find(fd);
+		if (itr != loop.connections.end() && itr->second->stalled){
+			itr->second->stalled = false;
+			on_readable(loop, *itr->second);
+		}
+	}
+}
+
+void CEventLoop::flush_dirty(CLoop &loop){
+	// flushing runs handlers, which may write again
+	std::vector<std::shared_ptr<COutput>> dirty;
+	while (!loop.dirty.empty()){
+		dirty.swap(loop.dirty);
+		for (auto &output : dirty){
+			if (output->conn){
+				flush(loop, *output->conn);
+			}
+		}
+		dirty.clear();
+	}
+}
+
+bool CEventLoop::flush(CLoop &loop, CConnection &conn){
+	int fd = conn.sock->get_handle();
+	for (;;){
+		if (conn.sent < conn.sending.size()){
+			size_t k = conn.sock->send(conn.sending.data() + conn.sent, conn.sending.size() - conn.sent);
+			conn.sent += k;
+			conn.output->sent(k);
+			if (!conn.sock->Valid()){
+				close_connection(loop, fd);
+				return false;
+			}
+			if (conn.sent < conn.sending.size()){
+				// socket full, EPOLLOUT brings the rest
+				if (!conn.writable && !set_writable(loop, conn, true)){
+					close_connection(loop, fd);
+					return false;
+				}
+				return true;
+			}
+		}
+		conn.sending.clear();
+		conn.sent = 0;
+		if (!conn.output->take(conn.sending)){
+			break;
+		}
+	}
+
+	if (conn.writable){
+		set_writable(loop, conn, false);
+		conn.handler->on_drain(*conn.sock);
+	}
+	if (conn.output->closing()){
+		close_connection(loop, fd);
+		return false;
+	}
+	return true;
+}
+
+bool CEventLoop::set_writable(CLoop &loop, CConnection &conn, bool writable){
+	struct epoll_event ev;
+	ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET | (writable ? (uint32_t)EPOLLOUT : 0u);
+	ev.data.fd = conn.sock->get_handle();
+	if (::epoll_ctl(loop.epoll, EPOLL_CTL_MOD, ev.data.fd, &ev) != 0){
+		return false;
+	}
+	conn.writable = writable;
+	return true;
+}
+
+void CEventLoop::close_connection(CLoop &loop, int fd){
+	auto itr = loop.connections.find(fd);
+	if (itr == loop.connections.end()){
+		return;
+	}
+	// writes fail from here, queued flushes find no connection
+	itr->second->output->shutdown();
+	itr->second->output->conn = nullptr;
+	itr->second->handler->on_close(*itr->second->sock);
+	::epoll_ctl(loop.epoll, EPOLL_CTL_DEL, fd, nullptr);
+	loop.connections.erase(itr);
+	_connections.fetch_sub(1, std::memory_order_relaxed);
+}
+
+}
+
+#endif // !WIN_SOCKET
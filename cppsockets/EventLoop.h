@@ -0,0 +1,125 @@
+#pragma once
+
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include "IOEngine.h"
+
+#ifndef WIN_SOCKET
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace sockets {
+
+	/*
+	* epoll reactor, edge-triggered
+	* owns every added CSocketTCP, switches it to non-blocking mode
+	* each loop thread has its own epoll set; connections are spread round robin
+	* and stay on one thread for their whole life
+	* output: IStreamHandler::write queues, the loop sends at the end of its turn,
+	* EPOLLOUT is armed only while the socket is full
+	* a handler without room (prepare_recv nullptr) and a listener out of descriptors
+	* are retried every EVENT_LOOP_RETRY_MS
+	* Listen() before Start(), Add() from any thread
+	*/
+	class CEventLoop : public CIOEngine {
+	public:
+		CEventLoop(int threads = 1);
+		virtual ~CEventLoop() override;
+
+		virtual bool Start() override;
+		virtual void Stop() override;
+
+		// accept on server from the first loop thread, connections are spread
+		virtual bool Listen(CSocketTCPServer &server, handler_factory_t factory) override;
+		virtual bool ListenOn(int thread, CSocketTCPServer &server, handler_factory_t factory) override;
+		virtual bool Add(std::unique_ptr<CSocketTCP> sock, std::shared_ptr<IStreamHandler> handler) override;
+
+		virtual size_t Connections() const override { return _connections.load(std::memory_order_relaxed); }
+		virtual int Threads() const override { return (int)_loops.size(); }
+		virtual const char *Name() const override { return "epoll"; }
+
+	protected:
+		struct CLoop;
+		struct COutput;
+
+		struct CConnection {
+			std::unique_ptr<CSocketTCP> sock;
+			std::shared_ptr<IStreamHandler> handler;
+			std::shared_ptr<COutput> output;
+			// taken from the output queue, sending[sent..] is left
+			std::vector<char> sending;
+			size_t sent;
+			// EPOLLOUT armed
+			bool writable;
+			// waits in CLoop::stalled
+			bool stalled;
+		};
+
+		struct CListener {
+			CSocketTCPServer *server;
+			handler_factory_t factory;
+			// loop that accepts
+			CLoop *loop;
+			// round robin over all loops, or stay on loop
+			bool spread;
+			// accept failed for lack of resources, try again after EVENT_LOOP_RETRY_MS
+			bool retry;
+		};
+
+		struct CLoop {
+			int epoll;
+			int wake;
+			// spare descriptor, given up to shed a connection when accept runs out of them
+			int reserve;
+			std::thread thread;
+			std::mutex pending_lock;
+			std::vector<CConnection *> pending;
+			// outputs written from other threads, under pending_lock
+			std::vector<std::shared_ptr<COutput>> flushes;
+			// loop thread only
+			std::unordered_map<int, std::unique_ptr<CConnection>> connections;
+			// outputs written on the loop thread during this turn
+			std::vector<std::shared_ptr<COutput>> dirty;
+			// connections whose handler had no room, by fd
+			std::vector<int> stalled;
+		};
+
+		void run(CLoop &loop);
+		// hand conn to the next loop, attached right away if that is current
+		void post(CConnection *conn, CLoop *current);
+		void attach(CLoop &loop, CConnection *conn);
+		// false if the connection was closed
+		bool on_readable(CLoop &loop, CConnection &conn);
+		void on_acceptable(CLoop &loop, CListener &listener);
+		// drop one pending connection through the reserve descriptor, drained: the backlog is empty
+		bool shed(CLoop &loop, CListener &listener, bool &drained);
+		// send what the output holds, false if the connection was closed
+		bool flush(CLoop &loop, CConnection &conn);
+		void flush_dirty(CLoop &loop);
+		void retry(CLoop &loop);
+		bool set_writable(CLoop &loop, CConnection &conn, bool writable);
+		void close_connection(CLoop &loop, int fd);
+		void drain_pending(CLoop &loop);
+		bool add_listener(CLoop &loop, CSocketTCPServer &server, handler_factory_t factory, bool spread);
+
+		std::vector<std::unique_ptr<CLoop>> _loops;
+		std::vector<CListener> _listeners;
+		std::atomic<bool> _running;
+		std::atomic<size_t> _next;
+		std::atomic<size_t> _connections;
+
+	private:
+		CEventLoop(const CEventLoop &);
+		CEventLoop &operator=(const CEventLoop &);
+	};
+
+}
+
+#endif // !WIN_SOCKET
+
+#endif
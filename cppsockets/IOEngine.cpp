@@ -0,0 +1,110 @@
+#include "IOEngine.h"
+#include "EventLoop.h"
+#include "UringLoop.h"
+
+namespace sockets {
+
+CStreamOutput::CStreamOutput(size_t limit)
+		: _inflight(0), _limit(limit), _kicked(false), _closing(false), _closed(false)
+{
+}
+
+bool CStreamOutput::write(const void *data, size_t count){
+	iovec_t slice;
+	slice.iov_base = (void *) data;
+	slice.iov_len = count;
+	return writev(&slice, 1);
+}
+
+bool CStreamOutput::writev(const iovec_t *iov, size_t iovcnt){
+	size_t bytes = 0;
+	for (size_t i = 0; i < iovcnt; ++i){
+		bytes += iov[i].iov_len;
+	}
+
+	std::lock_guard<std::mutex> scopelock(_lock);
+	if (_closed || _closing || _queue.size() + _inflight + bytes > _limit){
+		return false;
+	}
+	for (size_t i = 0; i < iovcnt; ++i){
+		const char *data = (const char *) iov[i].iov_base;
+		_queue.insert(_queue.end(), data, data + iov[i].iov_len);
+	}
+	if (!_kicked && bytes > 0){
+		_kicked = true;
+		kick();
+	}
+	return true;
+}
+
+void CStreamOutput::close(){
+	std::lock_guard<std::mutex> scopelock(_lock);
+	if (_closed || _closing){
+		return;
+	}
+	_closing = true;
+	if (!_kicked){
+		_kicked = true;
+		kick();
+	}
+}
+
+size_t CStreamOutput::pending() const {
+	std::lock_guard<std::mutex> scopelock(_lock);
+	return _queue.size() + _inflight;
+}
+
+bool CStreamOutput::valid() const {
+	std::lock_guard<std::mutex> scopelock(_lock);
+	return !_closed && !_closing;
+}
+
+bool CStreamOutput::take(std::vector<char> &out){
+	std::lock_guard<std::mutex> scopelock(_lock);
+	if (_queue.empty()){
+		// the next write kicks again
+		_kicked = false;
+		return false;
+	}
+	// out keeps its capacity for the next swap, no allocation once warm
+	out.swap(_queue);
+	_inflight += out.size();
+	return true;
+}
+
+void CStreamOutput::sent(size_t count){
+	std::lock_guard<std::mutex> scopelock(_lock);
+	_inflight -= count < _inflight ? count : _inflight;
+}
+
+bool CStreamOutput::closing() const {
+	std::lock_guard<std::mutex> scopelock(_lock);
+	return _closing;
+}
+
+void CStreamOutput::shutdown(){
+	std::lock_guard<std::mutex> scopelock(_lock);
+	_closed = true;
+	// no kick can reach the engine any more
+	_kicked = true;
+	_queue.clear();
+	_inflight = 0;
+}
+
+std::unique_ptr<CIOEngine> CIOEngine::Create(int threads, bool prefer_uring){
+#if !defined(WIN_SOCKET) && defined(__linux__)
+	if (prefer_uring && CUringLoop::Available()){
+		std::unique_ptr<CUringLoop> engine(new CUringLoop(threads));
+		if (engine->Valid()){
+			return std::unique_ptr<CIOEngine>(engine.release());
+		}
+	}
+#endif
+#ifndef WIN_SOCKET
+	return std::unique_ptr<CIOEngine>(new CEventLoop(threads));
+#else
+	return std::unique_ptr<CIOEngine>(nullptr);
+#endif
+}
+
+}
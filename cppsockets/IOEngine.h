@@ -0,0 +1,168 @@
+#pragma once
+
+#ifndef IO_ENGINE_H
+#define IO_ENGINE_H
+
+#include "SocketTCP.h"
+
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// bytes one connection may have queued for output, write fails beyond
+#ifndef STREAM_OUTPUT_LIMIT
+	#define STREAM_OUTPUT_LIMIT (64 * 1024 * 1024)
+#endif
+
+namespace sockets {
+
+	/*
+	* output of one engine connection, from any thread
+	* bytes are queued and leave from the loop thread that owns the connection,
+	* in order and whole, nothing is dropped when the socket is full
+	* write fails and queues nothing once the connection is closed or closing,
+	* or when the queue would pass STREAM_OUTPUT_LIMIT
+	*/
+	class IStreamWriter {
+	public:
+		virtual ~IStreamWriter() {}
+
+		virtual bool write(const void *data, size_t count) = 0;
+		virtual bool writev(const iovec_t *iov, size_t iovcnt) = 0;
+		bool writev(const CSendBatch &batch) { return writev(batch.data(), batch.size()); }
+		// close once everything queued went out
+		virtual void close() = 0;
+		// queued and in flight
+		virtual size_t pending() const = 0;
+		virtual bool valid() const = 0;
+	};
+
+	/*
+	* the queue behind IStreamWriter, engines derive from it
+	* writers append under a lock; the loop thread takes the whole queue and sends it
+	* kick() runs under the lock when the queue leaves the idle state, once until take() finds it empty:
+	* the engine schedules a flush on the loop thread
+	*/
+	class CStreamOutput : public IStreamWriter {
+	public:
+		CStreamOutput(size_t limit = STREAM_OUTPUT_LIMIT);
+
+		virtual bool write(const void *data, size_t count) override;
+		virtual bool writev(const iovec_t *iov, size_t iovcnt) override;
+		virtual void close() override;
+		virtual size_t pending() const override;
+		virtual bool valid() const override;
+
+		// --- loop thread ---
+		// the queue swapped into out (empty on entry); false and idle again if nothing is queued
+		bool take(std::vector<char> &out);
+		// count bytes handed out by take went out
+		void sent(size_t count);
+		bool closing() const;
+		// the connection is gone, later writes fail
+		void shutdown();
+
+	protected:
+		virtual void kick() = 0;
+
+		mutable std::mutex _lock;
+		std::vector<char> _queue;
+		size_t _inflight;
+		size_t _limit;
+		bool _kicked;
+		bool _closing;
+		bool _closed;
+	};
+
+	/*
+	* receiver of one connection in an io engine
+	* called on the loop thread that owns the connection, never from two threads at once
+	* the CSocketTCP & is valid during the call only; output goes through write(), never sock.send
+	*/
+	class IStreamHandler {
+	public:
+		virtual ~IStreamHandler() {}
+
+		// space for the next read, capacity > 0; bytes land here without an extra copy
+		virtual char *prepare_recv(size_t &capacity) = 0;
+		// count bytes were written into the prepare_recv buffer
+		virtual void on_recv(CSocketTCP &sock, size_t count) = 0;
+		/*
+		* count bytes in a buffer owned by the engine, valid until return
+		* engines with their own receive buffers (io_uring) call this instead of prepare_recv
+		* default copies into prepare_recv, override to consume in place
+		* @return false if not every byte was taken, the engine closes the connection
+		*/
+		virtual bool on_data(CSocketTCP &sock, char *data, size_t count){
+			while (count > 0){
+				size_t capacity = 0;
+				char *buffer = prepare_recv(capacity);
+				if (!buffer || capacity == 0){
+					// the buffer goes back to the kernel on return, the rest would be lost
+					return false;
+				}
+				size_t n = count < capacity ? count : capacity;
+				std::memcpy(buffer, data, n);
+				on_recv(sock, n);
+				data += n;
+				count -= n;
+			}
+			return true;
+		}
+		// peer closed or error, the socket is closed right after
+		virtual void on_close(CSocketTCP &) {}
+		// attached to its loop, write works from here on
+		virtual void on_open(CSocketTCP &) {}
+		// the output queue ran empty after the socket had been full
+		virtual void on_drain(CSocketTCP &) {}
+
+		// queue output, thread safe, see IStreamWriter
+		bool write(const void *data, size_t count) { return _writer && _writer->write(data, count); }
+		bool writev(const iovec_t *iov, size_t iovcnt) { return _writer && _writer->writev(iov, iovcnt); }
+		bool writev(const CSendBatch &batch) { return writev(batch.data(), batch.size()); }
+		// keep it to write after the callback returned, e.g. from another thread
+		const std::shared_ptr<IStreamWriter> &writer() const { return _writer; }
+
+		// engine side, before on_open
+		void bind_writer(std::shared_ptr<IStreamWriter> writer) { _writer = std::move(writer); }
+
+	private:
+		std::shared_ptr<IStreamWriter> _writer;
+	};
+
+	typedef std::function<std::shared_ptr<IStreamHandler>(CSocketTCP &)> handler_factory_t;
+
+	/*
+	* common face of the reactors: CEventLoop (epoll), CUringLoop (io_uring)
+	* the engine owns every added CSocketTCP
+	* Listen() before Start(), Add() from any thread
+	*/
+	class CIOEngine {
+	public:
+		virtual ~CIOEngine() {}
+
+		virtual bool Start() = 0;
+		virtual void Stop() = 0;
+
+		// accept on server (already Listen()ed), server is not owned
+		virtual bool Listen(CSocketTCPServer &server, handler_factory_t factory) = 0;
+		// accept on loop thread `thread` only, its connections stay on that thread
+		virtual bool ListenOn(int thread, CSocketTCPServer &server, handler_factory_t factory) = 0;
+		// hand over a connected socket
+		virtual bool Add(std::unique_ptr<CSocketTCP> sock, std::shared_ptr<IStreamHandler> handler) = 0;
+
+		virtual size_t Connections() const = 0;
+		virtual int Threads() const = 0;
+		virtual const char *Name() const = 0;
+
+		/*
+		* io_uring when the kernel supports what CUringLoop needs, epoll otherwise
+		*/
+		static std::unique_ptr<CIOEngine> Create(int threads = 1, bool prefer_uring = true);
+	};
+
+}
+
+#endif
@@ -0,0 +1,225 @@
+#include "Resolver.h"
+
+#ifndef WIN_SOCKET
+	#include <netdb.h>
+	#include <arpa/inet.h>
+	#include <sys/socket.h>
+	#include <netinet/in.h>
+#endif
+
+#include <chrono>
+#include <cstring>
+
+// the cache is never swept below this size
+#define RESOLVER_SWEEP_MIN 64
+
+namespace sockets {
+
+CResolver &CResolver::Get(){
+	static CResolver resolver;
+	return resolver;
+}
+
+CResolver::CResolver()
+		: _sweep_at(RESOLVER_SWEEP_MIN), _ttl_ms(RESOLVER_CACHE_TTL_MS), _negative_ttl_ms(RESOLVER_NEGATIVE_TTL_MS), _stop(false)
+{
+}
+
+CResolver::~CResolver(){
+	{
+		std::lock_guard<std::mutex> scopelock(_lock);
+		_stop = true;
+	}
+	_wake.notify_all();
+	if (_thread.joinable()){
+		_thread.join();
+	}
+}
+
+uint64_t CResolver::now_ms(){
+	return (uint64_t) std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool CResolver::parse_numeric(const std::string &host, in_addr_t &address){
+#ifdef WIN_SOCKET
+	in_addr_t value = ::inet_addr(host.c_str());
+	if (value == INADDR_NONE && host != "255.255.255.255"){
+		return false;
+	}
+	address = value;
+	return true;
+#else
+	struct in_addr addr;
+	if (::inet_pton(AF_INET, host.c_str(), &addr) != 1){
+		return false;
+	}
+	address = addr.s_addr;
+	return true;
+#endif
+}
+
+bool CResolver::lookup(const std::string &host, in_addr_t &address){
+#ifdef WIN_SOCKET
+	struct hostent *h = ::gethostbyname(host.c_str());
+	if (!h || h->h_addrtype != AF_INET){
+		return false;
+	}
+	std::memcpy(&address, h->h_addr_list[0], sizeof(address));
+	return true;
+#else
+	struct addrinfo hints;
+	std::memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+
+	struct addrinfo *result = nullptr;
+	if (::getaddrinfo(host.c_str(), nullptr, &hints, &result) != 0 || !result){
+		return false;
+	}
+	address = ((struct sockaddr_in *) result->ai_addr)->sin_addr.s_addr;
+	::freeaddrinfo(result);
+	return true;
+#endif
+}
+
+bool CResolver::find(const std::string &host, in_addr_t &address, bool &ok){
+	auto itr = _cache.find(host);
+	if (itr == _cache.end()){
+		return false;
+	}
+	if (itr->second.expire_ms <= now_ms()){
+		_cache.erase(itr);
+		return false;
+	}
+	address = itr->second.address;
+	ok = itr->second.ok;
+	return true;
+}
+
+void CResolver::store(const std::string &host, bool ok, in_addr_t address){
+	const uint64_t now = now_ms();
+	CEntry entry;
+	entry.address = address;
+	entry.ok = ok;
+	entry.expire_ms = now + (ok ? _ttl_ms : _negative_ttl_ms);
+	_cache[host] = entry;
+
+	// names asked once are never found again, drop the expired ones, amortized O(1)
+	if (_cache.size() >= _sweep_at){
+		for (auto itr = _cache.begin(); itr != _cache.end();){
+			if (itr->second.expire_ms <= now){
+				itr = _cache.erase(itr);
+			} else {
+				++itr;
+			}
+		}
+		_sweep_at = _cache.size() * 2 > RESOLVER_SWEEP_MIN ? _cache.size() * 2 : RESOLVER_SWEEP_MIN;
+	}
+}
+
+bool CResolver::resolve(const std::string &host, in_addr_t &address){
+	if (parse_numeric(host, address)){
+		return true;
+	}
+	std::unique_lock<std::mutex> scopelock(_lock);
+	for (;;){
+		bool ok = false;
+		if (find(host, address, ok)){
+			return ok;
+		}
+		// the first miss looks up, the others wait for its result
+		if (_inflight.insert(host).second){
+			break;
+		}
+		_resolved.wait(scopelock);
+	}
+
+	// not under the lock, other names keep resolving meanwhile
+	scopelock.unlock();
+	bool ok = lookup(host, address);
+	scopelock.lock();
+	store(host, ok, address);
+	_inflight.erase(host);
+	scopelock.unlock();
+	_resolved.notify_all();
+	return ok;
+}
+
+void CResolver::resolve_async(const std::string &host, callback_t callback){
+	in_addr_t address = 0;
+	if (parse_numeric(host, address)){
+		callback(true, address);
+		return;
+	}
+
+	bool ok = false;
+	{
+		std::lock_guard<std::mutex> scopelock(_lock);
+		if (!find(host, address, ok)){
+			std::vector<callback_t> &waiting = _waiting[host];
+			waiting.push_back(std::move(callback));
+			// the first request of a name queues the lookup
+			if (waiting.size() == 1){
+				_queue.push_back(host);
+			}
+			if (!_thread.joinable()){
+				_thread = std::thread([this](){ run(); });
+			}
+			_wake.notify_one();
+			return;
+		}
+	}
+	// cache hit, user code runs outside the lock
+	callback(ok, ok ? address : 0);
+}
+
+void CResolver::run(){
+	std::unique_lock<std::mutex> scopelock(_lock);
+	for (;;){
+		_wake.wait(scopelock, [this](){ return _stop || !_queue.empty(); });
+		if (_stop){
+			break;
+		}
+		std::string host = std::move(_queue.front());
+		_queue.pop_front();
+		// resolve() callers of this name wait for us, unless one of them is already looking up
+		const bool owner = _inflight.insert(host).second;
+
+		scopelock.unlock();
+		in_addr_t address = 0;
+		bool ok = lookup(host, address);
+		scopelock.lock();
+
+		store(host, ok, address);
+		if (owner){
+			_inflight.erase(host);
+			_resolved.notify_all();
+		}
+		std::vector<callback_t> waiting;
+		auto itr = _waiting.find(host);
+		if (itr != _waiting.end()){
+			waiting.swap(itr->second);
+			_waiting.erase(itr);
+		}
+
+		scopelock.unlock();
+		for (callback_t &callback : waiting){
+			callback(ok, ok ? address : 0);
+		}
+		scopelock.lock();
+	}
+}
+
+void CResolver::set_ttl(uint32_t ttl_ms, uint32_t negative_ttl_ms){
+	std::lock_guard<std::mutex> scopelock(_lock);
+	_ttl_ms = ttl_ms;
+	_negative_ttl_ms = negative_ttl_ms;
+}
+
+void CResolver::clear(){
+	std::lock_guard<std::mutex> scopelock(_lock);
+	_cache.clear();
+}
+
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include "Address.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <stdint.h>
+
+// how long a resolved name is reused, getaddrinfo does not report the dns ttl
+#ifndef RESOLVER_CACHE_TTL_MS
+	#define RESOLVER_CACHE_TTL_MS 30000
+#endif
+
+// how long a failed name is not asked again
+#ifndef RESOLVER_NEGATIVE_TTL_MS
+	#define RESOLVER_NEGATIVE_TTL_MS 5000
+#endif
+
+namespace sockets {
+
+	/*
+	* name -> ipv4 resolution for CAddressIPv4, thread safe
+	*	numeric "a.b.c.d":	inet_pton, no lookup, no cache
+	*	names:				getaddrinfo, results cached for the ttl, failures for the negative ttl
+	* resolve() looks up on the calling thread when the cache misses,
+	* resolve_async() on one helper thread; concurrent requests for one name share a lookup,
+	* a resolve() that finds the name in flight waits for that lookup
+	* expired entries are swept by store once the cache doubled since the last sweep
+	* addresses are in network byte order
+	*/
+	class CResolver {
+	public:
+		typedef std::function<void(bool ok, in_addr_t address)> callback_t;
+
+		static CResolver &Get();
+
+		CResolver();
+		virtual ~CResolver();
+
+		bool resolve(const std::string &host, in_addr_t &address);
+		// callback runs right away on a fast path or cache hit, otherwise on the helper thread
+		void resolve_async(const std::string &host, callback_t callback);
+
+		// numeric form only, never blocks
+		static bool parse_numeric(const std::string &host, in_addr_t &address);
+
+		void set_ttl(uint32_t ttl_ms, uint32_t negative_ttl_ms);
+		void clear();
+
+	protected:
+		struct CEntry {
+			in_addr_t address;
+			bool ok;
+			uint64_t expire_ms;
+		};
+
+		static uint64_t now_ms();
+		static bool lookup(const std::string &host, in_addr_t &address);
+
+		bool find(const std::string &host, in_addr_t &address, bool &ok);
+		void store(const std::string &host, bool ok, in_addr_t address);
+		void run();
+
+		std::mutex _lock;
+		std::unordered_map<std::string, CEntry> _cache;
+		size_t _sweep_at;
+		uint32_t _ttl_ms, _negative_ttl_ms;
+
+		// names being looked up, resolve() waits on _resolved for them
+		std::unordered_set<std::string> _inflight;
+		std::condition_variable _resolved;
+
+		// helper thread, started by the first resolve_async
+		std::condition_variable _wake;
+		std::deque<std::string> _queue;
+		std::unordered_map<std::string, std::vector<callback_t>> _waiting;
+		std::thread _thread;
+		bool _stop;
+
+	private:
+		CResolver(const CResolver &);
+		CResolver &operator=(const CResolver &);
+	};
+
+}
+
+#endif
@@ -0,0 +1,73 @@
+#include "ReusePortServer.h"
+
+#ifndef WIN_SOCKET
+	#include <sys/socket.h>
+#endif
+
+#include <thread>
+
+namespace sockets {
+
+CReusePortServer::CReusePortServer(CAddressIPv4 source, int listeners, const CSocketOptions &options)
+		: _source(source), _options(options), _count(listeners)
+{
+	if (_count <= 0){
+		_count = (int)std::thread::hardware_concurrency();
+	}
+	if (_count <= 0){
+		_count = 1;
+	}
+#ifdef SO_REUSEPORT
+	_options.reuse_port = 1;
+#else
+	_count = 1;
+#endif
+}
+
+CReusePortServer::~CReusePortServer(){
+	Close();
+}
+
+bool CReusePortServer::Open(){
+	Close();
+	for (int i = 0; i < _count; ++i){
+		std::unique_ptr<CSocketTCPServer> server(new CSocketTCPServer(_source, _options));
+		server->Open();
+		if (!server->Valid()){
+			Close();
+			return false;
+		}
+		_listeners.push_back(std::move(server));
+	}
+	return true;
+}
+
+void CReusePortServer::Close(){
+	_listeners.clear();
+}
+
+bool CReusePortServer::Valid(){
+	if (_listeners.empty()){
+		return false;
+	}
+	for (auto &server : _listeners){
+		if (!server->Valid()){
+			return false;
+		}
+	}
+	return true;
+}
+
+bool CReusePortServer::Attach(CIOEngine &engine, handler_factory_t factory){
+	if (!Valid() || engine.Threads() < 1){
+		return false;
+	}
+	for (size_t i = 0; i < _listeners.size(); ++i){
+		if (!engine.ListenOn((int)(i % engine.Threads()), *_listeners[i], factory)){
+			return false;
+		}
+	}
+	return true;
+}
+
+}
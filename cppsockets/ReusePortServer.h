@@ -0,0 +1,45 @@
+#pragma once
+
+#ifndef REUSE_PORT_SERVER_H
+#define REUSE_PORT_SERVER_H
+
+#include "IOEngine.h"
+
+#include <vector>
+
+namespace sockets {
+
+	/*
+	* one SO_REUSEPORT listener per worker on the same address,
+	* the kernel spreads new connections over them, no shared accept queue
+	* Attach() gives listener i to engine thread i % Threads() and its connections stay there
+	* without SO_REUSEPORT there is a single listener
+	*/
+	class CReusePortServer {
+	protected:
+		CAddressIPv4 _source;
+		CSocketOptions _options;
+		std::vector<std::unique_ptr<CSocketTCPServer>> _listeners;
+		int _count;
+	public:
+		// listeners == 0: one per hardware thread
+		CReusePortServer(CAddressIPv4 source, int listeners = 0, const CSocketOptions &options = CSocketOptions());
+		CReusePortServer(int port, int listeners = 0, const CSocketOptions &options = CSocketOptions())
+			: CReusePortServer(CAddressIPv4("0.0.0.0", port), listeners, options) {}
+		virtual ~CReusePortServer();
+
+		// all listeners or none
+		bool Open();
+		void Close();
+		bool Valid();
+
+		int Listeners() const { return (int)_listeners.size(); }
+		CSocketTCPServer &Listener(int index) { return *_listeners[index]; }
+
+		// every listener to its own engine thread, before engine.Start()
+		bool Attach(CIOEngine &engine, handler_factory_t factory);
+	};
+
+}
+
+#endif
@@ -1,6 +1,7 @@
 #include "Socket.h"
 
 #include <stdio.h>
+#include <algorithm>
 
 namespace sockets {
 
@@ -24,98 +25,196 @@ bool release_sockets(){
 
 // streambuf_socket //
 
-CStreambufSocket::CStreambufSocket(CSocket &sock){
+CStreambufSocket::CStreambufSocket(CSocket &sock, size_t read_size, size_t write_size){
 	_sock = &sock;
-	_buf = EOF;
+	_read_size = read_size;
+	_write_size = write_size;
+	setg(nullptr, nullptr, nullptr);
+	setp(nullptr, nullptr);
+}
+
+bool CStreambufSocket::resize(size_t read_size, size_t write_size){
+	if (!_flush()){
+		return false;
+	}
+	size_t pending = egptr() - gptr();
+	if (pending > read_size){
+		return false;
+	}
+
+	_read_size = read_size;
+	_write_size = write_size;
+	if (pending > 0){
+		std::vector<char> buf(read_size);
+		std::copy(gptr(), egptr(), buf.begin());
+		_rbuf.swap(buf);
+		setg(_rbuf.data(), _rbuf.data(), _rbuf.data() + pending);
+	} else {
+		std::vector<char>().swap(_rbuf);
+		setg(nullptr, nullptr, nullptr);
+	}
+	std::vector<char>().swap(_wbuf);
+	setp(nullptr, nullptr);
+	return true;
+}
+
+bool CStreambufSocket::_flush(){
+	size_t count = pptr() - pbase();
+	if (count == 0){
+		return true;
+	}
+	size_t sent = _sock->send(pbase(), count);
+	if (sent < count){
+		// keep what did not leave, a non-blocking socket may take it later
+		std::copy(pbase() + sent, pptr(), pbase());
+		setp(pbase(), epptr());
+		pbump((int)(count - sent));
+		return false;
+	}
+	setp(pbase(), epptr());
+	return true;
 }
 
 int CStreambufSocket::sync(){
 #ifdef _DEBUG_
 		LOG << __FUNCTION__ << endl;
 #endif
-		return 0;
+		return _flush() ? 0 : -1;
 }
 
 streamsize CStreambufSocket::showmanyc(){
 #ifdef _DEBUG_
 	LOG << __FUNCTION__ << endl;
 #endif
-	return _buf != EOF ? 1 : 0;
+	return egptr() - gptr();
 }
 
 streamsize CStreambufSocket::xsgetn(char *s, streamsize n){
 #ifdef _DEBUG_
 	LOG << __FUNCTION__ << endl;
 #endif
-	streamsize sz = _sock->recv(s, n);
-	_buf = EOF;
-	return sz;
-}
+	streamsize done = 0;
+	while (done < n){
+		streamsize avail = egptr() - gptr();
+		if (avail > 0){
+			streamsize k = avail < n - done ? avail : n - done;
+			std::copy(gptr(), gptr() + k, s + done);
+			gbump((int)k);
+			done += k;
+			continue;
+		}
 
-int CStreambufSocket::_uflow(){
-#ifdef _DEBUG_
-	LOG << __FUNCTION__ << endl;
-#endif
-	char c;
-	if (_sock->recv(&c, sizeof(c)) == sizeof(c)){
-		_buf = c;
-	} else {
-		_buf = EOF;
+		if ((size_t)(n - done) >= _read_size){
+			// large read, straight into the caller
+			if (!_flush()){
+				break;
+			}
+			size_t k = _sock->recv(s + done, (size_t)(n - done));
+			done += (streamsize)k;
+			break;
+		}
+
+		if (underflow() == EOF){
+			break;
+		}
 	}
-	
-	return _buf;
+	return done;
 }
 
 int CStreambufSocket::underflow(){
 #ifdef _DEBUG_
 	LOG << __FUNCTION__ << endl;
 #endif
-	if (_buf == EOF){
-		return _uflow();
+	if (gptr() < egptr()){
+		return traits_type::to_int_type(*gptr());
+	}
+	// the peer may wait for our request before it answers
+	if (!_flush()){
+		return EOF;
 	}
-	return _buf;
-}
 
-int CStreambufSocket::uflow(){
-#ifdef _DEBUG_
-		LOG << __FUNCTION__ << endl;
-#endif
-	int c = _buf;
-	if (c == EOF){
-		c = _uflow();
-		if (c == EOF){
-			return EOF;
-		}
+	size_t size = _read_size > 0 ? _read_size : 1;
+	if (_rbuf.size() != size){
+		_rbuf.resize(size);
 	}
-	
-	_buf = EOF;
-	
-	return c;
+	size_t k = _sock->recv_some(_rbuf.data(), size);
+	if (k == 0){
+		setg(nullptr, nullptr, nullptr);
+		return EOF;
+	}
+	setg(_rbuf.data(), _rbuf.data(), _rbuf.data() + k);
+	return traits_type::to_int_type(*gptr());
 }
 
 int CStreambufSocket::pbackfail(int c){
 #ifdef _DEBUG_
 	LOG << __FUNCTION__ << endl;
 #endif
-	return EOF;
+	if (gptr() == eback()){
+		return EOF;
+	}
+	gbump(-1);
+	if (c != EOF){
+		*gptr() = traits_type::to_char_type(c);
+		return c;
+	}
+	return traits_type::not_eof(c);
 }
 
 streamsize CStreambufSocket::xsputn(const char *s, streamsize n){
 #ifdef _DEBUG_
 	LOG << __FUNCTION__ << endl;
 #endif
-	return _sock->send(s, n);
+	if ((size_t)n >= _write_size){
+		// large write, straight from the caller
+		if (!_flush()){
+			return 0;
+		}
+		return (streamsize)_sock->send(s, (size_t)n);
+	}
+
+	streamsize done = 0;
+	while (done < n){
+		streamsize room = epptr() - pptr();
+		if (room == 0){
+			if (overflow(traits_type::to_int_type(s[done])) == EOF){
+				break;
+			}
+			++done;
+			continue;
+		}
+		streamsize k = room < n - done ? room : n - done;
+		std::copy(s + done, s + done + k, pptr());
+		pbump((int)k);
+		done += k;
+	}
+	return done;
 }
 
 int CStreambufSocket::overflow(int c){
 #ifdef _DEBUG_
 	LOG << __FUNCTION__ << endl;
 #endif
-	if (c != EOF && _sock->send((char) c) == sizeof(char)){
-		return c;
+	if (!_flush()){
+		return EOF;
+	}
+	if (_write_size == 0){
+		char ch = traits_type::to_char_type(c);
+		if (c != EOF && _sock->send(&ch, sizeof(ch)) != sizeof(ch)){
+			return EOF;
+		}
+		return traits_type::not_eof(c);
 	}
-	return EOF;
-}
 
+	if (_wbuf.size() != _write_size){
+		_wbuf.resize(_write_size);
+		setp(_wbuf.data(), _wbuf.data() + _wbuf.size());
+	}
+	if (c != EOF){
+		*pptr() = traits_type::to_char_type(c);
+		pbump(1);
+	}
+	return traits_type::not_eof(c);
 }
 
+}
@@ -7,6 +7,7 @@
 #include <string>
 #include <sstream>
 #include <memory>
+#include <vector>
 
 #include "Address.h"
 
@@ -16,6 +17,11 @@ using namespace std;
 #define LOG cerr << ">>> "
 #endif
 
+// default read and write buffer of the iostream interface
+#ifndef SOCKET_STREAM_BUFFER_SIZE
+	#define SOCKET_STREAM_BUFFER_SIZE (64 * 1024)
+#endif
+
 namespace sockets {
 	using std::streambuf;
 	using std::streamsize;
@@ -23,13 +29,22 @@ namespace sockets {
 
 	class CSocket;
 
+	/*
+	* buffered streambuf behind the iostream interface of CSocket
+	* buffers are allocated on first stream use, size 0 means unbuffered
+	* transfers of at least one buffer size go straight to the socket
+	* output leaves on flush / sync, when the write buffer is full,
+	* before a read refills the input, and on Close
+	* bytes already in the read buffer are not seen by CSocket::recv
+	*/
 	class CStreambufSocket : virtual public streambuf {
 	private:
-		int _buf;
+		std::vector<char> _rbuf, _wbuf;
+		size_t _read_size, _write_size;
 
 		CStreambufSocket() {};
 
-		int _uflow();
+		bool _flush();
 	protected:
 		CSocket *_sock;
 
@@ -39,14 +54,17 @@ namespace sockets {
 
 		virtual streamsize xsgetn(char *s, streamsize n) override;
 		virtual int underflow() override;
-		virtual int uflow() override;
 		virtual int pbackfail(int c) override;
 
 		virtual streamsize xsputn(const char *s, streamsize n) override;
 		virtual int overflow(int c) override;
 	public:
-		CStreambufSocket(CSocket &sock);
+		CStreambufSocket(CSocket &sock, size_t read_size = SOCKET_STREAM_BUFFER_SIZE, size_t write_size = SOCKET_STREAM_BUFFER_SIZE);
 		virtual ~CStreambufSocket() {}
+
+		// pending output is sent first, buffered input is kept if it fits
+		bool resize(size_t read_size, size_t write_size);
+		size_t pending_output() const { return pptr() - pbase(); }
 	};
 
 	class CSocket : public iostream {
@@ -58,6 +76,11 @@ namespace sockets {
 
 		virtual size_t recv(void *data, size_t count) = 0;
 		virtual size_t send(const void *data, size_t count) = 0;
+		// at least one byte unless closed, as many as one read returns; fills the stream buffer
+		virtual size_t recv_some(void *data, size_t count) { return recv(data, count > 0 ? 1 : 0); }
+
+		// read and write buffer of the iostream interface
+		bool SetStreamBuffer(size_t read_size, size_t write_size) { return _streambuf.resize(read_size, write_size); }
 
 		virtual const IAddress &get_source_address() = 0;
 		virtual const IAddress &get_dest_address() = 0;
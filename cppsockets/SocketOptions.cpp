@@ -0,0 +1,74 @@
+#include "SocketOptions.h"
+
+#ifndef WIN_SOCKET
+	#include <sys/socket.h>
+	#include <netinet/in.h>
+	#include <netinet/tcp.h>
+#endif
+
+namespace sockets {
+
+static bool set_option(socket_t sock, int level, int name, int value){
+	if (value < 0){
+		return true;
+	}
+	return ::setsockopt(sock, level, name, (const char *) &value, sizeof(value)) != SOCKET_ERROR;
+}
+
+CSocketOptions::CSocketOptions()
+		: no_delay(-1), recv_buffer(-1), send_buffer(-1), reuse_addr(-1), reuse_port(-1),
+		  quick_ack(-1), defer_accept(-1), busy_poll(-1), user_timeout(-1), backlog(SOMAXCONN)
+{
+}
+
+CSocketOptions CSocketOptions::LowLatency(){
+	CSocketOptions options;
+	options.no_delay = 1;
+	options.quick_ack = 1;
+	return options;
+}
+
+bool CSocketOptions::apply_listener(socket_t sock) const{
+	// a restarted server binds again despite TIME_WAIT
+	bool ok = set_option(sock, SOL_SOCKET, SO_REUSEADDR, reuse_addr < 0 ? 1 : reuse_addr);
+#ifdef SO_REUSEPORT
+	ok = set_option(sock, SOL_SOCKET, SO_REUSEPORT, reuse_port) && ok;
+#endif
+	ok = set_option(sock, SOL_SOCKET, SO_RCVBUF, recv_buffer) && ok;
+#ifdef TCP_DEFER_ACCEPT
+	ok = set_option(sock, IPPROTO_TCP, TCP_DEFER_ACCEPT, defer_accept) && ok;
+#endif
+	return ok;
+}
+
+bool CSocketOptions::apply_connection(socket_t sock) const{
+	bool ok = set_option(sock, IPPROTO_TCP, TCP_NODELAY, no_delay);
+	ok = set_option(sock, SOL_SOCKET, SO_RCVBUF, recv_buffer) && ok;
+	ok = set_option(sock, SOL_SOCKET, SO_SNDBUF, send_buffer) && ok;
+#ifdef TCP_QUICKACK
+	ok = set_option(sock, IPPROTO_TCP, TCP_QUICKACK, quick_ack) && ok;
+#endif
+#ifdef SO_BUSY_POLL
+	ok = set_option(sock, SOL_SOCKET, SO_BUSY_POLL, busy_poll) && ok;
+#endif
+#ifdef TCP_USER_TIMEOUT
+	ok = set_option(sock, IPPROTO_TCP, TCP_USER_TIMEOUT, user_timeout) && ok;
+#endif
+	return ok;
+}
+
+bool CSocketOptions::apply_datagram(socket_t sock) const{
+	// only when asked: on udp it lets another socket bind the same port and take the datagrams
+	bool ok = set_option(sock, SOL_SOCKET, SO_REUSEADDR, reuse_addr);
+#ifdef SO_REUSEPORT
+	ok = set_option(sock, SOL_SOCKET, SO_REUSEPORT, reuse_port) && ok;
+#endif
+	ok = set_option(sock, SOL_SOCKET, SO_RCVBUF, recv_buffer) && ok;
+	ok = set_option(sock, SOL_SOCKET, SO_SNDBUF, send_buffer) && ok;
+#ifdef SO_BUSY_POLL
+	ok = set_option(sock, SOL_SOCKET, SO_BUSY_POLL, busy_poll) && ok;
+#endif
+	return ok;
+}
+
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#ifndef SOCKET_OPTIONS_H
+#define SOCKET_OPTIONS_H
+
+#include "SocketType.h"
+
+namespace sockets {
+
+	/*
+	* tuning knobs of a tcp socket, applied when it is opened, listens or is accepted
+	* -1 leaves the system default, options the platform lacks are skipped
+	* listener:	reuse_addr, reuse_port, defer_accept, backlog, recv_buffer (inherited by accepted sockets)
+	* connection:	no_delay, quick_ack, busy_poll, user_timeout, recv_buffer, send_buffer
+	* datagram:	reuse_addr, reuse_port, busy_poll, recv_buffer, send_buffer
+	*/
+	struct CSocketOptions {
+		int no_delay;		// TCP_NODELAY, 1 = no Nagle
+		int recv_buffer;	// SO_RCVBUF bytes
+		int send_buffer;	// SO_SNDBUF bytes
+		int reuse_addr;		// SO_REUSEADDR, -1: on for listeners, off for datagram sockets (binds would share the port)
+		int reuse_port;		// SO_REUSEPORT, several listeners on one port
+		int quick_ack;		// TCP_QUICKACK, linux, not sticky: the kernel may return to delayed acks
+		int defer_accept;	// TCP_DEFER_ACCEPT seconds, linux
+		int busy_poll;		// SO_BUSY_POLL microseconds, linux
+		int user_timeout;	// TCP_USER_TIMEOUT milliseconds, linux
+		int backlog;		// listen() queue
+
+		CSocketOptions();
+
+		// low latency preset: no Nagle, quick acks
+		static CSocketOptions LowLatency();
+
+		// false if the platform rejected an option that was asked for
+		bool apply_listener(socket_t sock) const;
+		bool apply_connection(socket_t sock) const;
+		bool apply_datagram(socket_t sock) const;
+	};
+
+}
+
+#endif
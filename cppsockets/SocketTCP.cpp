@@ -1,9 +1,18 @@
 #ifndef WIN_SOCKET
 	#include <unistd.h>
+	#include <fcntl.h>
+	#include <errno.h>
+	#include <sys/socket.h>
 #endif
 
+#include <cstring>
+
 #include "SocketTCP.h"
 
+#ifndef MSG_NOSIGNAL
+	#define MSG_NOSIGNAL 0
+#endif
+
 namespace sockets {
 
 CSocketTCP::CSocketTCP(socket_t sock, struct sockaddr_in source, struct sockaddr_in dest){
@@ -11,12 +20,15 @@ CSocketTCP::CSocketTCP(socket_t sock, struct sockaddr_in source, struct sockaddr
 	_source = CAddressIPv4(source);
 	_dest = CAddressIPv4(dest);
 	_valid = true;
+	_nonblocking = false;
 }
 
-CSocketTCP::CSocketTCP(CAddressIPv4 dest){
+CSocketTCP::CSocketTCP(CAddressIPv4 dest, const CSocketOptions &options){
 	_socket = INVALID_SOCKET;
 	_dest = dest;
+	_options = options;
 	_valid = false;
+	_nonblocking = false;
 }
 
 CSocketTCP::~CSocketTCP(){
@@ -28,6 +40,12 @@ size_t CSocketTCP::recv(void *data, size_t count){
 		size_t l = 0;
 		while (l < count){
 			int k = (int)::recv(_socket, ((char *) data + l), count - l, 0);
+			if (k < 0 && errno == EINTR){
+				continue;
+			}
+			if (k < 0 && _nonblocking && (errno == EAGAIN || errno == EWOULDBLOCK)){
+				return l;
+			}
 			if (k <= 0){
 				_valid = false;
 				return l;
@@ -39,11 +57,37 @@ size_t CSocketTCP::recv(void *data, size_t count){
 	return 0;
 }
 
+size_t CSocketTCP::recv_some(void *data, size_t count){
+	if (Valid() && count > 0){
+		for (;;){
+			int k = (int)::recv(_socket, (char *) data, count, 0);
+			if (k < 0 && errno == EINTR){
+				continue;
+			}
+			if (k < 0 && _nonblocking && (errno == EAGAIN || errno == EWOULDBLOCK)){
+				return 0;
+			}
+			if (k <= 0){
+				_valid = false;
+				return 0;
+			}
+			return k;
+		}
+	}
+	return 0;
+}
+
 size_t CSocketTCP::send(const void *data, size_t count){
 	if (Valid()){
 		size_t l = 0;
 		while (l < count){
-			int k = (int)::send(_socket, ((const char *) data + l), count - l, 0);
+			int k = (int)::send(_socket, ((const char *) data + l), count - l, MSG_NOSIGNAL);
+			if (k < 0 && errno == EINTR){
+				continue;
+			}
+			if (k < 0 && _nonblocking && (errno == EAGAIN || errno == EWOULDBLOCK)){
+				return l;
+			}
 			if (k <= 0){
 				_valid = false;
 				return l;
@@ -55,6 +99,102 @@ size_t CSocketTCP::send(const void *data, size_t count){
 	return 0;
 }
 
+size_t CSocketTCP::sendv(const iovec_t *iov, size_t iovcnt){
+	if (!Valid()){
+		return 0;
+	}
+#ifdef WIN_SOCKET
+	size_t l = 0;
+	for (size_t i = 0; i < iovcnt; ++i){
+		size_t k = send(iov[i].iov_base, iov[i].iov_len);
+		l += k;
+		if (k < iov[i].iov_len){
+			break;
+		}
+	}
+	return l;
+#else
+	iovec_t window[SOCKET_TCP_IOV_MAX];
+	size_t l = 0;
+	size_t index = 0;
+	// bytes of iov[index] already sent
+	size_t offset = 0;
+	for (;;){
+		while (index < iovcnt && iov[index].iov_len == offset){
+			++index;
+			offset = 0;
+		}
+		if (index >= iovcnt){
+			return l;
+		}
+
+		size_t n = 0;
+		for (size_t i = index; i < iovcnt && n < SOCKET_TCP_IOV_MAX; ++i){
+			window[n++] = iov[i];
+		}
+		window[0].iov_base = (char *) window[0].iov_base + offset;
+		window[0].iov_len -= offset;
+
+		struct msghdr msg;
+		std::memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = window;
+		msg.msg_iovlen = n;
+		ssize_t k = ::sendmsg(_socket, &msg, MSG_NOSIGNAL);
+		if (k < 0 && errno == EINTR){
+			continue;
+		}
+		if (k < 0 && _nonblocking && (errno == EAGAIN || errno == EWOULDBLOCK)){
+			return l;
+		}
+		if (k <= 0){
+			_valid = false;
+			return l;
+		}
+		l += (size_t)k;
+
+		// step over what went out, a slice may be cut in the middle
+		size_t left = (size_t)k;
+		while (index < iovcnt && left >= iov[index].iov_len - offset){
+			left -= iov[index].iov_len - offset;
+			offset = 0;
+			++index;
+		}
+		offset += left;
+	}
+#endif
+}
+
+bool CSocketTCP::SetNonBlocking(bool nonblocking){
+	if (_socket == INVALID_SOCKET){
+		return false;
+	}
+#ifdef WIN_SOCKET
+	u_long mode = nonblocking ? 1 : 0;
+	if (::ioctlsocket(_socket, FIONBIO, &mode) == SOCKET_ERROR){
+		return false;
+	}
+#else
+	int flags = ::fcntl(_socket, F_GETFL, 0);
+	if (flags < 0){
+		return false;
+	}
+	flags = nonblocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+	if (::fcntl(_socket, F_SETFL, flags) < 0){
+		return false;
+	}
+#endif
+	_nonblocking = nonblocking;
+	return true;
+}
+
+bool CSocketTCP::SetOptions(const CSocketOptions &options){
+	_options = options;
+	if (_socket == INVALID_SOCKET){
+		return true;
+	}
+	return _options.apply_connection(_socket);
+}
+
 bool CSocketTCP::Valid(){
 	return _source.Valid() && _dest.Valid() && _socket != INVALID_SOCKET && _valid;
 }
@@ -65,6 +205,8 @@ void CSocketTCP::Open(){
 		if (_socket == INVALID_SOCKET){
 			return;
 		}
+		// buffer sizes must be known before the handshake
+		_options.apply_connection(_socket);
 		
 		auto addr = _dest.get();
 		socklen_t len = sizeof(addr);
@@ -84,7 +226,11 @@ void CSocketTCP::Open(){
 }
 
 void CSocketTCP::Close(){
-	if (INVALID_SOCKET){
+	if (_socket != INVALID_SOCKET){
+		// buffered iostream output
+		if (Valid()){
+			_streambuf.pubsync();
+		}
 #ifdef WIN_SOCKET
 		::closesocket(_socket);
 #else
@@ -97,10 +243,19 @@ void CSocketTCP::Close(){
 
 // --- socket_tcp_server ---
 
-CSocketTCPServer::CSocketTCPServer(CAddressIPv4 source)
+CSocketTCPServer::CSocketTCPServer(CAddressIPv4 source, const CSocketOptions &options)
 		: CSocketTCP()
 {
 	_source = source;
+	_options = options;
+}
+
+bool CSocketTCPServer::SetOptions(const CSocketOptions &options){
+	_options = options;
+	if (_socket == INVALID_SOCKET){
+		return true;
+	}
+	return _options.apply_listener(_socket);
 }
 
 CSocketTCPServer::~CSocketTCPServer(){
@@ -118,8 +273,7 @@ void CSocketTCPServer::Listen(int cnt){
 			return;
 		}
 
-		char val = 1;
-		if (::setsockopt(_socket, SOL_SOCKET, SO_REUSEADDR, &val, sizeof(val)) == SOCKET_ERROR){
+		if (!_options.apply_listener(_socket)){
 			Close();
 			return;
 		}
@@ -139,12 +293,31 @@ std::unique_ptr<CSocketTCP> CSocketTCPServer::accept(){
 	if (Valid()){
 		struct sockaddr_in addr;
 		socklen_t addrlen = sizeof(addr);
+#ifdef __linux__
+		// a non-blocking server hands out non-blocking sockets, no fcntl round trip
+		int flags = SOCK_CLOEXEC | (_nonblocking ? SOCK_NONBLOCK : 0);
+		socket_t sock = ::accept4(_socket, (struct sockaddr *) &addr, &addrlen, flags);
+#else
 		socket_t sock = ::accept(_socket, (struct sockaddr *) &addr, &addrlen);
-		CSocketTCP *s = new CSocketTCP(sock, addr, _source.get());
-		return std::unique_ptr<CSocketTCP>(s);
+#endif
+		if (sock == INVALID_SOCKET){
+			return std::unique_ptr<CSocketTCP>(nullptr);
+		}
+		std::unique_ptr<CSocketTCP> s = accepted(sock, addr);
+#ifdef __linux__
+		s->_nonblocking = _nonblocking;
+#endif
+		return s;
 	}
 	return std::unique_ptr<CSocketTCP>(nullptr);
 }
 
+std::unique_ptr<CSocketTCP> CSocketTCPServer::accepted(socket_t sock, const struct sockaddr_in &peer){
+	_options.apply_connection(sock);
+	CSocketTCP *s = new CSocketTCP(sock, peer, _source.get());
+	s->_options = _options;
+	return std::unique_ptr<CSocketTCP>(s);
+}
+
 }
 
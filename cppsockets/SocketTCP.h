@@ -5,25 +5,100 @@
 
 #include "AddressIPv4.h"
 #include "Socket.h"
+#include "SocketOptions.h"
+
+#include <vector>
+
+// slices per sendmsg call
+#ifndef SOCKET_TCP_IOV_MAX
+	#define SOCKET_TCP_IOV_MAX 1024
+#endif
 
 namespace sockets {
 	class CSocketTCPServer;
+	class CUringLoop;
+
+	/*
+	* slices of many messages for one CSocketTCP::sendv call
+	* memory behind the slices must stay alive until sendv returns
+	*/
+	class CSendBatch {
+	private:
+		std::vector<iovec_t> _iov;
+		size_t _used;
+		size_t _bytes;
+	public:
+		CSendBatch() : _used(0), _bytes(0) {}
+
+		// count free slices at the end, fill them and commit
+		iovec_t *prepare(size_t count){
+			if (_iov.size() < _used + count){
+				_iov.resize(_used + count);
+			}
+			return _iov.data() + _used;
+		}
+		void commit(size_t count){
+			for (size_t i = _used; i < _used + count; ++i){
+				_bytes += _iov[i].iov_len;
+			}
+			_used += count;
+		}
+		void add(const void *data, size_t count){
+			iovec_t *slice = prepare(1);
+			slice->iov_base = (void *) data;
+			slice->iov_len = count;
+			commit(1);
+		}
+
+		const iovec_t *data() const { return _iov.data(); }
+		size_t size() const { return _used; }
+		size_t bytes() const { return _bytes; }
+		bool empty() const { return _used == 0; }
+		// keeps the capacity
+		void clear(){ _used = 0; _bytes = 0; }
+	};
 
 	class CSocketTCP : public CSocket {
 	protected:
 		CAddressIPv4 _source, _dest;
+		CSocketOptions _options;
 		socket_t _socket;
 		bool _valid;
+		bool _nonblocking;
 
-		CSocketTCP() {}
+		CSocketTCP() : _socket(INVALID_SOCKET), _valid(false), _nonblocking(false) {}
 		CSocketTCP(socket_t sock, struct sockaddr_in source, struct sockaddr_in dest);
 		friend CSocketTCPServer;
+		friend CUringLoop;
 	public:
-		CSocketTCP(CAddressIPv4 dest);
+		CSocketTCP(CAddressIPv4 dest, const CSocketOptions &options = CSocketOptions());
 		virtual ~CSocketTCP() override;
 
+		/*
+		* blocking mode: loop until count bytes or the peer is gone
+		* non-blocking mode: stop at EAGAIN and return what was moved so far,
+		* the socket stays valid, 0 with Valid() == false means closed
+		*/
 		virtual size_t recv(void *data, size_t count) override;
 		virtual size_t send(const void *data, size_t count) override;
+		/*
+		* gather send straight from the slices, one sendmsg per SOCKET_TCP_IOV_MAX slices
+		* same blocking rules as send, returns bytes sent
+		*/
+		size_t sendv(const iovec_t *iov, size_t iovcnt);
+		// every message of the batch, the batch is left as it is
+		size_t sendv(const CSendBatch &batch) { return sendv(batch.data(), batch.size()); }
+		// one read, 0 when closed or nothing is pending on a non-blocking socket
+		virtual size_t recv_some(void *data, size_t count) override;
+
+		// O_NONBLOCK on the descriptor, needed by CEventLoop
+		bool SetNonBlocking(bool nonblocking);
+		bool IsNonBlocking() const { return _nonblocking; }
+		socket_t get_handle() const { return _socket; }
+
+		// applied right away when open, otherwise by Open / Listen
+		virtual bool SetOptions(const CSocketOptions &options);
+		const CSocketOptions &GetOptions() const { return _options; }
 
 		virtual const IAddress &get_source_address() override { return _source; }
 		virtual const IAddress &get_dest_address() override { return _dest; }
@@ -38,20 +113,28 @@ namespace sockets {
 	protected:
 
 	public:
-		CSocketTCPServer(int port) : CSocketTCPServer(CAddressIPv4("0.0.0.0", port)) {}
-		CSocketTCPServer(CAddressIPv4 source);
+		CSocketTCPServer(int port, const CSocketOptions &options = CSocketOptions()) : CSocketTCPServer(CAddressIPv4("0.0.0.0", port), options) {}
+		CSocketTCPServer(CAddressIPv4 source, const CSocketOptions &options = CSocketOptions());
 
 		virtual ~CSocketTCPServer() override;
 
 		virtual size_t recv(void *data, size_t count) override { return 0; }
 		virtual size_t send(const void *data, size_t count) override { return 0; }
+		virtual size_t recv_some(void *, size_t) override { return 0; }
 
 		virtual bool Valid() override;
 
-		virtual void Open() override { Listen(1); }
+		// listener options, connection options go to every accepted socket
+		virtual bool SetOptions(const CSocketOptions &options) override;
+
+		virtual void Open() override { Listen(_options.backlog); }
 
 		void Listen(int cnt);
+		// nullptr if nothing is pending on a non-blocking server
+		// linux: accept4 with SOCK_CLOEXEC, non-blocking server -> non-blocking socket
 		std::unique_ptr<CSocketTCP> accept();
+		// wrap a descriptor accepted elsewhere (io engines), connection options applied
+		std::unique_ptr<CSocketTCP> accepted(socket_t sock, const struct sockaddr_in &peer);
 	};
 
 }
@@ -9,18 +9,28 @@
 
 #ifdef WIN_SOCKET
 	#include <winsock.h>
+#else
+	#include <sys/uio.h>
 #endif
 
+#include <stddef.h>
+
 namespace sockets {
 
 #ifdef WIN_SOCKET
 	typedef SOCKET socket_t;
 	typedef unsigned int in_addr_t;
 	typedef int socklen_t;
+	// same members as struct iovec
+	struct iovec_t {
+		void *iov_base;
+		size_t iov_len;
+	};
 #else
 	typedef int socket_t;
 	#define SOCKET_ERROR -1
 	#define INVALID_SOCKET -1
+	typedef struct iovec iovec_t;
 #endif
 
 }
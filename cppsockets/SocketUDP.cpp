@@ -0,0 +1,352 @@
+#ifndef WIN_SOCKET
+	#include <unistd.h>
+	#include <fcntl.h>
+	#include <errno.h>
+	#include <sys/socket.h>
+	#include <netinet/udp.h>
+#endif
+
+#include <cstring>
+
+#include "SocketUDP.h"
+
+#ifdef __linux__
+	#ifndef SOL_UDP
+		#define SOL_UDP 17
+	#endif
+	#ifndef UDP_SEGMENT
+		#define UDP_SEGMENT 103
+	#endif
+	#ifndef UDP_GRO
+		#define UDP_GRO 104
+	#endif
+#endif
+
+namespace sockets {
+
+// --- datagram_batch ---
+
+CDatagramBatch::CDatagramBatch(size_t slots, size_t slot_size){
+	if (slots < 1){
+		slots = 1;
+	}
+	_slot_size = slot_size;
+#ifdef __linux__
+	_control_size = CMSG_SPACE(sizeof(int));
+#else
+	_control_size = 0;
+#endif
+	_count = 0;
+
+	_buffers.resize(slots * slot_size);
+	_control.resize(slots * _control_size);
+	_iov.resize(slots);
+	_from.resize(slots);
+	_length.resize(slots, 0);
+	_segment.resize(slots, 0);
+	_truncated.resize(slots, false);
+#ifdef __linux__
+	_msgs.resize(slots);
+#endif
+}
+
+// --- socket_udp ---
+
+CSocketUDP::CSocketUDP(CAddressIPv4 source, CAddressIPv4 dest, const CSocketOptions &options)
+	: _source(source), _dest(dest), _options(options)
+	, _socket(INVALID_SOCKET), _valid(false), _nonblocking(false), _gso_segment(0){
+}
+
+CSocketUDP::~CSocketUDP(){
+	Close();
+}
+
+static bool would_block(bool nonblocking){
+	return nonblocking && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+size_t CSocketUDP::recv(void *data, size_t count){
+	if (!Valid()){
+		return 0;
+	}
+	for (;;){
+		int k = (int)::recv(_socket, (char *) data, count, 0);
+		if (k < 0 && errno == EINTR){
+			continue;
+		}
+		// a datagram socket stays usable after a failed read
+		return k < 0 ? 0 : (size_t)k;
+	}
+}
+
+size_t CSocketUDP::recv_some(void *data, size_t count){
+	return recv(data, count);
+}
+
+size_t CSocketUDP::send(const void *data, size_t count){
+	if (!Valid() || !_dest.Valid()){
+		return 0;
+	}
+	for (;;){
+		int k = (int)::send(_socket, (const char *) data, count, 0);
+		if (k < 0 && errno == EINTR){
+			continue;
+		}
+		return k < 0 ? 0 : (size_t)k;
+	}
+}
+
+size_t CSocketUDP::recv_from(void *data, size_t count, CAddressIPv4 &from){
+	if (!Valid()){
+		return 0;
+	}
+	struct sockaddr_in addr;
+	for (;;){
+		socklen_t len = sizeof(addr);
+		int k = (int)::recvfrom(_socket, (char *) data, count, 0, (struct sockaddr *) &addr, &len);
+		if (k < 0 && errno == EINTR){
+			continue;
+		}
+		if (k < 0){
+			return 0;
+		}
+		from = CAddressIPv4(addr);
+		return (size_t)k;
+	}
+}
+
+size_t CSocketUDP::send_to(const void *data, size_t count, const CAddressIPv4 &to){
+	if (!Valid() || !to.Valid()){
+		return 0;
+	}
+	struct sockaddr_in addr = to.get();
+	for (;;){
+		int k = (int)::sendto(_socket, (const char *) data, count, 0, (const struct sockaddr *) &addr, sizeof(addr));
+		if (k < 0 && errno == EINTR){
+			continue;
+		}
+		return k < 0 ? 0 : (size_t)k;
+	}
+}
+
+size_t CSocketUDP::recv_batch(CDatagramBatch &batch){
+	batch._count = 0;
+	if (!Valid()){
+		return 0;
+	}
+#ifdef __linux__
+	const size_t slots = batch.capacity();
+	for (size_t i = 0; i < slots; ++i){
+		batch._iov[i].iov_base = batch.data(i);
+		batch._iov[i].iov_len = batch._slot_size;
+
+		struct msghdr &hdr = batch._msgs[i].msg_hdr;
+		std::memset(&hdr, 0, sizeof(hdr));
+		hdr.msg_name = &batch._from[i];
+		hdr.msg_namelen = sizeof(batch._from[i]);
+		hdr.msg_iov = &batch._iov[i];
+		hdr.msg_iovlen = 1;
+		hdr.msg_control = batch._control.data() + i * batch._control_size;
+		hdr.msg_controllen = batch._control_size;
+		batch._msgs[i].msg_len = 0;
+	}
+
+	int n;
+	do {
+		n = ::recvmmsg(_socket, batch._msgs.data(), (unsigned int) slots, MSG_WAITFORONE, nullptr);
+	} while (n < 0 && errno == EINTR);
+	if (n <= 0){
+		return 0;
+	}
+
+	for (int i = 0; i < n; ++i){
+		struct msghdr &hdr = batch._msgs[i].msg_hdr;
+		batch._length[i] = batch._msgs[i].msg_len;
+		batch._segment[i] = batch._msgs[i].msg_len;
+		batch._truncated[i] = (hdr.msg_flags & MSG_TRUNC) != 0;
+		for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr); cmsg; cmsg = CMSG_NXTHDR(&hdr, cmsg)){
+			if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO){
+				int segment = 0;
+				std::memcpy(&segment, CMSG_DATA(cmsg), sizeof(segment));
+				if (segment > 0){
+					batch._segment[i] = (size_t)segment;
+				}
+			}
+		}
+	}
+	batch._count = (size_t)n;
+	return batch._count;
+#else
+	// one recvfrom per datagram, stops when nothing is pending
+	for (size_t i = 0; i < batch.capacity(); ++i){
+		socklen_t len = sizeof(batch._from[i]);
+		int k = (int)::recvfrom(_socket, batch.data(i), (int)batch._slot_size, 0, (struct sockaddr *) &batch._from[i], &len);
+		bool cut = false;
+#ifdef WIN_SOCKET
+		// the slot is filled, the rest of the datagram is gone
+		if (k < 0 && ::WSAGetLastError() == WSAEMSGSIZE){
+			k = (int)batch._slot_size;
+			cut = true;
+		}
+#endif
+		if (k < 0){
+			break;
+		}
+		batch._length[i] = (size_t)k;
+		batch._segment[i] = (size_t)k;
+		batch._truncated[i] = cut;
+		++batch._count;
+		if (!_nonblocking){
+			break;
+		}
+	}
+	return batch._count;
+#endif
+}
+
+size_t CSocketUDP::send_batch(const iovec_t *datagrams, size_t count, const CAddressIPv4 *to){
+	if (!Valid() || (!to && !_dest.Valid())){
+		return 0;
+	}
+#ifdef __linux__
+	struct mmsghdr msgs[UDP_BATCH_SLOTS];
+	struct sockaddr_in addrs[UDP_BATCH_SLOTS];
+	iovec_t iov[UDP_BATCH_SLOTS];
+
+	size_t sent = 0;
+	while (sent < count){
+		size_t n = count - sent < UDP_BATCH_SLOTS ? count - sent : UDP_BATCH_SLOTS;
+		for (size_t i = 0; i < n; ++i){
+			iov[i] = datagrams[sent + i];
+			std::memset(&msgs[i], 0, sizeof(msgs[i]));
+			msgs[i].msg_hdr.msg_iov = &iov[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+			if (to){
+				addrs[i] = to[sent + i].get();
+				msgs[i].msg_hdr.msg_name = &addrs[i];
+				msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+			}
+		}
+
+		int k = ::sendmmsg(_socket, msgs, (unsigned int) n, 0);
+		if (k < 0 && errno == EINTR){
+			continue;
+		}
+		if (k < 0 && would_block(_nonblocking)){
+			break;
+		}
+		if (k <= 0){
+			break;
+		}
+		sent += (size_t)k;
+	}
+	return sent;
+#else
+	size_t sent = 0;
+	for (; sent < count; ++sent){
+		size_t k = to ? send_to(datagrams[sent].iov_base, datagrams[sent].iov_len, to[sent])
+			: send(datagrams[sent].iov_base, datagrams[sent].iov_len);
+		if (k != datagrams[sent].iov_len){
+			break;
+		}
+	}
+	return sent;
+#endif
+}
+
+bool CSocketUDP::SetGRO(bool enable){
+#ifdef __linux__
+	int value = enable ? 1 : 0;
+	return _socket != INVALID_SOCKET && ::setsockopt(_socket, SOL_UDP, UDP_GRO, &value, sizeof(value)) == 0;
+#else
+	return !enable;
+#endif
+}
+
+bool CSocketUDP::SetGSO(int segment){
+#ifdef __linux__
+	if (_socket == INVALID_SOCKET || segment < 0 || ::setsockopt(_socket, SOL_UDP, UDP_SEGMENT, &segment, sizeof(segment)) != 0){
+		return false;
+	}
+	_gso_segment = segment;
+	return true;
+#else
+	return segment == 0;
+#endif
+}
+
+bool CSocketUDP::SetNonBlocking(bool nonblocking){
+	if (_socket == INVALID_SOCKET){
+		return false;
+	}
+#ifdef WIN_SOCKET
+	u_long mode = nonblocking ? 1 : 0;
+	if (::ioctlsocket(_socket, FIONBIO, &mode) == SOCKET_ERROR){
+		return false;
+	}
+#else
+	int flags = ::fcntl(_socket, F_GETFL, 0);
+	if (flags < 0){
+		return false;
+	}
+	flags = nonblocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+	if (::fcntl(_socket, F_SETFL, flags) < 0){
+		return false;
+	}
+#endif
+	_nonblocking = nonblocking;
+	return true;
+}
+
+bool CSocketUDP::Valid(){
+	return _source.Valid() && _socket != INVALID_SOCKET && _valid;
+}
+
+void CSocketUDP::Open(){
+	if (!_source.Valid()){
+		return;
+	}
+	_socket = ::socket(AF_INET, SOCK_DGRAM, 0);
+	if (_socket == INVALID_SOCKET){
+		return;
+	}
+	if (!_options.apply_datagram(_socket)){
+		Close();
+		return;
+	}
+
+	auto addr = _source.get();
+	socklen_t len = sizeof(addr);
+	if (::bind(_socket, (struct sockaddr *) &addr, len) == SOCKET_ERROR){
+		Close();
+		return;
+	}
+	if (_dest.Valid()){
+		auto dest = _dest.get();
+		if (::connect(_socket, (struct sockaddr *) &dest, sizeof(dest)) == SOCKET_ERROR){
+			Close();
+			return;
+		}
+	}
+	// port 0 was resolved by bind
+	if (::getsockname(_socket, (struct sockaddr *) &addr, &len) == SOCKET_ERROR){
+		Close();
+		return;
+	}
+	_source = addr;
+	_valid = true;
+}
+
+void CSocketUDP::Close(){
+	if (_socket != INVALID_SOCKET){
+#ifdef WIN_SOCKET
+		::closesocket(_socket);
+#else
+		::close(_socket);
+#endif
+		_socket = INVALID_SOCKET;
+		_valid = false;
+	}
+}
+
+}
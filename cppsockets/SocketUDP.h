@@ -0,0 +1,129 @@
+#pragma once
+
+#ifndef SOCKET_UDP_H
+#define SOCKET_UDP_H
+
+#include "AddressIPv4.h"
+#include "Socket.h"
+#include "SocketOptions.h"
+
+#include <vector>
+
+#ifdef __linux__
+	#include <sys/socket.h>
+#endif
+
+// datagrams per recvmmsg / sendmmsg call
+#ifndef UDP_BATCH_SLOTS
+	#define UDP_BATCH_SLOTS 64
+#endif
+
+// bytes per receive slot, a GRO super datagram can reach 64 KiB
+#ifndef UDP_BATCH_SLOT_SIZE
+	#define UDP_BATCH_SLOT_SIZE (64 * 1024)
+#endif
+
+namespace sockets {
+	class CSocketUDP;
+
+	/*
+	* receive slots for CSocketUDP::recv_batch, reused call after call
+	* with GRO one slot may carry several datagrams of segment(i) bytes each, the last one shorter
+	*/
+	class CDatagramBatch {
+	protected:
+		std::vector<char> _buffers;
+		std::vector<char> _control;
+		std::vector<iovec_t> _iov;
+		std::vector<struct sockaddr_in> _from;
+		std::vector<size_t> _length;
+		std::vector<size_t> _segment;
+		std::vector<bool> _truncated;
+#ifdef __linux__
+		std::vector<struct mmsghdr> _msgs;
+#endif
+		size_t _slot_size;
+		size_t _control_size;
+		size_t _count;
+
+		friend CSocketUDP;
+	public:
+		CDatagramBatch(size_t slots = UDP_BATCH_SLOTS, size_t slot_size = UDP_BATCH_SLOT_SIZE);
+
+		size_t capacity() const { return _length.size(); }
+		// slots filled by the last recv_batch
+		size_t size() const { return _count; }
+
+		char *data(size_t index) { return _buffers.data() + index * _slot_size; }
+		size_t length(size_t index) const { return _length[index]; }
+		// bytes per datagram inside the slot, == length without GRO
+		size_t segment(size_t index) const { return _segment[index]; }
+		// the datagram did not fit the slot, only length bytes of it are here
+		bool truncated(size_t index) const { return _truncated[index]; }
+		CAddressIPv4 from(size_t index) const { return CAddressIPv4(_from[index]); }
+	};
+
+	/*
+	* datagram socket bound to source, optionally connected to dest
+	* recv / send move one datagram; recv_batch / send_batch move many per syscall (recvmmsg / sendmmsg)
+	* GRO and GSO are linux only, the calls report false elsewhere
+	*/
+	class CSocketUDP : public CSocket {
+	protected:
+		CAddressIPv4 _source, _dest;
+		CSocketOptions _options;
+		socket_t _socket;
+		bool _valid;
+		bool _nonblocking;
+		int _gso_segment;
+	public:
+		// dest invalid: not connected, use send_to / send_batch with addresses
+		CSocketUDP(CAddressIPv4 source, CAddressIPv4 dest = CAddressIPv4(), const CSocketOptions &options = CSocketOptions());
+		virtual ~CSocketUDP() override;
+
+		// one datagram, truncated to count; 0 on error or nothing pending on a non-blocking socket
+		virtual size_t recv(void *data, size_t count) override;
+		// same as recv: a shorter read would drop the rest of the datagram
+		virtual size_t recv_some(void *data, size_t count) override;
+		// one datagram to dest
+		virtual size_t send(const void *data, size_t count) override;
+		size_t recv_from(void *data, size_t count, CAddressIPv4 &from);
+		size_t send_to(const void *data, size_t count, const CAddressIPv4 &to);
+
+		/*
+		* fill the batch with as many datagrams as one recvmmsg returns
+		* blocking socket: waits for the first one only
+		* a datagram longer than the slot is cut, see CDatagramBatch::truncated
+		* @return slots filled
+		*/
+		size_t recv_batch(CDatagramBatch &batch);
+		/*
+		* one datagram per slice (a GSO super datagram when SetGSO is on), sendmmsg per UDP_BATCH_SLOTS
+		* to: per datagram address or nullptr for dest
+		* @return datagrams sent
+		*/
+		size_t send_batch(const iovec_t *datagrams, size_t count, const CAddressIPv4 *to = nullptr);
+
+		// UDP_GRO: coalesce received datagrams of one flow into a slot
+		bool SetGRO(bool enable);
+		// UDP_SEGMENT: the kernel cuts every send into segment byte datagrams, 0 = off
+		bool SetGSO(int segment);
+		int GetGSO() const { return _gso_segment; }
+
+		bool SetNonBlocking(bool nonblocking);
+		bool IsNonBlocking() const { return _nonblocking; }
+		socket_t get_handle() const { return _socket; }
+
+		virtual const IAddress &get_source_address() override { return _source; }
+		virtual const IAddress &get_dest_address() override { return _dest; }
+
+		virtual bool Valid() override;
+
+		// bind, then connect when dest is valid; source port 0 picks one
+		virtual void Open();
+		virtual void Close() override;
+	};
+
+}
+
+#endif
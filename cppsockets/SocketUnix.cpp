@@ -0,0 +1,365 @@
+#include "SocketUnix.h"
+
+#ifndef WIN_SOCKET
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <cstring>
+
+#ifndef MSG_NOSIGNAL
+	#define MSG_NOSIGNAL 0
+#endif
+
+#ifndef SOCK_CLOEXEC
+	#define SOCK_CLOEXEC 0
+#endif
+
+#ifndef MSG_CMSG_CLOEXEC
+	#define MSG_CMSG_CLOEXEC 0
+#endif
+
+namespace sockets {
+
+static int socket_type(EUnixSocketType type){
+	return type == EUnixSocketType::SeqPacket ? SOCK_SEQPACKET : SOCK_STREAM;
+}
+
+CSocketUnix::CSocketUnix(socket_t sock, EUnixSocketType type, const CAddressUnix &source, const CAddressUnix &dest){
+	_socket = sock;
+	_type = type;
+	_source = source;
+	_dest = dest;
+	_valid = true;
+	_nonblocking = false;
+}
+
+CSocketUnix::CSocketUnix(CAddressUnix dest, EUnixSocketType type){
+	_socket = INVALID_SOCKET;
+	_type = type;
+	_dest = dest;
+	_valid = false;
+	_nonblocking = false;
+}
+
+CSocketUnix::~CSocketUnix(){
+	Close();
+}
+
+bool CSocketUnix::pair(std::unique_ptr<CSocketUnix> &first, std::unique_ptr<CSocketUnix> &second, EUnixSocketType type){
+	int fds[2];
+	if (::socketpair(AF_UNIX, socket_type(type) | SOCK_CLOEXEC, 0, fds) != 0){
+		return false;
+	}
+	first.reset(new CSocketUnix(fds[0], type, CAddressUnix(), CAddressUnix()));
+	second.reset(new CSocketUnix(fds[1], type, CAddressUnix(), CAddressUnix()));
+	return true;
+}
+
+size_t CSocketUnix::recv(void *data, size_t count){
+	if (_type == EUnixSocketType::SeqPacket){
+		return recv_some(data, count);
+	}
+	if (Valid()){
+		size_t l = 0;
+		while (l < count){
+			ssize_t k = ::recv(_socket, ((char *) data + l), count - l, 0);
+			if (k < 0 && errno == EINTR){
+				continue;
+			}
+			if (k < 0 && _nonblocking && (errno == EAGAIN || errno == EWOULDBLOCK)){
+				return l;
+			}
+			if (k <= 0){
+				_valid = false;
+				return l;
+			}
+			l += k;
+		}
+		return l;
+	}
+	return 0;
+}
+
+size_t CSocketUnix::recv_some(void *data, size_t count){
+	if (Valid() && count > 0){
+		for (;;){
+			ssize_t k = ::recv(_socket, (char *) data, count, 0);
+			if (k < 0 && errno == EINTR){
+				continue;
+			}
+			if (k < 0 && _nonblocking && (errno == EAGAIN || errno == EWOULDBLOCK)){
+				return 0;
+			}
+			if (k <= 0){
+				_valid = false;
+				return 0;
+			}
+			return k;
+		}
+	}
+	return 0;
+}
+
+size_t CSocketUnix::send(const void *data, size_t count){
+	if (Valid()){
+		size_t l = 0;
+		while (l < count){
+			ssize_t k = ::send(_socket, ((const char *) data + l), count - l, MSG_NOSIGNAL);
+			if (k < 0 && errno == EINTR){
+				continue;
+			}
+			if (k < 0 && _nonblocking && (errno == EAGAIN || errno == EWOULDBLOCK)){
+				return l;
+			}
+			if (k <= 0){
+				_valid = false;
+				return l;
+			}
+			l += k;
+			// a message is never split
+			if (_type == EUnixSocketType::SeqPacket){
+				break;
+			}
+		}
+		return l;
+	}
+	return 0;
+}
+
+size_t CSocketUnix::send_fds(const void *data, size_t count, const int *fds, size_t fd_count){
+	if (!Valid() || count == 0 || fd_count > UNIX_SOCKET_MAX_FDS){
+		return 0;
+	}
+
+	struct iovec iov;
+	iov.iov_base = (void *) data;
+	iov.iov_len = count;
+
+	char control[CMSG_SPACE(sizeof(int) * UNIX_SOCKET_MAX_FDS)];
+	std::memset(control, 0, sizeof(control));
+
+	struct msghdr msg;
+	std::memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	if (fd_count > 0){
+		msg.msg_control = control;
+		msg.msg_controllen = CMSG_SPACE(sizeof(int) * fd_count);
+		struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fd_count);
+		std::memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * fd_count);
+	}
+
+	for (;;){
+		ssize_t k = ::sendmsg(_socket, &msg, MSG_NOSIGNAL);
+		if (k < 0 && errno == EINTR){
+			continue;
+		}
+		if (k < 0 && _nonblocking && (errno == EAGAIN || errno == EWOULDBLOCK)){
+			return 0;
+		}
+		if (k <= 0){
+			_valid = false;
+			return 0;
+		}
+		// the descriptors went with the first byte, the rest is plain data
+		size_t l = (size_t)k;
+		if (l < count && _type == EUnixSocketType::Stream){
+			l += send((const char *) data + l, count - l);
+		}
+		return l;
+	}
+}
+
+size_t CSocketUnix::recv_fds(void *data, size_t count, std::vector<int> &fds){
+	if (!Valid() || count == 0){
+		return 0;
+	}
+
+	struct iovec iov;
+	iov.iov_base = data;
+	iov.iov_len = count;
+
+	char control[CMSG_SPACE(sizeof(int) * UNIX_SOCKET_MAX_FDS)];
+	struct msghdr msg;
+	std::memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	ssize_t k;
+	for (;;){
+		k = ::recvmsg(_socket, &msg, MSG_CMSG_CLOEXEC);
+		if (k < 0 && errno == EINTR){
+			continue;
+		}
+		break;
+	}
+	if (k < 0 && _nonblocking && (errno == EAGAIN || errno == EWOULDBLOCK)){
+		return 0;
+	}
+	if (k <= 0){
+		_valid = false;
+		return 0;
+	}
+
+	const size_t first = fds.size();
+	for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)){
+		if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS){
+			size_t n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+			const unsigned char *ptr = CMSG_DATA(cmsg);
+			for (size_t i = 0; i < n; ++i){
+				int fd;
+				std::memcpy(&fd, ptr + i * sizeof(int), sizeof(int));
+				fds.push_back(fd);
+			}
+		}
+	}
+	// descriptors were dropped by the kernel, the data no longer matches them
+	if (msg.msg_flags & MSG_CTRUNC){
+		for (size_t i = first; i < fds.size(); ++i){
+			::close(fds[i]);
+		}
+		fds.resize(first);
+		_valid = false;
+		return 0;
+	}
+	return (size_t)k;
+}
+
+bool CSocketUnix::SetNonBlocking(bool nonblocking){
+	if (_socket == INVALID_SOCKET){
+		return false;
+	}
+	int flags = ::fcntl(_socket, F_GETFL, 0);
+	if (flags < 0){
+		return false;
+	}
+	flags = nonblocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+	if (::fcntl(_socket, F_SETFL, flags) < 0){
+		return false;
+	}
+	_nonblocking = nonblocking;
+	return true;
+}
+
+bool CSocketUnix::Valid(){
+	return _socket != INVALID_SOCKET && _valid;
+}
+
+void CSocketUnix::Open(){
+	if (!_dest.Valid()){
+		return;
+	}
+	_socket = ::socket(AF_UNIX, socket_type(_type) | SOCK_CLOEXEC, 0);
+	if (_socket == INVALID_SOCKET){
+		return;
+	}
+	if (::connect(_socket, (const struct sockaddr *) &_dest.get(), _dest.length()) == SOCKET_ERROR){
+		Close();
+		return;
+	}
+	_valid = true;
+}
+
+void CSocketUnix::Close(){
+	if (_socket != INVALID_SOCKET){
+		// buffered iostream output
+		if (Valid()){
+			_streambuf.pubsync();
+		}
+		::close(_socket);
+		_socket = INVALID_SOCKET;
+		_valid = false;
+	}
+}
+
+// --- socket_unix_server ---
+
+CSocketUnixServer::CSocketUnixServer(CAddressUnix source, EUnixSocketType type)
+		: CSocketUnix(CAddressUnix(), type)
+{
+	_source = source;
+}
+
+CSocketUnixServer::~CSocketUnixServer(){
+	Close();
+}
+
+bool CSocketUnixServer::Valid(){
+	return _source.Valid() && _socket != INVALID_SOCKET && _valid;
+}
+
+void CSocketUnixServer::Listen(int cnt){
+	if (!_source.Valid()){
+		return;
+	}
+	_socket = ::socket(AF_UNIX, socket_type(_type) | SOCK_CLOEXEC, 0);
+	if (_socket == INVALID_SOCKET){
+		return;
+	}
+
+	const struct sockaddr *addr = (const struct sockaddr *) &_source.get();
+	std::string path = _source.path();
+	if (::bind(_socket, addr, _source.length()) == SOCKET_ERROR){
+		// a file left by a dead server refuses connections, a live one does not
+		bool stale = false;
+		if (errno == EADDRINUSE && !path.empty()){
+			int probe = ::socket(AF_UNIX, socket_type(_type) | SOCK_CLOEXEC, 0);
+			stale = probe >= 0 && ::connect(probe, addr, _source.length()) != 0 && errno == ECONNREFUSED;
+			if (probe >= 0){
+				::close(probe);
+			}
+		}
+		if (!stale || ::unlink(path.c_str()) != 0 || ::bind(_socket, addr, _source.length()) == SOCKET_ERROR){
+			CSocketUnix::Close();
+			return;
+		}
+	}
+
+	if (::listen(_socket, cnt) == SOCKET_ERROR){
+		CSocketUnix::Close();
+		return;
+	}
+	_valid = true;
+}
+
+void CSocketUnixServer::Close(){
+	bool listening = Valid();
+	CSocketUnix::Close();
+	std::string path = _source.path();
+	if (listening && !path.empty()){
+		::unlink(path.c_str());
+	}
+}
+
+std::unique_ptr<CSocketUnix> CSocketUnixServer::accept(){
+	if (Valid()){
+		struct sockaddr_un addr;
+		socklen_t addrlen = sizeof(addr);
+#ifdef __linux__
+		int flags = SOCK_CLOEXEC | (_nonblocking ? SOCK_NONBLOCK : 0);
+		socket_t sock = ::accept4(_socket, (struct sockaddr *) &addr, &addrlen, flags);
+#else
+		socket_t sock = ::accept(_socket, (struct sockaddr *) &addr, &addrlen);
+#endif
+		if (sock == INVALID_SOCKET){
+			return std::unique_ptr<CSocketUnix>(nullptr);
+		}
+		CSocketUnix *s = new CSocketUnix(sock, _type, _source, CAddressUnix(addr, addrlen));
+#ifdef __linux__
+		s->_nonblocking = _nonblocking;
+#endif
+		return std::unique_ptr<CSocketUnix>(s);
+	}
+	return std::unique_ptr<CSocketUnix>(nullptr);
+}
+
+}
+
+#endif // !WIN_SOCKET
@@ -0,0 +1,109 @@
+#pragma once
+
+#ifndef SOCKET_UNIX_H
+#define SOCKET_UNIX_H
+
+#include "AddressUnix.h"
+#include "Socket.h"
+
+#ifndef WIN_SOCKET
+
+#include <vector>
+
+// descriptors in one SCM_RIGHTS message
+#ifndef UNIX_SOCKET_MAX_FDS
+	#define UNIX_SOCKET_MAX_FDS 16
+#endif
+
+namespace sockets {
+	class CSocketUnixServer;
+
+	enum class EUnixSocketType {
+		Stream,		// byte stream like tcp
+		SeqPacket,	// reliable, ordered, message boundaries kept
+	};
+
+	/*
+	* same host transport without the tcp stack
+	* stream: recv / send loop like CSocketTCP
+	* seqpacket: recv returns one message (truncated to count), send writes one message
+	* send_fds / recv_fds pass open descriptors to the peer (SCM_RIGHTS)
+	*/
+	class CSocketUnix : public CSocket {
+	protected:
+		CAddressUnix _source, _dest;
+		EUnixSocketType _type;
+		socket_t _socket;
+		bool _valid;
+		bool _nonblocking;
+
+		CSocketUnix(socket_t sock, EUnixSocketType type, const CAddressUnix &source, const CAddressUnix &dest);
+		friend CSocketUnixServer;
+	public:
+		CSocketUnix(CAddressUnix dest, EUnixSocketType type = EUnixSocketType::Stream);
+		virtual ~CSocketUnix() override;
+
+		// connected pair in this process, hand one end to a child or thread
+		static bool pair(std::unique_ptr<CSocketUnix> &first, std::unique_ptr<CSocketUnix> &second,
+			EUnixSocketType type = EUnixSocketType::Stream);
+
+		virtual size_t recv(void *data, size_t count) override;
+		virtual size_t send(const void *data, size_t count) override;
+		virtual size_t recv_some(void *data, size_t count) override;
+
+		/*
+		* count bytes (at least 1) with fds attached, the descriptors stay open here
+		* @return bytes sent, 0 if nothing went out
+		*/
+		size_t send_fds(const void *data, size_t count, const int *fds, size_t fd_count);
+		/*
+		* one read, received descriptors are appended to fds and owned by the caller
+		* more than UNIX_SOCKET_MAX_FDS (MSG_CTRUNC) fails the call: the ones that
+		* arrived are closed and the socket is no longer Valid()
+		* @return bytes read, 0 on failure
+		*/
+		size_t recv_fds(void *data, size_t count, std::vector<int> &fds);
+
+		bool SetNonBlocking(bool nonblocking);
+		bool IsNonBlocking() const { return _nonblocking; }
+		socket_t get_handle() const { return _socket; }
+		EUnixSocketType get_type() const { return _type; }
+
+		virtual const IAddress &get_source_address() override { return _source; }
+		virtual const IAddress &get_dest_address() override { return _dest; }
+
+		virtual bool Valid() override;
+
+		virtual void Open();
+		virtual void Close() override;
+	};
+
+	/*
+	* listening unix socket, a stale socket file at the path is removed before bind
+	* (stale: connect is refused; a live server sees that probe as one accepted, closed connection)
+	* and the file is removed again on Close
+	*/
+	class CSocketUnixServer : public CSocketUnix {
+	public:
+		CSocketUnixServer(CAddressUnix source, EUnixSocketType type = EUnixSocketType::Stream);
+		virtual ~CSocketUnixServer() override;
+
+		virtual size_t recv(void *, size_t) override { return 0; }
+		virtual size_t send(const void *, size_t) override { return 0; }
+		virtual size_t recv_some(void *, size_t) override { return 0; }
+
+		virtual bool Valid() override;
+
+		virtual void Open() override { Listen(SOMAXCONN); }
+		virtual void Close() override;
+
+		void Listen(int cnt);
+		// nullptr if nothing is pending on a non-blocking server
+		std::unique_ptr<CSocketUnix> accept();
+	};
+
+}
+
+#endif // !WIN_SOCKET
+
+#endif
@@ -4,6 +4,12 @@
 #define SOCKETS_H
 
 #include "SocketTCP.h"
+#include "SocketUDP.h"
+#include "SocketUnix.h"
+#include "EventLoop.h"
+#include "UringLoop.h"
+#include "ReusePortServer.h"
+#include "ConnectionPool.h"
 
 #endif
 
@@ -0,0 +1,832 @@
+#include "UringLoop.h"
+
+#if !defined(WIN_SOCKET) && defined(__linux__)
+
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <linux/io_uring.h>
+
+namespace sockets {
+
+// user_data = op << 56 | generation << 32 | index
+enum EUringOp : uint64_t {
+	URING_OP_WAKE = 1,
+	URING_OP_ACCEPT = 2,
+	URING_OP_RECV = 3,
+	URING_OP_PROVIDE = 4,
+	URING_OP_SEND = 5,
+	URING_OP_POLLOUT = 6,
+};
+
+static inline uint64_t make_user_data(uint64_t op, uint32_t generation, uint32_t index){
+	return (op << 56) | ((uint64_t)(generation & 0xffffff) << 32) | index;
+}
+
+// loop run by this thread, tells writes on the loop thread from the rest
+static thread_local const void *t_current_loop = nullptr;
+
+struct CUringLoop::COutput : public CStreamOutput, public std::enable_shared_from_this<CUringLoop::COutput> {
+	CLoop *loop;
+	// loop thread only, nullptr once the connection is closed
+	CConnection *conn;
+
+	COutput(CLoop *owner, CConnection *connection) : loop(owner), conn(connection) {}
+
+protected:
+	virtual void kick() override {
+		if (t_current_loop == loop){
+			// submitted with the next io_uring_enter
+			loop->dirty.push_back(shared_from_this());
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> scopelock(loop->pending_lock);
+			loop->flushes.push_back(shared_from_this());
+		}
+		uint64_t one = 1;
+		ssize_t k = ::write(loop->wake, &one, sizeof(one));
+		(void)k;
+	}
+};
+
+static inline int sys_io_uring_setup(unsigned entries, struct io_uring_params *params){
+	return (int)::syscall(__NR_io_uring_setup, entries, params);
+}
+
+static inline int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags){
+	return (int)::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+static inline int sys_io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args){
+	return (int)::syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static bool register_buffer_ring(int ring_fd, void *ring_addr, unsigned entries){
+	struct io_uring_buf_reg reg;
+	std::memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (uint64_t)(uintptr_t)ring_addr;
+	reg.ring_entries = entries;
+	reg.bgid = 0;
+	return sys_io_uring_register(ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) == 0;
+}
+
+static bool update_file_slot(int ring_fd, uint32_t slot, int fd){
+	struct io_uring_files_update update;
+	std::memset(&update, 0, sizeof(update));
+	update.offset = slot;
+	update.fds = (uint64_t)(uintptr_t)&fd;
+	return sys_io_uring_register(ring_fd, IORING_REGISTER_FILES_UPDATE, &update, 1) == 1;
+}
+
+bool CUringLoop::Available(){
+	// multishot recv needs 6.0
+	struct utsname name;
+	if (::uname(&name) != 0 || ::atoi(name.release) < 6){
+		return false;
+	}
+
+	CRing ring;
+	if (!setup_ring(ring, 4)){
+		return false;
+	}
+	release_ring(ring);
+	return true;
+}
+
+bool CUringLoop::BufferRingWorks(){
+	static const bool works = probe_buffer_ring();
+	return works;
+}
+
+bool CUringLoop::probe_buffer_ring(){
+	// registration alone proves nothing, some kernels accept it and never hand a buffer out
+	CRing ring;
+	if (!setup_ring(ring, 4)){
+		return false;
+	}
+	size_t size = (size_t)::sysconf(_SC_PAGESIZE);
+	void *mem = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	int pair[2] = { -1, -1 };
+	char byte = 0;
+	bool ok = mem != MAP_FAILED
+		&& register_buffer_ring(ring.fd, mem, 1)
+		&& ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) == 0;
+	if (ok){
+		struct io_uring_buf_ring *buf_ring = (struct io_uring_buf_ring *) mem;
+		buf_ring->bufs[0].addr = (uint64_t)(uintptr_t)&byte;
+		buf_ring->bufs[0].len = 1;
+		buf_ring->bufs[0].bid = 0;
+		__atomic_store_n(&buf_ring->tail, (uint16_t)1, __ATOMIC_RELEASE);
+
+		struct io_uring_sqe *sqe = get_sqe(ring);
+		sqe->opcode = IORING_OP_RECV;
+		sqe->fd = pair[0];
+		sqe->flags = IOSQE_BUFFER_SELECT;
+		sqe->buf_group = 0;
+		ok = ::write(pair[1], "!", 1) == 1 && submit(ring, 1) >= 0;
+		if (ok){
+			struct io_uring_cqe *cqe = &ring.cqes[*ring.cq_head & ring.cq_mask];
+			ok = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE) != *ring.cq_head && cqe->res == 1 && byte == '!';
+		}
+	}
+	if (pair[0] >= 0){
+		::close(pair[0]);
+		::close(pair[1]);
+	}
+	release_ring(ring);
+	if (mem != MAP_FAILED){
+		::munmap(mem, size);
+	}
+	return ok;
+}
+
+bool CUringLoop::setup_ring(CRing &ring, unsigned entries){
+	std::memset(&ring, 0, sizeof(ring));
+	ring.fd = -1;
+
+	struct io_uring_params params;
+	std::memset(&params, 0, sizeof(params));
+	// multishot completions outnumber submissions
+	params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+	params.cq_entries = entries * 4;
+	int fd = sys_io_uring_setup(entries, &params);
+	if (fd < 0){
+		std::memset(&params, 0, sizeof(params));
+		params.flags = IORING_SETUP_CQSIZE;
+		params.cq_entries = entries * 4;
+		fd = sys_io_uring_setup(entries, &params);
+	}
+	if (fd < 0){
+		return false;
+	}
+	ring.fd = fd;
+
+	ring.sq_map_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+	ring.cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (single_mmap){
+		if (ring.cq_map_size > ring.sq_map_size){
+			ring.sq_map_size = ring.cq_map_size;
+		}
+		ring.cq_map_size = ring.sq_map_size;
+	}
+
+	ring.sq_map = ::mmap(nullptr, ring.sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (ring.sq_map == MAP_FAILED){
+		ring.sq_map = nullptr;
+		release_ring(ring);
+		return false;
+	}
+	if (single_mmap){
+		ring.cq_map = ring.sq_map;
+	} else {
+		ring.cq_map = ::mmap(nullptr, ring.cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (ring.cq_map == MAP_FAILED){
+			ring.cq_map = nullptr;
+			release_ring(ring);
+			return false;
+		}
+	}
+
+	ring.sqes_map_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	void *sqes = ::mmap(nullptr, ring.sqes_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (sqes == MAP_FAILED){
+		release_ring(ring);
+		return false;
+	}
+	ring.sqes = (struct io_uring_sqe *) sqes;
+
+	char *sq = (char *) ring.sq_map;
+	ring.sq_head = (uint32_t *)(sq + params.sq_off.head);
+	ring.sq_tail = (uint32_t *)(sq + params.sq_off.tail);
+	ring.sq_array = (uint32_t *)(sq + params.sq_off.array);
+	ring.sq_mask = *(uint32_t *)(sq + params.sq_off.ring_mask);
+	ring.sq_entries = *(uint32_t *)(sq + params.sq_off.ring_entries);
+	ring.sq_local_tail = *ring.sq_tail;
+
+	char *cq = (char *) ring.cq_map;
+	ring.cq_head = (uint32_t *)(cq + params.cq_off.head);
+	ring.cq_tail = (uint32_t *)(cq + params.cq_off.tail);
+	ring.cq_mask = *(uint32_t *)(cq + params.cq_off.ring_mask);
+	ring.cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+	return true;
+}
+
+void CUringLoop::release_ring(CRing &ring){
+	if (ring.sqes){
+		::munmap(ring.sqes, ring.sqes_map_size);
+	}
+	if (ring.cq_map && ring.cq_map != ring.sq_map){
+		::munmap(ring.cq_map, ring.cq_map_size);
+	}
+	if (ring.sq_map){
+		::munmap(ring.sq_map, ring.sq_map_size);
+	}
+	if (ring.fd >= 0){
+		::close(ring.fd);
+	}
+	std::memset(&ring, 0, sizeof(ring));
+	ring.fd = -1;
+}
+
+io_uring_sqe *CUringLoop::get_sqe(CRing &ring){
+	uint32_t head = __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+	if (ring.sq_local_tail - head >= ring.sq_entries){
+		// full, push what is queued without waiting
+		submit(ring, 0);
+		head = __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+		if (ring.sq_local_tail - head >= ring.sq_entries){
+			return nullptr;
+		}
+	}
+
+	uint32_t index = ring.sq_local_tail & ring.sq_mask;
+	struct io_uring_sqe *sqe = &ring.sqes[index];
+	std::memset(sqe, 0, sizeof(*sqe));
+	ring.sq_array[index] = index;
+	++ring.sq_local_tail;
+	return sqe;
+}
+
+int CUringLoop::submit(CRing &ring, unsigned wait_nr){
+	__atomic_store_n(ring.sq_tail, ring.sq_local_tail, __ATOMIC_RELEASE);
+	uint32_t to_submit = ring.sq_local_tail - __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+	unsigned flags = wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0;
+	if (to_submit == 0 && wait_nr == 0){
+		return 0;
+	}
+	return sys_io_uring_enter(ring.fd, to_submit, wait_nr, flags);
+}
+
+CUringLoop::CUringLoop(int threads)
+		: _running(false), _next(0), _connections(0), _valid(true)
+{
+	if (threads < 1){
+		threads = 1;
+	}
+	for (int i = 0; i < threads; ++i){
+		std::unique_ptr<CLoop> loop(new CLoop());
+		if (!setup_loop(*loop)){
+			_valid = false;
+		}
+		_loops.push_back(std::move(loop));
+	}
+}
+
+CUringLoop::~CUringLoop(){
+	Stop();
+	for (auto &loop : _loops){
+		release_loop(*loop);
+	}
+}
+
+bool CUringLoop::setup_loop(CLoop &loop){
+	std::memset(&loop.ring, 0, sizeof(loop.ring));
+	loop.ring.fd = -1;
+	loop.wake = ::eventfd(0, EFD_CLOEXEC);
+	loop.wake_value = 0;
+	loop.buf_ring = nullptr;
+	loop.buf_ring_size = 0;
+	loop.buffers = nullptr;
+	loop.buf_tail = 0;
+	loop.generation = 0;
+
+	if (loop.wake < 0 || !setup_ring(loop.ring, URING_LOOP_ENTRIES)){
+		return false;
+	}
+
+	// 1. registered files, sparse
+	struct io_uring_rsrc_register files;
+	std::memset(&files, 0, sizeof(files));
+	files.nr = URING_LOOP_MAX_FILES;
+	files.flags = IORING_RSRC_REGISTER_SPARSE;
+	if (sys_io_uring_register(loop.ring.fd, IORING_REGISTER_FILES2, &files, sizeof(files)) != 0){
+		return false;
+	}
+	loop.slots.resize(URING_LOOP_MAX_FILES);
+	loop.free_slots.reserve(URING_LOOP_MAX_FILES);
+	for (uint32_t i = URING_LOOP_MAX_FILES; i > 0; --i){
+		loop.free_slots.push_back(i - 1);
+	}
+
+	// 2. provided buffers, every buffer handed to the kernel up front
+	loop.buffers = (char *) ::malloc((size_t)URING_LOOP_BUFFER_COUNT * URING_LOOP_BUFFER_SIZE);
+	if (!loop.buffers){
+		return false;
+	}
+	if (BufferRingWorks()){
+		loop.buf_ring_size = URING_LOOP_BUFFER_COUNT * sizeof(struct io_uring_buf);
+		void *ring_mem = ::mmap(nullptr, loop.buf_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (ring_mem == MAP_FAILED){
+			loop.buf_ring_size = 0;
+			return false;
+		}
+		loop.buf_ring = (struct io_uring_buf_ring *) ring_mem;
+		if (!register_buffer_ring(loop.ring.fd, ring_mem, URING_LOOP_BUFFER_COUNT)){
+			return false;
+		}
+		for (uint32_t i = 0; i < URING_LOOP_BUFFER_COUNT; ++i){
+			recycle_buffer(loop, (uint16_t)i);
+		}
+	} else {
+		// legacy group, one IORING_OP_PROVIDE_BUFFERS for all of them, goes out with the first submit
+		struct io_uring_sqe *sqe = get_sqe(loop.ring);
+		sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+		sqe->fd = URING_LOOP_BUFFER_COUNT;
+		sqe->addr = (uint64_t)(uintptr_t)loop.buffers;
+		sqe->len = URING_LOOP_BUFFER_SIZE;
+		sqe->off = 0;
+		sqe->buf_group = 0;
+		sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+		sqe->user_data = make_user_data(URING_OP_PROVIDE, 0, 0);
+	}
+	return true;
+}
+
+void CUringLoop::release_loop(CLoop &loop){
+	for (CConnection *conn : loop.pending){
+		delete conn;
+	}
+	loop.pending.clear();
+	loop.slots.clear();
+	// closing the ring cancels armed requests and drops registered files & buffers
+	release_ring(loop.ring);
+	loop.orphans.clear();
+	if (loop.buf_ring){
+		::munmap(loop.buf_ring, loop.buf_ring_size);
+	}
+	::free(loop.buffers);
+	if (loop.wake >= 0){
+		::close(loop.wake);
+	}
+}
+
+bool CUringLoop::Start(){
+	if (!_valid){
+		return false;
+	}
+	bool expected = false;
+	if (!_running.compare_exchange_strong(expected, true)){
+		return false;
+	}
+	for (auto &loop : _loops){
+		CLoop *ptr = loop.get();
+		loop->thread = std::thread([this, ptr](){ run(*ptr); });
+	}
+	return true;
+}
+
+void CUringLoop::Stop(){
+	bool expected = true;
+	if (!_running.compare_exchange_strong(expected, false)){
+		return;
+	}
+	for (auto &loop : _loops){
+		uint64_t one = 1;
+		ssize_t k = ::write(loop->wake, &one, sizeof(one));
+		(void)k;
+	}
+	for (auto &loop : _loops){
+		if (loop->thread.joinable()){
+			loop->thread.join();
+		}
+	}
+}
+
+bool CUringLoop::Listen(CSocketTCPServer &server, handler_factory_t factory){
+	return add_listener(0, server, std::move(factory), true);
+}
+
+bool CUringLoop::ListenOn(int thread, CSocketTCPServer &server, handler_factory_t factory){
+	if (thread < 0 || thread >= (int)_loops.size()){
+		return false;
+	}
+	return add_listener((size_t)thread, server, std::move(factory), false);
+}
+
+bool CUringLoop::add_listener(size_t loop, CSocketTCPServer &server, handler_factory_t factory, bool spread){
+	if (_running || !_valid || !server.Valid()){
+		return false;
+	}
+	CListener listener;
+	listener.server = &server;
+	listener.factory = std::move(factory);
+	listener.loop = loop;
+	listener.spread = spread;
+	_listeners.push_back(std::move(listener));
+	return true;
+}
+
+bool CUringLoop::Add(std::unique_ptr<CSocketTCP> sock, std::shared_ptr<IStreamHandler> handler){
+	if (!_valid || !sock || !sock->Valid() || !handler || !sock->SetNonBlocking(true)){
+		return false;
+	}
+
+	CConnection *conn = new CConnection();
+	conn->sock = std::move(sock);
+	conn->handler = std::move(handler);
+	conn->generation = 0;
+
+	post(conn, nullptr);
+	return true;
+}
+
+void CUringLoop::post(CConnection *conn, CLoop *current){
+	CLoop &target = *_loops[_next.fetch_add(1, std::memory_order_relaxed) % _loops.size()];
+	if (&target == current){
+		attach(target, conn);
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> scopelock(target.pending_lock);
+		target.pending.push_back(conn);
+	}
+	uint64_t one = 1;
+	ssize_t k = ::write(target.wake, &one, sizeof(one));
+	(void)k;
+}
+
+void CUringLoop::drain_pending(CLoop &loop){
+	std::vector<CConnection *> pending;
+	std::vector<std::shared_ptr<COutput>> flushes;
+	{
+		std::lock_guard<std::mutex> scopelock(loop.pending_lock);
+		pending.swap(loop.pending);
+		flushes.swap(loop.flushes);
+	}
+	for (CConnection *conn : pending){
+		attach(loop, conn);
+	}
+	loop.dirty.insert(loop.dirty.end(), flushes.begin(), flushes.end());
+}
+
+void CUringLoop::attach(CLoop &loop, CConnection *conn){
+	if (loop.free_slots.empty() || !update_file_slot(loop.ring.fd, loop.free_slots.back(), conn->sock->get_handle())){
+		// no room in the registered file table
+		conn->handler->on_close(*conn->sock);
+		delete conn;
+		return;
+	}
+
+	uint32_t slot = loop.free_slots.back();
+	loop.free_slots.pop_back();
+	conn->generation = ++loop.generation & 0xffffff;
+	conn->slot = slot;
+	conn->sent = 0;
+	conn->inflight = false;
+	conn->blocked = false;
+	conn->output = std::make_shared<COutput>(&loop, conn);
+	conn->handler->bind_writer(conn->output);
+	loop.slots[slot].reset(conn);
+	_connections.fetch_add(1, std::memory_order_relaxed);
+	arm_recv(loop, slot);
+	if (loop.slots[slot].get() == conn){
+		conn->handler->on_open(*conn->sock);
+	}
+}
+
+void CUringLoop::detach(CLoop &loop, uint32_t slot){
+	CConnection *conn = loop.slots[slot].get();
+	if (!conn){
+		return;
+	}
+	// writes fail from here, queued flushes find no connection
+	conn->output->shutdown();
+	conn->output->conn = nullptr;
+	if (conn->inflight && conn->sent < conn->sending.size()){
+		// the kernel may still read it
+		loop.orphans[make_user_data(URING_OP_SEND, conn->generation, slot)] = std::move(conn->sending);
+	}
+	// armed requests hold the file open past the close, end them and tell the peer
+	::shutdown(conn->sock->get_handle(), SHUT_RDWR);
+	conn->handler->on_close(*conn->sock);
+	update_file_slot(loop.ring.fd, slot, -1);
+	loop.slots[slot].reset();
+	loop.free_slots.push_back(slot);
+	_connections.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void CUringLoop::arm_wake(CLoop &loop){
+	struct io_uring_sqe *sqe = get_sqe(loop.ring);
+	if (!sqe){
+		return;
+	}
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = loop.wake;
+	sqe->addr = (uint64_t)(uintptr_t)&loop.wake_value;
+	sqe->len = sizeof(loop.wake_value);
+	sqe->user_data = make_user_data(URING_OP_WAKE, 0, 0);
+}
+
+void CUringLoop::arm_accept(CLoop &loop, uint32_t listener){
+	struct io_uring_sqe *sqe = get_sqe(loop.ring);
+	if (!sqe){
+		return;
+	}
+	sqe->opcode = IORING_OP_ACCEPT;
+	sqe->fd = _listeners[listener].server->get_handle();
+	sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+	sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+	sqe->user_data = make_user_data(URING_OP_ACCEPT, 0, listener);
+}
+
+void CUringLoop::arm_recv(CLoop &loop, uint32_t slot){
+	struct io_uring_sqe *sqe = get_sqe(loop.ring);
+	if (!sqe){
+		detach(loop, slot);
+		return;
+	}
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = (int)slot;
+	sqe->flags = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->buf_group = 0;
+	sqe->user_data = make_user_data(URING_OP_RECV, loop.slots[slot]->generation, slot);
+}
+
+void CUringLoop::recycle_buffer(CLoop &loop, uint16_t bid){
+	char *addr = loop.buffers + (size_t)bid * URING_LOOP_BUFFER_SIZE;
+	if (!loop.buf_ring){
+		// batched with the rest of this loop turn, no completion unless it fails
+		struct io_uring_sqe *sqe = get_sqe(loop.ring);
+		if (!sqe){
+			return;
+		}
+		sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+		sqe->fd = 1;
+		sqe->addr = (uint64_t)(uintptr_t)addr;
+		sqe->len = URING_LOOP_BUFFER_SIZE;
+		sqe->off = bid;
+		sqe->buf_group = 0;
+		sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+		sqe->user_data = make_user_data(URING_OP_PROVIDE, 0, bid);
+		return;
+	}
+
+	const uint32_t mask = URING_LOOP_BUFFER_COUNT - 1;
+	struct io_uring_buf *buf = &loop.buf_ring->bufs[loop.buf_tail & mask];
+	buf->addr = (uint64_t)(uintptr_t)addr;
+	buf->len = URING_LOOP_BUFFER_SIZE;
+	buf->bid = bid;
+	++loop.buf_tail;
+	__atomic_store_n(&loop.buf_ring->tail, loop.buf_tail, __ATOMIC_RELEASE);
+}
+
+void CUringLoop::run(CLoop &loop){
+	t_current_loop = &loop;
+	arm_wake(loop);
+	for (uint32_t i = 0; i < (uint32_t)_listeners.size(); ++i){
+		if (_loops[_listeners[i].loop].get() == &loop){
+			arm_accept(loop, i);
+		}
+	}
+	// connections added before Start
+	drain_pending(loop);
+
+	while (_running.load(std::memory_order_relaxed)){
+		// this turn's writes go out with the same io_uring_enter
+		flush_dirty(loop);
+		int r = submit(loop.ring, loop.dirty.empty() ? 1 : 0);
+		if (r < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY){
+			break;
+		}
+
+		uint32_t head = *loop.ring.cq_head;
+		uint32_t tail = __atomic_load_n(loop.ring.cq_tail, __ATOMIC_ACQUIRE);
+		while (head != tail){
+			struct io_uring_cqe *cqe = &loop.ring.cqes[head & loop.ring.cq_mask];
+			uint64_t user_data = cqe->user_data;
+			int res = cqe->res;
+			uint32_t flags = cqe->flags;
+			++head;
+			// give the slot back before handlers queue new submissions
+			__atomic_store_n(loop.ring.cq_head, head, __ATOMIC_RELEASE);
+
+			uint32_t index = (uint32_t)user_data;
+			switch (user_data >> 56){
+			case URING_OP_WAKE:
+				if (_running.load(std::memory_order_relaxed)){
+					drain_pending(loop);
+					arm_wake(loop);
+				}
+				break;
+			case URING_OP_ACCEPT:
+				on_accept(loop, index, res, flags);
+				break;
+			case URING_OP_RECV:
+				on_recv(loop, index, (uint32_t)(user_data >> 32) & 0xffffff, res, flags);
+				break;
+			case URING_OP_SEND:
+				on_send(loop, user_data, res);
+				break;
+			case URING_OP_POLLOUT:
+				on_pollout(loop, index, (uint32_t)(user_data >> 32) & 0xffffff, res);
+				break;
+			default:
+				break;
+			}
+
+			if (head == tail){
+				tail = __atomic_load_n(loop.ring.cq_tail, __ATOMIC_ACQUIRE);
+			}
+		}
+	}
+
+	// connections die with their loop
+	for (uint32_t slot = 0; slot < (uint32_t)loop.slots.size(); ++slot){
+		if (loop.slots[slot]){
+			detach(loop, slot);
+		}
+	}
+	loop.dirty.clear();
+	std::lock_guard<std::mutex> scopelock(loop.pending_lock);
+	loop.flushes.clear();
+	t_current_loop = nullptr;
+}
+
+void CUringLoop::on_accept(CLoop &loop, uint32_t listener, int res, uint32_t flags){
+	if (res >= 0){
+		CListener &owner = _listeners[listener];
+		struct sockaddr_in peer;
+		socklen_t len = sizeof(peer);
+		if (::getpeername(res, (struct sockaddr *) &peer, &len) != 0){
+			::close(res);
+		} else {
+			std::unique_ptr<CSocketTCP> sock = owner.server->accepted(res, peer);
+			sock->_nonblocking = true;
+			std::shared_ptr<IStreamHandler> handler = owner.factory(*sock);
+			if (handler){
+				CConnection *conn = new CConnection();
+				conn->sock = std::move(sock);
+				conn->handler = std::move(handler);
+				conn->generation = 0;
+				if (owner.spread){
+					post(conn, &loop);
+				} else {
+					attach(loop, conn);
+				}
+			}
+		}
+	}
+
+	// multishot ended (error or overflow), ask again
+	if (!(flags & IORING_CQE_F_MORE) && _running.load(std::memory_order_relaxed)){
+		arm_accept(loop, listener);
+	}
+}
+
+void CUringLoop::on_recv(CLoop &loop, uint32_t slot, uint32_t generation, int res, uint32_t flags){
+	CConnection *conn = slot < loop.slots.size() ? loop.slots[slot].get() : nullptr;
+	bool has_buffer = (flags & IORING_CQE_F_BUFFER) != 0;
+	uint16_t bid = (uint16_t)(flags >> IORING_CQE_BUFFER_SHIFT);
+
+	if (!conn || conn->generation != generation){
+		// completion of a connection that is gone
+		if (has_buffer){
+			recycle_buffer(loop, bid);
+		}
+		return;
+	}
+
+	bool taken = true;
+	if (res > 0 && has_buffer){
+		taken = conn->handler->on_data(*conn->sock, loop.buffers + (size_t)bid * URING_LOOP_BUFFER_SIZE, (size_t)res);
+		recycle_buffer(loop, bid);
+	} else if (has_buffer){
+		recycle_buffer(loop, bid);
+	}
+	if (!taken){
+		// the handler left bytes behind, the stream cannot go on without them
+		detach(loop, slot);
+		return;
+	}
+	if (loop.slots[slot].get() != conn){
+		// the handler closed it
+		return;
+	}
+
+	if (res == 0 || (res < 0 && res != -ENOBUFS)){
+		detach(loop, slot);
+		return;
+	}
+
+	// out of buffers or the kernel stopped the multishot, they are back now
+	if (!(flags & IORING_CQE_F_MORE)){
+		arm_recv(loop, slot);
+	}
+}
+
+void CUringLoop::flush_dirty(CLoop &loop){
+	// one pass, what handlers write meanwhile waits for the next turn
+	std::vector<std::shared_ptr<COutput>> dirty;
+	dirty.swap(loop.dirty);
+	for (auto &output : dirty){
+		if (output->conn){
+			flush(loop, *output->conn);
+		}
+	}
+}
+
+bool CUringLoop::flush(CLoop &loop, CConnection &conn){
+	if (conn.inflight){
+		// the completion continues
+		return true;
+	}
+	if (conn.sent == conn.sending.size()){
+		conn.sending.clear();
+		conn.sent = 0;
+		if (!conn.output->take(conn.sending)){
+			if (conn.blocked){
+				conn.blocked = false;
+				conn.handler->on_drain(*conn.sock);
+			}
+			if (conn.output->closing()){
+				detach(loop, conn.slot);
+				return false;
+			}
+			return true;
+		}
+	}
+
+	struct io_uring_sqe *sqe = get_sqe(loop.ring);
+	if (!sqe){
+		// submission queue full, next turn
+		loop.dirty.push_back(conn.output);
+		return true;
+	}
+	sqe->opcode = IORING_OP_SEND;
+	sqe->fd = (int)conn.slot;
+	sqe->flags = IOSQE_FIXED_FILE;
+	sqe->addr = (uint64_t)(uintptr_t)(conn.sending.data() + conn.sent);
+	sqe->len = (uint32_t)(conn.sending.size() - conn.sent);
+	sqe->msg_flags = MSG_NOSIGNAL;
+	sqe->user_data = make_user_data(URING_OP_SEND, conn.generation, conn.slot);
+	conn.inflight = true;
+	return true;
+}
+
+void CUringLoop::on_send(CLoop &loop, uint64_t user_data, int res){
+	uint32_t slot = (uint32_t)user_data;
+	uint32_t generation = (uint32_t)(user_data >> 32) & 0xffffff;
+	CConnection *conn = slot < loop.slots.size() ? loop.slots[slot].get() : nullptr;
+	if (!conn || conn->generation != generation){
+		// the buffer of a closed connection is free now
+		loop.orphans.erase(user_data);
+		return;
+	}
+
+	conn->inflight = false;
+	if (res == -EAGAIN || res == -EWOULDBLOCK){
+		// socket full, send again once it is writable
+		struct io_uring_sqe *sqe = get_sqe(loop.ring);
+		if (!sqe){
+			detach(loop, slot);
+			return;
+		}
+		sqe->opcode = IORING_OP_POLL_ADD;
+		sqe->fd = (int)slot;
+		sqe->flags = IOSQE_FIXED_FILE;
+		sqe->poll32_events = POLLOUT;
+		sqe->user_data = make_user_data(URING_OP_POLLOUT, generation, slot);
+		conn->inflight = true;
+		conn->blocked = true;
+		return;
+	}
+	if (res <= 0){
+		detach(loop, slot);
+		return;
+	}
+
+	conn->sent += (size_t)res;
+	conn->output->sent((size_t)res);
+	if (conn->sent < conn->sending.size()){
+		conn->blocked = true;
+	}
+	flush(loop, *conn);
+}
+
+void CUringLoop::on_pollout(CLoop &loop, uint32_t slot, uint32_t generation, int res){
+	CConnection *conn = slot < loop.slots.size() ? loop.slots[slot].get() : nullptr;
+	if (!conn || conn->generation != generation){
+		// detach parked the buffer under the send it took for in flight
+		loop.orphans.erase(make_user_data(URING_OP_SEND, generation, slot));
+		return;
+	}
+	conn->inflight = false;
+	if (res < 0 || (res & (POLLERR | POLLHUP))){
+		detach(loop, slot);
+		return;
+	}
+	flush(loop, *conn);
+}
+
+}
+
+#endif // !WIN_SOCKET && __linux__
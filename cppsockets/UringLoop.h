@@ -0,0 +1,195 @@
+#pragma once
+
+#ifndef URING_LOOP_H
+#define URING_LOOP_H
+
+#include "IOEngine.h"
+
+#if !defined(WIN_SOCKET) && defined(__linux__)
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+
+// submission queue entries per loop thread, the completion queue is 4x larger
+#ifndef URING_LOOP_ENTRIES
+	#define URING_LOOP_ENTRIES 1024
+#endif
+
+// provided receive buffers per loop thread, power of 2
+#ifndef URING_LOOP_BUFFER_COUNT
+	#define URING_LOOP_BUFFER_COUNT 1024
+#endif
+
+#ifndef URING_LOOP_BUFFER_SIZE
+	#define URING_LOOP_BUFFER_SIZE (16 * 1024)
+#endif
+
+// registered file slots per loop thread = connections one thread can own
+#ifndef URING_LOOP_MAX_FILES
+	#define URING_LOOP_MAX_FILES 16384
+#endif
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct io_uring_buf_ring;
+
+namespace sockets {
+
+	/*
+	* io_uring reactor, raw syscalls, no liburing
+	* one ring per loop thread, one io_uring_enter per loop turn submits and reaps everything
+	*	accept:	multishot on the listener, first loop thread or the one given to ListenOn
+	*	recv:	multishot with IOSQE_BUFFER_SELECT from a registered provided buffer ring
+	*			(IORING_OP_PROVIDE_BUFFERS where the ring does not work),
+	*			the handler sees the kernel filled buffer through on_data, no copy in between
+	*	files:	connections live in registered file slots (IOSQE_FIXED_FILE)
+	*	send:	IStreamHandler::write queues, the loop submits one IORING_OP_SEND per connection
+	*			with the whole queue, the completion sends the rest or what was queued meanwhile;
+	*			a full socket (-EAGAIN) waits on IORING_OP_POLL_ADD
+	* use CIOEngine::Create to fall back to CEventLoop when Available() is false
+	*/
+	class CUringLoop : public CIOEngine {
+	public:
+		CUringLoop(int threads = 1);
+		virtual ~CUringLoop() override;
+
+		// kernel has io_uring with multishot recv/accept
+		static bool Available();
+		// registered provided buffer rings deliver, otherwise IORING_OP_PROVIDE_BUFFERS is used
+		static bool BufferRingWorks();
+		// every ring was set up, false means use another engine
+		bool Valid() const { return _valid; }
+
+		virtual bool Start() override;
+		virtual void Stop() override;
+
+		// multishot accept on the first loop thread, connections are spread
+		virtual bool Listen(CSocketTCPServer &server, handler_factory_t factory) override;
+		virtual bool ListenOn(int thread, CSocketTCPServer &server, handler_factory_t factory) override;
+		virtual bool Add(std::unique_ptr<CSocketTCP> sock, std::shared_ptr<IStreamHandler> handler) override;
+
+		virtual size_t Connections() const override { return _connections.load(std::memory_order_relaxed); }
+		virtual int Threads() const override { return (int)_loops.size(); }
+		virtual const char *Name() const override { return "io_uring"; }
+
+	protected:
+		struct CLoop;
+		struct COutput;
+
+		struct CConnection {
+			std::unique_ptr<CSocketTCP> sock;
+			std::shared_ptr<IStreamHandler> handler;
+			uint32_t generation;
+			uint32_t slot;
+			std::shared_ptr<COutput> output;
+			// taken from the output queue, sending[sent..] is left
+			std::vector<char> sending;
+			size_t sent;
+			// a send or a POLLOUT is submitted, the kernel may read sending
+			bool inflight;
+			// the socket was full since the queue was last empty, on_drain is due
+			bool blocked;
+		};
+
+		struct CListener {
+			CSocketTCPServer *server;
+			handler_factory_t factory;
+			// index of the loop that accepts
+			size_t loop;
+			// round robin over all loops, or stay on loop
+			bool spread;
+		};
+
+		struct CRing {
+			int fd;
+			// submission queue
+			uint32_t *sq_head, *sq_tail, *sq_array;
+			uint32_t sq_mask, sq_entries, sq_local_tail;
+			io_uring_sqe *sqes;
+			// completion queue
+			uint32_t *cq_head, *cq_tail;
+			uint32_t cq_mask;
+			io_uring_cqe *cqes;
+			// mappings
+			void *sq_map, *cq_map;
+			size_t sq_map_size, cq_map_size, sqes_map_size;
+		};
+
+		struct CLoop {
+			CRing ring;
+			int wake;
+			uint64_t wake_value;
+			std::thread thread;
+
+			// provided buffers, group 0, buf_ring == nullptr: legacy provide buffers
+			io_uring_buf_ring *buf_ring;
+			size_t buf_ring_size;
+			char *buffers;
+			uint16_t buf_tail;
+
+			// bumped per attached connection, tags its completions
+			uint32_t generation;
+
+			std::mutex pending_lock;
+			std::vector<CConnection *> pending;
+			// outputs written from other threads, under pending_lock
+			std::vector<std::shared_ptr<COutput>> flushes;
+
+			// loop thread only, index = registered file slot
+			std::vector<std::unique_ptr<CConnection>> slots;
+			std::vector<uint32_t> free_slots;
+			// outputs to submit before the next io_uring_enter
+			std::vector<std::shared_ptr<COutput>> dirty;
+			// send buffers of closed connections the kernel may still read, by user_data
+			std::unordered_map<uint64_t, std::vector<char>> orphans;
+		};
+
+		static bool probe_buffer_ring();
+		static bool setup_ring(CRing &ring, unsigned entries);
+		static void release_ring(CRing &ring);
+		static io_uring_sqe *get_sqe(CRing &ring);
+		static int submit(CRing &ring, unsigned wait_nr);
+
+		bool setup_loop(CLoop &loop);
+		bool add_listener(size_t loop, CSocketTCPServer &server, handler_factory_t factory, bool spread);
+		void release_loop(CLoop &loop);
+		void run(CLoop &loop);
+		void post(CConnection *conn, CLoop *current);
+		void attach(CLoop &loop, CConnection *conn);
+		void detach(CLoop &loop, uint32_t slot);
+		void drain_pending(CLoop &loop);
+
+		void arm_wake(CLoop &loop);
+		void arm_accept(CLoop &loop, uint32_t listener);
+		void arm_recv(CLoop &loop, uint32_t slot);
+		void recycle_buffer(CLoop &loop, uint16_t bid);
+		// submit the next send of conn, false if it was closed
+		bool flush(CLoop &loop, CConnection &conn);
+		void flush_dirty(CLoop &loop);
+
+		void on_accept(CLoop &loop, uint32_t listener, int res, uint32_t flags);
+		void on_recv(CLoop &loop, uint32_t slot, uint32_t generation, int res, uint32_t flags);
+		void on_send(CLoop &loop, uint64_t user_data, int res);
+		void on_pollout(CLoop &loop, uint32_t slot, uint32_t generation, int res);
+
+		std::vector<std::unique_ptr<CLoop>> _loops;
+		std::vector<CListener> _listeners;
+		std::atomic<bool> _running;
+		std::atomic<size_t> _next;
+		std::atomic<size_t> _connections;
+		bool _valid;
+
+	private:
+		CUringLoop(const CUringLoop &);
+		CUringLoop &operator=(const CUringLoop &);
+	};
+
+}
+
+#endif // !WIN_SOCKET && __linux__
+
+#endif